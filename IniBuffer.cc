@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+#include "IniBuffer.h"
+
+#include "win32.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+
+#include "io_stream.h"
+#include "io_stream_memory.h"
+#include "filemanip.h"
+
+bool
+IniBuffer::map (const std::string &path)
+{
+  clear ();
+
+  size_t wlen = path.size () + 7;
+  WCHAR wpath[wlen];
+  mklongpath (wpath, path.c_str (), wlen);
+  HANDLE h = CreateFileW (wpath, GENERIC_READ, FILE_SHARE_READ, NULL,
+			  OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (h == INVALID_HANDLE_VALUE)
+    return false;
+
+  /* The scanner's two NULs come from the zero fill which follows the end
+     of the file in its last page, so there have to be at least two bytes
+     of that. */
+  SYSTEM_INFO si;
+  GetSystemInfo (&si);
+  LARGE_INTEGER filesize;
+  if (GetFileSizeEx (h, &filesize) && filesize.QuadPart > 0
+      && filesize.QuadPart < 0x40000000
+      && si.dwPageSize - filesize.QuadPart % si.dwPageSize >= 2
+      && filesize.QuadPart % si.dwPageSize != 0)
+    {
+      HANDLE m = CreateFileMappingW (h, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+      if (m)
+	{
+	  /* the view keeps the mapping alive */
+	  view = MapViewOfFile (m, FILE_MAP_COPY, 0, 0, 0);
+	  CloseHandle (m);
+	}
+      if (view)
+	{
+	  buf = (char *) view;
+	  len = filesize.QuadPart;
+	  cap = len + 2;
+	}
+    }
+  CloseHandle (h);
+  return view != NULL;
+}
+
+bool
+IniBuffer::read (io_stream *in)
+{
+  clear ();
+
+  /* Start from the stream's own idea of its size when it has one, and
+     grow geometrically from there. */
+  size_t want = in->get_size () + 2;
+  if (want < 1024 * 1024)
+    want = 1024 * 1024;
+
+  bool ok = true;
+  while (1)
+    {
+      if (cap - len < 2 + 16384)
+	{
+	  size_t newcap = cap ? cap * 2 : want;
+	  char *p = (char *) realloc (buf, newcap);
+	  if (!p)
+	    {
+	      ok = false;
+	      break;
+	    }
+	  buf = p;
+	  cap = newcap;
+	}
+      ssize_t got = in->read (buf + len, cap - len - 2);
+      if (got <= 0)
+	{
+	  ok = got == 0;
+	  break;
+	}
+      len += got;
+    }
+  if (!buf)
+    return false;
+  terminate ();
+  return ok;
+}
+
+bool
+IniBuffer::take (io_stream_memory *mem)
+{
+  clear ();
+  buf = mem->release_buffer (len, 2);
+  if (!buf)
+    return false;
+  cap = len + 2;
+  terminate ();
+  return true;
+}
+
+/* add the scanner's NULs, and hand back any slack */
+void
+IniBuffer::terminate ()
+{
+  buf[len] = buf[len + 1] = '\0';
+  if (cap > len + 2)
+    {
+      char *p = (char *) realloc (buf, len + 2);
+      if (p)
+	{
+	  buf = p;
+	  cap = len + 2;
+	}
+    }
+}
+
+io_stream *
+IniBuffer::stream ()
+{
+  return new io_stream_memory (buf, len);
+}
+
+void
+IniBuffer::swap (IniBuffer &other)
+{
+  std::swap (buf, other.buf);
+  std::swap (len, other.len);
+  std::swap (cap, other.cap);
+  std::swap (view, other.view);
+}
+
+void
+IniBuffer::clear ()
+{
+  if (view)
+    UnmapViewOfFile (view);
+  else
+    free (buf);
+  buf = NULL;
+  len = cap = 0;
+  view = NULL;
+}
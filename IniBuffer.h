@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+#ifndef SETUP_INIBUFFER_H
+#define SETUP_INIBUFFER_H
+
+#include <string>
+#include <stddef.h>
+
+class io_stream;
+class io_stream_memory;
+
+/* The whole of a setup.ini in one contiguous, writable buffer, followed
+   by the two NUL bytes which flex's yy_scan_buffer () requires, so that
+   the scanner can tokenize it where it lies instead of copying it into
+   its own buffer.  Local files are mapped copy-on-write rather than
+   read, when their size allows. */
+class IniBuffer
+{
+public:
+  IniBuffer () : buf (NULL), len (0), cap (0), view (NULL) {}
+  ~IniBuffer () { clear (); }
+  /* map the local file path; false if it cannot be mapped, in which case
+     it should be read () instead */
+  bool map (const std::string &path);
+  /* append everything remaining in stream; false on a read error */
+  bool read (io_stream *);
+  /* take over the contents of mem, without copying them, leaving it
+     empty; false if there is not the memory to */
+  bool take (io_stream_memory *mem);
+  /* a read-only stream over the contents, for checking signatures and
+     decompressing.  It must be deleted before the buffer changes. */
+  io_stream *stream ();
+  void swap (IniBuffer &);
+  void clear ();
+  char *data () { return buf; }
+  size_t size () const { return len; }
+  bool mapped () const { return view != NULL; }
+private:
+  char *buf;
+  size_t len;
+  size_t cap;
+  void *view;
+  void terminate ();
+
+  IniBuffer (const IniBuffer &); // no copy cons
+  IniBuffer &operator= (const IniBuffer &); // no assignment
+};
+
+#endif /* SETUP_INIBUFFER_H */
@@ -21,38 +21,40 @@
 
 enum class hashType { none, md5, sha512 };
 
+/* The strings passed to an IniDBBuilder belong to the parser, and only
+   live as long as the parse; anything kept must be copied. */
 class IniDBBuilder
 {
 public:
   virtual ~IniDBBuilder() {};
 
-  virtual void buildTimestamp (const std::string& ) = 0;
-  virtual void buildVersion (const std::string& ) = 0;
-  virtual const std::string buildMinimumVersion(const std::string &) = 0;
-  virtual void buildPackage (const std::string& ) = 0;
-  virtual void buildPackageVersion (const std::string& ) = 0;
-  virtual void buildPackageSDesc (const std::string& ) = 0;
-  virtual void buildPackageLDesc (const std::string& ) = 0;
-  virtual void buildPackageInstall (const std::string&, const std::string&,
+  virtual void buildTimestamp (const char *) = 0;
+  virtual void buildVersion (const char *) = 0;
+  virtual const std::string buildMinimumVersion(const char *) = 0;
+  virtual void buildPackage (const char *) = 0;
+  virtual void buildPackageVersion (const char *) = 0;
+  virtual void buildPackageSDesc (const char *) = 0;
+  virtual void buildPackageLDesc (const char *) = 0;
+  virtual void buildPackageInstall (const char *, const char *,
                                     char *, hashType) = 0;
-  virtual void buildPackageSource (const std::string&, const std::string&,
+  virtual void buildPackageSource (const char *, const char *,
                                    char *, hashType) = 0;
   virtual void buildPackageTrust (trusts) = 0;
-  virtual void buildPackageCategory (const std::string& ) = 0;
+  virtual void buildPackageCategory (const char *) = 0;
   virtual void buildBeginDepends () = 0;
   virtual void buildBeginBuildDepends () = 0;
   virtual void buildBeginObsoletes () = 0;
   virtual void buildBeginProvides () = 0;
   virtual void buildBeginConflicts () = 0;
-  virtual void buildMessage (const std::string&, const std::string&) = 0;
-  virtual void buildSourceName (const std::string& ) = 0;
-  virtual void buildSourceNameVersion (const std::string& ) = 0;
-  virtual void buildPackageListNode (const std::string& ) = 0;
+  virtual void buildMessage (const char *, const char *) = 0;
+  virtual void buildSourceName (const char *) = 0;
+  virtual void buildSourceNameVersion (const char *) = 0;
+  virtual void buildPackageListNode (const char *) = 0;
   virtual void buildPackageListOperator (PackageSpecification::_operators const &) = 0;
-  virtual void buildPackageListOperatorVersion (const std::string& ) = 0;
-  virtual void buildPackageReplaceVersionsList (const std::string& ) = 0;
-  virtual void set_arch (const std::string& a) = 0;
-  virtual void set_release (const std::string& rel) = 0;
+  virtual void buildPackageListOperatorVersion (const char *) = 0;
+  virtual void buildPackageReplaceVersionsList (const char *) = 0;
+  virtual void set_arch (const char *a) = 0;
+  virtual void set_release (const char *rel) = 0;
 };
 
 #endif /* SETUP_INIDBBUILDER_H */
@@ -23,33 +23,33 @@ class IniDBBuilderLint:public IniDBBuilder
 public:
   virtual ~IniDBBuilderLint() {};
 
-  virtual void buildTimestamp (const std::string& ) {};
-  virtual void buildVersion (const std::string& ) {};
-  virtual const std::string buildMinimumVersion(const std::string &s) { return ""; }
-  virtual void buildPackage (const std::string& ) {};
-  virtual void buildPackageVersion (const std::string& ) {};
-  virtual void buildPackageSDesc (const std::string& ) {};
-  virtual void buildPackageLDesc (const std::string& ) {};
-  virtual void buildPackageInstall (const std::string&, const std::string&,
+  virtual void buildTimestamp (const char *) {};
+  virtual void buildVersion (const char *) {};
+  virtual const std::string buildMinimumVersion(const char *s) { return ""; }
+  virtual void buildPackage (const char *) {};
+  virtual void buildPackageVersion (const char *) {};
+  virtual void buildPackageSDesc (const char *) {};
+  virtual void buildPackageLDesc (const char *) {};
+  virtual void buildPackageInstall (const char *, const char *,
                                     char *, hashType) {};
-  virtual void buildPackageSource (const std::string&, const std::string&,
+  virtual void buildPackageSource (const char *, const char *,
                                    char *, hashType) {};
   virtual void buildPackageTrust (trusts) {};
-  virtual void buildPackageCategory (const std::string& ) {};
+  virtual void buildPackageCategory (const char *) {};
   virtual void buildBeginDepends () {};
   virtual void buildBeginBuildDepends () {};
   virtual void buildBeginObsoletes () {};
   virtual void buildBeginProvides () {};
   virtual void buildBeginConflicts () {};
-  virtual void buildMessage (const std::string&, const std::string&) {};
-  virtual void buildSourceName (const std::string& ) {};
-  virtual void buildSourceNameVersion (const std::string& ) {};
-  virtual void buildPackageListNode (const std::string& ) {};
+  virtual void buildMessage (const char *, const char *) {};
+  virtual void buildSourceName (const char *) {};
+  virtual void buildSourceNameVersion (const char *) {};
+  virtual void buildPackageListNode (const char *) {};
   virtual void buildPackageListOperator (PackageSpecification::_operators const &) {};
-  virtual void buildPackageListOperatorVersion (const std::string& ) {};
-  virtual void buildPackageReplaceVersionsList (const std::string& ) {};
-  virtual void set_arch (const std::string& a) {};
-  virtual void set_release (const std::string& rel) {};
+  virtual void buildPackageListOperatorVersion (const char *) {};
+  virtual void buildPackageReplaceVersionsList (const char *) {};
+  virtual void set_arch (const char *a) {};
+  virtual void set_release (const char *rel) {};
 };
 
 #endif /* SETUP_INIDBBUILDERLINT_H */
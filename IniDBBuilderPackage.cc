@@ -30,7 +30,8 @@
 #include <algorithm>
 
 IniDBBuilderPackage::IniDBBuilderPackage (IniParseFeedback const &aFeedback) :
-  currentSpec (0), _feedback (aFeedback), minimum_version_checked(FALSE) {}
+  currentSpec (0), specs_used (0), _feedback (aFeedback),
+  minimum_version_checked(FALSE) {}
 
 IniDBBuilderPackage::~IniDBBuilderPackage()
 {
@@ -40,13 +41,13 @@ IniDBBuilderPackage::~IniDBBuilderPackage()
 }
 
 void
-IniDBBuilderPackage::buildTimestamp (const std::string& time)
+IniDBBuilderPackage::buildTimestamp (const char *time)
 {
-  timestamp = strtoul (time.c_str(), 0, 0);
+  timestamp = strtoul (time, 0, 0);
 }
 
 void
-IniDBBuilderPackage::buildVersion (const std::string& aVersion)
+IniDBBuilderPackage::buildVersion (const char *aVersion)
 {
   version = aVersion;
 
@@ -75,7 +76,7 @@ IniDBBuilderPackage::buildVersion (const std::string& aVersion)
 }
 
 const std::string
-IniDBBuilderPackage::buildMinimumVersion (const std::string& minimum)
+IniDBBuilderPackage::buildMinimumVersion (const char *minimum)
 {
   minimum_version_checked = TRUE;
   if (version_compare(setup_version, minimum) < 0)
@@ -84,7 +85,7 @@ IniDBBuilderPackage::buildMinimumVersion (const std::string& minimum)
       snprintf (min_vers, sizeof(min_vers),
                 "The current ini file requires at least version %s of setup.\n"
                 "Please download a newer version from https://cygwin.com/setup-%s.exe",
-                minimum.c_str(),
+                minimum,
                 is_64bit ? "x86_64" : "x86");
       return min_vers;
     }
@@ -92,12 +93,14 @@ IniDBBuilderPackage::buildMinimumVersion (const std::string& minimum)
 }
 
 void
-IniDBBuilderPackage::buildPackage (const std::string& _name)
+IniDBBuilderPackage::buildPackage (const char *_name)
 {
   process();
 
-  /* Reset for next package */
+  /* Reset for next package.  Nothing refers to the dependency nodes of
+     the last one any more, so they can be reused. */
   name = _name;
+  specs_used = 0;
   message_id = "";
   message_string = "";
   categories.clear();
@@ -130,32 +133,32 @@ IniDBBuilderPackage::buildPackage (const std::string& _name)
 }
 
 void
-IniDBBuilderPackage::buildPackageVersion (const std::string& version)
+IniDBBuilderPackage::buildPackageVersion (const char *version)
 {
   cbpv.version = version;
 }
 
 void
-IniDBBuilderPackage::buildPackageSDesc (const std::string& theDesc)
+IniDBBuilderPackage::buildPackageSDesc (const char *theDesc)
 {
   cbpv.sdesc = theDesc;
 }
 
 void
-IniDBBuilderPackage::buildPackageLDesc (const std::string& theDesc)
+IniDBBuilderPackage::buildPackageLDesc (const char *theDesc)
 {
   cbpv.ldesc = theDesc;
 }
 
 void
-IniDBBuilderPackage::buildPackageInstall (const std::string& path,
-                                          const std::string& size,
+IniDBBuilderPackage::buildPackageInstall (const char *path,
+                                          const char *size,
                                           char *hash,
                                           hashType type)
 {
   // set archive path, size, mirror, hash
-  cbpv.archive.set_canonical(path.c_str());
-  cbpv.archive.size = atoi(size.c_str());
+  cbpv.archive.set_canonical(path);
+  cbpv.archive.size = atoi(size);
   cbpv.archive.sites.push_back(site(parse_mirror));
 
   switch (type) {
@@ -178,8 +181,8 @@ IniDBBuilderPackage::buildPackageInstall (const std::string& path,
 }
 
 void
-IniDBBuilderPackage::buildPackageSource (const std::string& path,
-                                         const std::string& size,
+IniDBBuilderPackage::buildPackageSource (const char *path,
+                                         const char *size,
                                          char *hash,
                                          hashType type)
 {
@@ -196,8 +199,8 @@ IniDBBuilderPackage::buildPackageSource (const std::string& path,
 
   /* set archive path, size, mirror, hash */
   cspv.archive = packagesource();
-  cspv.archive.set_canonical(path.c_str());
-  cspv.archive.size = atoi(size.c_str());
+  cspv.archive.set_canonical(path);
+  cspv.archive.size = atoi(size);
   cspv.archive.sites.push_back(site(parse_mirror));
 
   switch (type) {
@@ -234,7 +237,7 @@ IniDBBuilderPackage::buildPackageTrust (trusts newtrust)
 }
 
 void
-IniDBBuilderPackage::buildPackageCategory (const std::string& name)
+IniDBBuilderPackage::buildPackageCategory (const char *name)
 {
   categories.insert(name);
 }
@@ -299,7 +302,7 @@ IniDBBuilderPackage::buildBeginConflicts ()
 }
 
 void
-IniDBBuilderPackage::buildSourceName (const std::string& _name)
+IniDBBuilderPackage::buildSourceName (const char *_name)
 {
   // When there is a Source: line, that names a real source package
   packagedb db;
@@ -311,18 +314,23 @@ IniDBBuilderPackage::buildSourceName (const std::string& _name)
 }
 
 void
-IniDBBuilderPackage::buildSourceNameVersion (const std::string& version)
+IniDBBuilderPackage::buildSourceNameVersion (const char *version)
 {
   // XXX: should be stored as sourceevr
 }
 
 void
-IniDBBuilderPackage::buildPackageListNode (const std::string & name)
+IniDBBuilderPackage::buildPackageListNode (const char *name)
 {
 #if DEBUG
   Log (LOG_BABBLE) << "New node '" << name << "' for package list" << endLog;
 #endif
-  currentSpec = new PackageSpecification (name);
+  /* Dependency nodes come from a pool which is recycled for each package,
+     instead of being allocated one by one (and never freed). */
+  if (specs_used == specs.size ())
+    specs.push_back (PackageSpecification ());
+  currentSpec = &specs[specs_used++];
+  currentSpec->reset (name);
   if (currentNodeList)
     currentNodeList->push_back (currentSpec);
 }
@@ -341,7 +349,7 @@ IniDBBuilderPackage::buildPackageListOperator (PackageSpecification::_operators
 }
 
 void
-IniDBBuilderPackage::buildPackageListOperatorVersion (const std::string& aVersion)
+IniDBBuilderPackage::buildPackageListOperatorVersion (const char *aVersion)
 {
   if (currentSpec)
     {
@@ -354,14 +362,14 @@ IniDBBuilderPackage::buildPackageListOperatorVersion (const std::string& aVersio
 }
 
 void
-IniDBBuilderPackage::buildMessage (const std::string& _message_id, const std::string& _message_string)
+IniDBBuilderPackage::buildMessage (const char *_message_id, const char *_message_string)
 {
   message_id = _message_id;
   message_string = _message_string;
 }
 
 void
-IniDBBuilderPackage::buildPackageReplaceVersionsList (const std::string& version)
+IniDBBuilderPackage::buildPackageReplaceVersionsList (const char *version)
 {
   replace_versions.insert(version);
 }
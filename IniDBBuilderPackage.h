@@ -18,6 +18,7 @@
 
 #include "IniDBBuilder.h"
 #include <vector>
+#include <deque>
 #include <set>
 
 #include "package_message.h"
@@ -33,36 +34,36 @@ public:
   IniDBBuilderPackage (IniParseFeedback const &);
   ~IniDBBuilderPackage ();
 
-  void buildTimestamp (const std::string& );
-  void buildVersion (const std::string& );
-  const std::string buildMinimumVersion(const std::string &);
-  void buildPackage (const std::string& );
-  void buildPackageVersion (const std::string& );
-  void buildPackageSDesc (const std::string& );
-  void buildPackageLDesc (const std::string& );
-  void buildPackageInstall (const std::string&, const std::string&,
+  void buildTimestamp (const char *);
+  void buildVersion (const char *);
+  const std::string buildMinimumVersion(const char *);
+  void buildPackage (const char *);
+  void buildPackageVersion (const char *);
+  void buildPackageSDesc (const char *);
+  void buildPackageLDesc (const char *);
+  void buildPackageInstall (const char *, const char *,
                             char *, hashType);
-  void buildPackageSource (const std::string&, const std::string&,
+  void buildPackageSource (const char *, const char *,
                            char *, hashType);
 
   void buildPackageTrust (trusts);
-  void buildPackageCategory (const std::string& );
+  void buildPackageCategory (const char *);
 
   void buildBeginDepends ();
   void buildBeginBuildDepends ();
   void buildBeginObsoletes ();
   void buildBeginProvides ();
   void buildBeginConflicts ();
-  void buildMessage (const std::string&, const std::string&);
-  void buildSourceName (const std::string& );
-  void buildSourceNameVersion (const std::string& );
-  void buildPackageListNode (const std::string& );
+  void buildMessage (const char *, const char *);
+  void buildSourceName (const char *);
+  void buildSourceNameVersion (const char *);
+  void buildPackageListNode (const char *);
   void buildPackageListOperator (PackageSpecification::_operators const &);
-  void buildPackageListOperatorVersion (const std::string& );
-  void buildPackageReplaceVersionsList (const std::string& );
+  void buildPackageListOperatorVersion (const char *);
+  void buildPackageReplaceVersionsList (const char *);
 
-  void set_arch (const std::string& a) { arch = a; }
-  void set_release (const std::string& rel) { release = rel; }
+  void set_arch (const char *a) { arch = a; }
+  void set_release (const char *rel) { release = rel; }
 
   // setup.ini header data
   unsigned int timestamp;
@@ -80,6 +81,8 @@ private:
   std::string message_id;
   std::string message_string;
   PackageSpecification *currentSpec;
+  std::deque <PackageSpecification> specs;
+  size_t specs_used;
   PackageDepends *currentNodeList;
   PackageDepends dependsNodeList;
   PackageDepends obsoletesNodeList;
@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+#include "IniDBBuilderRecorder.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "ini.h"
+#include "IniParseFeedback.h"
+#include "io_stream.h"
+#include "sha2.h"
+
+/* The layout of a saved recording: a header, the key, the calls, and then
+   the strings and hashes they refer to, by offset.  It is only ever read
+   back on the machine which wrote it, so it is in native byte order. */
+
+#define RECORDING_MAGIC "SETUPIDX"
+#define RECORDING_FORMAT 2
+#define NO_STRING 0xffffffffU
+
+struct saved_header
+{
+  char magic[8];
+  uint32_t format;
+  uint32_t keylen;
+  uint32_t count;
+  uint32_t datalen;
+};
+
+struct saved_call
+{
+  uint32_t what;
+  uint32_t n;
+  uint32_t a;
+  uint32_t b;
+  uint32_t hash;
+};
+
+static size_t
+hash_length (int type)
+{
+  switch ((hashType) type)
+    {
+    case hashType::md5:
+      return 16;
+    case hashType::sha512:
+      return SHA512_DIGEST_LENGTH;
+    default:
+      return 0;
+    }
+}
+
+static uint32_t
+put (std::string &data, const char *s, size_t len)
+{
+  if (!s)
+    return NO_STRING;
+  uint32_t off = data.size ();
+  data.append (s, len);
+  return off;
+}
+
+/* the line it was on, in place of the verdict, which is for replay () */
+const std::string
+IniDBBuilderRecorder::buildMinimumVersion (const char *s)
+{
+  record (MinimumVersion, s, 0, 0, lines ? lines->lineno () : 0);
+  return "";
+}
+
+void
+IniDBBuilderRecorder::replay (IniParseFeedback *feedback)
+{
+  for (std::vector <entry>::const_iterator i = calls.begin ();
+       i != calls.end (); ++i)
+    switch (i->what)
+      {
+      case Timestamp:
+        target.buildTimestamp (i->a);
+        break;
+      case Version:
+        target.buildVersion (i->a);
+        break;
+      case MinimumVersion:
+        {
+          std::string e = target.buildMinimumVersion (i->a);
+          if (!e.empty () && feedback)
+            feedback->note_error (i->n, e);
+        }
+        break;
+      case Package:
+        target.buildPackage (i->a);
+        break;
+      case PackageVersion:
+        target.buildPackageVersion (i->a);
+        break;
+      case SDesc:
+        target.buildPackageSDesc (i->a);
+        break;
+      case LDesc:
+        target.buildPackageLDesc (i->a);
+        break;
+      case Install:
+        target.buildPackageInstall (i->a, i->b, i->hash, (hashType) i->n);
+        break;
+      case Source:
+        target.buildPackageSource (i->a, i->b, i->hash, (hashType) i->n);
+        break;
+      case Trust:
+        target.buildPackageTrust ((trusts) i->n);
+        break;
+      case Category:
+        target.buildPackageCategory (i->a);
+        break;
+      case BeginDepends:
+        target.buildBeginDepends ();
+        break;
+      case BeginBuildDepends:
+        target.buildBeginBuildDepends ();
+        break;
+      case BeginObsoletes:
+        target.buildBeginObsoletes ();
+        break;
+      case BeginProvides:
+        target.buildBeginProvides ();
+        break;
+      case BeginConflicts:
+        target.buildBeginConflicts ();
+        break;
+      case Message:
+        target.buildMessage (i->a, i->b);
+        break;
+      case SourceName:
+        target.buildSourceName (i->a);
+        break;
+      case SourceNameVersion:
+        target.buildSourceNameVersion (i->a);
+        break;
+      case ListNode:
+        target.buildPackageListNode (i->a);
+        break;
+      case ListOperator:
+        target.buildPackageListOperator ((PackageSpecification::_operators) i->n);
+        break;
+      case ListOperatorVersion:
+        target.buildPackageListOperatorVersion (i->a);
+        break;
+      case ReplaceVersions:
+        target.buildPackageReplaceVersionsList (i->a);
+        break;
+      case Arch:
+        target.set_arch (i->a);
+        break;
+      case Release:
+        target.set_release (i->a);
+        break;
+      }
+  calls.clear ();
+}
+
+bool
+IniDBBuilderRecorder::save (io_stream *out, const std::string &key) const
+{
+  std::string data;
+  std::vector <saved_call> saved;
+  saved.reserve (calls.size ());
+  for (std::vector <entry>::const_iterator i = calls.begin ();
+       i != calls.end (); ++i)
+    {
+      saved_call c;
+      c.what = i->what;
+      c.n = i->n;
+      c.a = put (data, i->a, i->a ? strlen (i->a) + 1 : 0);
+      c.b = put (data, i->b, i->b ? strlen (i->b) + 1 : 0);
+      c.hash = put (data, i->hash, hash_length (i->n));
+      saved.push_back (c);
+    }
+  /* so that every string is terminated, whatever a damaged file says */
+  data += '\0';
+
+  saved_header h;
+  memcpy (h.magic, RECORDING_MAGIC, sizeof h.magic);
+  h.format = RECORDING_FORMAT;
+  h.keylen = key.size ();
+  h.count = saved.size ();
+  h.datalen = data.size ();
+
+  ssize_t callslen = saved.size () * sizeof (saved_call);
+  return out->write (&h, sizeof h) == (ssize_t) sizeof h
+    && out->write (key.data (), key.size ()) == (ssize_t) key.size ()
+    && (!callslen || out->write (&saved[0], callslen) == callslen)
+    && out->write (data.data (), data.size ()) == (ssize_t) data.size ();
+}
+
+bool
+IniDBBuilderRecorder::load (char *buf, size_t size, const std::string &key)
+{
+  calls.clear ();
+
+  saved_header h;
+  if (size < sizeof h)
+    return false;
+  memcpy (&h, buf, sizeof h);
+  if (memcmp (h.magic, RECORDING_MAGIC, sizeof h.magic)
+      || h.format != RECORDING_FORMAT || h.keylen != key.size ()
+      || (uint64_t) sizeof h + h.keylen
+         + (uint64_t) h.count * sizeof (saved_call) + h.datalen != size
+      || memcmp (buf + sizeof h, key.data (), key.size ())
+      || !h.datalen)
+    return false;
+
+  const char *saved = buf + sizeof h + h.keylen;
+  char *data = buf + size - h.datalen;
+  if (data[h.datalen - 1] != '\0')
+    return false;
+
+  calls.reserve (h.count);
+  for (uint32_t i = 0; i < h.count; ++i)
+    {
+      saved_call c;
+      memcpy (&c, saved + i * sizeof c, sizeof c);
+      if (c.what > LastCall
+          || (c.a != NO_STRING && c.a >= h.datalen)
+          || (c.b != NO_STRING && c.b >= h.datalen)
+          || (c.hash != NO_STRING
+              && (uint64_t) c.hash + hash_length (c.n) > h.datalen))
+        {
+          calls.clear ();
+          return false;
+        }
+      entry e = { (call) c.what, (int) c.n,
+                  c.a == NO_STRING ? 0 : data + c.a,
+                  c.b == NO_STRING ? 0 : data + c.b,
+                  c.hash == NO_STRING ? 0 : data + c.hash };
+      calls.push_back (e);
+    }
+  return true;
+}
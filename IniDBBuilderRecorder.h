@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+#ifndef SETUP_INIDBBUILDERRECORDER_H
+#define SETUP_INIDBBUILDERRECORDER_H
+
+#include "IniDBBuilder.h"
+#include <string>
+#include <vector>
+
+class io_stream;
+class IniParser;
+class IniParseFeedback;
+
+/* Records the calls made by a parse, so that the parse can run on a
+   worker thread and its results be handed to the real builder (which
+   is not thread-safe) afterwards, in a fixed order.  The recorded
+   strings belong to the IniParser, which must outlive replay (). */
+class IniDBBuilderRecorder:public IniDBBuilder
+{
+public:
+  /* target sees nothing until replay (), not even buildMinimumVersion (),
+     whose verdict the grammar would report at once.  Instead it is
+     reported by replay (), at the line of lines it was read from. */
+  IniDBBuilderRecorder (IniDBBuilder &target, IniParser *lines = 0)
+    : target (target), lines (lines) {}
+
+  virtual void buildTimestamp (const char *s) { record (Timestamp, s); }
+  virtual void buildVersion (const char *s) { record (Version, s); }
+  virtual const std::string buildMinimumVersion (const char *s);
+  virtual void buildPackage (const char *s) { record (Package, s); }
+  virtual void buildPackageVersion (const char *s)
+    { record (PackageVersion, s); }
+  virtual void buildPackageSDesc (const char *s) { record (SDesc, s); }
+  virtual void buildPackageLDesc (const char *s) { record (LDesc, s); }
+  virtual void buildPackageInstall (const char *path, const char *size,
+                                    char *hash, hashType type)
+    { record (Install, path, size, hash, (int) type); }
+  virtual void buildPackageSource (const char *path, const char *size,
+                                   char *hash, hashType type)
+    { record (Source, path, size, hash, (int) type); }
+  virtual void buildPackageTrust (trusts t) { record (Trust, 0, 0, 0, t); }
+  virtual void buildPackageCategory (const char *s) { record (Category, s); }
+  virtual void buildBeginDepends () { record (BeginDepends); }
+  virtual void buildBeginBuildDepends () { record (BeginBuildDepends); }
+  virtual void buildBeginObsoletes () { record (BeginObsoletes); }
+  virtual void buildBeginProvides () { record (BeginProvides); }
+  virtual void buildBeginConflicts () { record (BeginConflicts); }
+  virtual void buildMessage (const char *id, const char *s)
+    { record (Message, id, s); }
+  virtual void buildSourceName (const char *s) { record (SourceName, s); }
+  virtual void buildSourceNameVersion (const char *s)
+    { record (SourceNameVersion, s); }
+  virtual void buildPackageListNode (const char *s) { record (ListNode, s); }
+  virtual void buildPackageListOperator (PackageSpecification::_operators const &o)
+    { record (ListOperator, 0, 0, 0, o); }
+  virtual void buildPackageListOperatorVersion (const char *s)
+    { record (ListOperatorVersion, s); }
+  virtual void buildPackageReplaceVersionsList (const char *s)
+    { record (ReplaceVersions, s); }
+  virtual void set_arch (const char *s) { record (Arch, s); }
+  virtual void set_release (const char *s) { record (Release, s); }
+
+  /* make the recorded calls on target, in order, noting any error
+     buildMinimumVersion () gives in feedback */
+  void replay (IniParseFeedback *feedback = 0);
+
+  /* Write the recording to out, tagged with key; false on a write error. */
+  bool save (io_stream *out, const std::string &key) const;
+  /* Take the recording from a buffer written by save (), which must stay
+     put until replay (), and may be changed.  False, recording nothing,
+     unless it is intact and was saved with the same key. */
+  bool load (char *buf, size_t size, const std::string &key);
+
+private:
+  enum call
+  {
+    Timestamp, Version, MinimumVersion, Package, PackageVersion, SDesc, LDesc, Install,
+    Source, Trust, Category, BeginDepends, BeginBuildDepends,
+    BeginObsoletes, BeginProvides, BeginConflicts, Message, SourceName,
+    SourceNameVersion, ListNode, ListOperator, ListOperatorVersion,
+    ReplaceVersions, Arch, Release,
+    LastCall = Release
+  };
+  struct entry
+  {
+    call what;
+    int n;
+    const char *a;
+    const char *b;
+    char *hash;
+  };
+  void record (call what, const char *a = 0, const char *b = 0,
+               char *hash = 0, int n = 0)
+    {
+      entry e = { what, n, a, b, hash };
+      calls.push_back (e);
+    }
+
+  IniDBBuilder &target;
+  IniParser *lines;
+  std::vector <entry> calls;
+};
+
+#endif /* SETUP_INIDBBUILDERRECORDER_H */
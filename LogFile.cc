@@ -73,9 +73,15 @@ typedef std::set<filedef> FileSet;
 static FileSet files;
 static std::stringbuf *theStream;
 
+/* Held from operator() until endEntry(), so that entries written from
+   worker threads are not interleaved.  Critical sections are recursive,
+   so a thread may still log while formatting its own entry. */
+static CRITICAL_SECTION entryLock;
+
 LogFile *
 LogFile::createLogFile()
 {
+    InitializeCriticalSection (&entryLock);
     theStream = new std::stringbuf;
     return new LogFile(theStream);
 }
@@ -182,6 +188,7 @@ std::ostream & LogFile::operator() (log_level theLevel)
 {
   if (theLevel < LOG_LEVEL_MIN || theLevel > LOG_LEVEL_MAX)
     throw new std::invalid_argument("Invalid log_level");
+  EnterCriticalSection (&entryLock);
   if (!theStream)
     theStream = new std::stringbuf;
   rdbuf (theStream);
@@ -227,4 +234,5 @@ void LogFile::endEntry()
   theStream = new std::stringbuf;
   rdbuf (theStream);
   init (theStream);
+  LeaveCriticalSection (&entryLock);
 }
@@ -58,6 +58,14 @@ PackageSpecification::setVersion (const std::string& aVersion)
   _version = aVersion;
 }
 
+void
+PackageSpecification::reset (const char *packageName)
+{
+  _packageName = packageName;
+  _operator = Equals;
+  _version.clear ();
+}
+
 bool
 PackageSpecification::satisfies (packageversion const &aPackage) const
 {
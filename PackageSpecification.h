@@ -48,6 +48,8 @@ public:
 
   void setOperator (_operators);
   void setVersion (const std::string& );
+  /* start over as an unversioned specification of packageName */
+  void reset (const char *packageName);
 
   bool satisfies (packageversion const &) const;
 
@@ -18,6 +18,8 @@
 
 #include "LogSingleton.h"
 
+#include <string.h>
+
 #include "io_stream.h"
 #include "archive.h"
 #include "archive_tar.h"
@@ -78,9 +80,71 @@ archive::extract (io_stream * original)
   return NULL;
 }
 
+int
+extract_context::mkpath_p (path_type_t isadir, const std::string &path,
+			   mode_t mode)
+{
+  std::string dir (path);
+  if (isadir == PATH_TO_FILE)
+    {
+      std::string::size_type slash = path.rfind ('/');
+      if (slash == std::string::npos)
+	return io_stream::mkpath_p (isadir, path, mode);
+      dir.erase (slash);
+    }
+  if (known.count (dir))
+    return 0;
+
+  /* one which isn't there yet is made empty */
+  bool made = !io_stream::exists (dir);
+  if (io_stream::mkpath_p (isadir, path, mode))
+    return 1;
+  known.insert (dir);
+  if (made)
+    fresh.insert (dir);
+  writing (dir);
+  return 0;
+}
+
+bool
+extract_context::absent (const std::string &path) const
+{
+  std::string::size_type slash = path.rfind ('/');
+  return slash != std::string::npos
+    && fresh.count (path.substr (0, slash)) && !written.count (path);
+}
+
+void
+extract_context::writing (const std::string &path)
+{
+  written.insert (path);
+}
+
+/* Make the directory for path, through ctx if there is one */
+static int
+make_path (extract_context *ctx, path_type_t isadir, const std::string &path,
+	  mode_t mode)
+{
+  if (ctx)
+    return ctx->mkpath_p (isadir, path, mode);
+  return io_stream::mkpath_p (isadir, path, mode);
+}
+
+/* Remove whatever is at path, to be replaced, unless ctx knows there is
+   nothing there */
+static void
+make_way (extract_context *ctx, const std::string &path)
+{
+  if (!ctx || !ctx->absent (path))
+    io_stream::remove (path);
+  if (ctx)
+    ctx->writing (path);
+}
+
 archive::extract_results
 archive::extract_file (archive * source, const std::string& prefixURL,
-                       const std::string& prefixPath, std::string suffix)
+                       const std::string& prefixPath, std::string suffix,
+                       extract_context *ctx)
 {
   extract_results res = extract_other;
   if (source)
@@ -92,14 +156,14 @@ archive::extract_file (archive * source, const std::string& prefixURL,
 	case ARCHIVE_FILE_REGULAR:
 	  {
 	    /* TODO: remove in-the-way directories via mkpath_p */
-	    if (io_stream::mkpath_p (PATH_TO_FILE, destfilename, 0755))
+	    if (make_path (ctx, PATH_TO_FILE, destfilename, 0755))
 	      {
 		Log (LOG_TIMESTAMP) << "Failed to make the path for " << destfilename
 				    << endLog;
 		res = extract_inuse;
 		goto out;
 	      }
-	    io_stream::remove (destfilename);
+	    make_way (ctx, destfilename);
 	    io_stream *in = source->extract_file ();
 	    if (!in)
 	      {
@@ -110,6 +174,10 @@ archive::extract_file (archive * source, const std::string& prefixURL,
 		goto out;
 	      }
 	    io_stream *tmp = io_stream::open (destfilename, "wb", in->get_mode ());
+	    /* one written in a single copy () gets its space in one go as it
+	       is, without asking */
+	    if (tmp && in->get_size () > 65536)
+	      tmp->preallocate (in->get_size ());
 	    if (!tmp)
 	      {
 		delete in;
@@ -136,7 +204,7 @@ archive::extract_file (archive * source, const std::string& prefixURL,
 	  }
 	  break;
 	case ARCHIVE_FILE_SYMLINK:
-	  if (io_stream::mkpath_p (PATH_TO_FILE, destfilename, 0755))
+	  if (make_path (ctx, PATH_TO_FILE, destfilename, 0755))
 	    {
 	      Log (LOG_TIMESTAMP) << "Failed to make the path for %s"
 				  << destfilename << endLog;
@@ -144,7 +212,7 @@ archive::extract_file (archive * source, const std::string& prefixURL,
 	    }
 	  else
 	    {
-	      io_stream::remove (destfilename);
+	      make_way (ctx, destfilename);
 	      int x = io_stream::mklink (destfilename,
 					 prefixURL+ source->linktarget (),
 					 IO_STREAM_SYMLINK);
@@ -154,7 +222,7 @@ archive::extract_file (archive * source, const std::string& prefixURL,
 	    }
 	  break;
 	case ARCHIVE_FILE_HARDLINK:
-	  if (io_stream::mkpath_p (PATH_TO_FILE, destfilename, 0755))
+	  if (make_path (ctx, PATH_TO_FILE, destfilename, 0755))
 	    {
 	      Log (LOG_TIMESTAMP) << "Failed to make the path for %s"
 				  << destfilename << endLog;
@@ -162,7 +230,7 @@ archive::extract_file (archive * source, const std::string& prefixURL,
 	    }
 	  else
 	    {
-	      io_stream::remove (destfilename);
+	      make_way (ctx, destfilename);
 	      int x = io_stream::mklink (destfilename,
 					 prefixURL + prefixPath + source->linktarget (),
 					 IO_STREAM_HARDLINK);
@@ -178,7 +246,7 @@ archive::extract_file (archive * source, const std::string& prefixURL,
 	    while (path[0] && path[strlen (path) - 1] == '/')
 	      path[strlen (path) - 1] = 0;
 	    io_stream *in = source->extract_file ();
-	    int x = io_stream::mkpath_p (PATH_TO_DIR, path, in->get_mode ());
+	    int x = make_path (ctx, PATH_TO_DIR, path, in->get_mode ());
 	    delete in;
 	    source->skip_file ();
 	    res = x == 0 ? extract_ok : extract_other;
@@ -27,6 +27,31 @@
  * 3) the user calls extract_file (output strea,).
  */
 
+#include <set>
+#include "String++.h"
+
+/* What archive::extract_file has found out about the tree it extracts
+ * into, so that it need not ask again: the directories known to exist,
+ * those of them it made itself, and what it has written in those, which
+ * are all that can be in them.  Only good for as long as nothing else
+ * changes the tree, such as for the extraction of a set of packages.
+ */
+class extract_context
+{
+public:
+  /* as io_stream::mkpath_p, unless the directory is known to exist */
+  int mkpath_p (path_type_t, const std::string &, mode_t);
+  /* whether path can't exist yet, so needs no removing before writing */
+  bool absent (const std::string &path) const;
+  /* note that path is about to be written */
+  void writing (const std::string &path);
+private:
+  typedef std::set <std::string, casecompare_lt_op> pathset;
+  pathset known;
+  pathset fresh;
+  pathset written;
+};
+
 typedef enum
 {
   ARCHIVE_FILE_INVALID,
@@ -55,12 +80,14 @@ public:
    */
   virtual io_stream *extract_file () = 0;
   /* extract the next file to the given prefixURL+Path in one step, and name it with the
-   * given suffix.
+   * given suffix.  With a context, what is known of the tree spares asking
+   * the filesystem again.
    * returns 1 on failure.
    */
   static extract_results extract_file (archive *, const std::string&,
 				       const std::string&,
-				       const std::string = std::string());
+				       const std::string = std::string(),
+				       extract_context * = NULL);
 
   /* 
    * To create a stream that will be compressed, you should open the url, and then get a new stream
@@ -17,6 +17,8 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <limits.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/fcntl.h>
 #include <errno.h>
@@ -24,12 +26,9 @@
 //#include "zlib/zlib.h"
 #include "io_stream.h"
 //#include "compress.h"
-#include "win32.h"
 #include "archive.h"
 #include "archive_tar.h"
-#include "mkdir.h"
 #include "LogFile.h"
-#include "filemanip.h"
 
 #if 0
 #undef _WIN32
@@ -39,7 +38,9 @@
 #endif
 static int err;
 
-static char buf[512];
+/* the largest pax extended header read; they are usually a few hundred
+   bytes, but can hold a name as long as CYG_PATH_MAX and its link target */
+#define PAX_HEADER_MAX (64 * 1024)
 
 int _tar_verbose = 0;
 
@@ -52,7 +53,7 @@ archive_tar::archive_tar (io_stream * original)
 
   if (!original)
     {
-      state.lasterr = EBADF;
+      state.archive_err = EBADF;
       return;
     }
   state.parent = original;
@@ -88,7 +89,7 @@ archive_tar::peek (void *buffer, size_t len)
 int
 archive_tar::error ()
 {
-  return state.lasterr;
+  return state.archive_err;
 }
 
 long
@@ -107,14 +108,22 @@ archive_tar::seek (long where, io_stream_seek_t whence)
   return -1; 
 }
 
+/* the number of 512 byte blocks holding len bytes */
+static size_t
+blocks (size_t len)
+{
+  return (len + 511) / 512;
+}
+
 int
 archive_tar::skip_file ()
 {
-  while (state.file_length > state.file_offset)
+  /* file_offset bytes of the file have been read, and the padding after
+     it only if that is all of it */
+  if (state.file_length > state.file_offset)
     {
-      int len = state.parent->read (buf, 512);
-      state.file_offset += 512;
-      if (len != 512)
+      size_t len = blocks (state.file_length) * 512 - state.file_offset;
+      if (state.parent->skip (len) != (ssize_t) len)
 	return 1;
     }
   state.file_length = 0;
@@ -123,6 +132,61 @@ archive_tar::skip_file ()
   return 0;
 }
 
+/* A numeric header field: octal digits, perhaps led by spaces and ended
+   by a space or NUL, or all NULs for 0; or, for a value too big or, as
+   an mtime before 1970, too small for that, two's complement base-256 as
+   GNU tar writes it, flagged by the top bit of the first byte.  False if
+   it is neither, or the value is too big. */
+static bool
+tar_number (const char *field, size_t len, long long &value)
+{
+  const unsigned char *p = (const unsigned char *) field;
+  const unsigned char *end = p + len;
+  value = 0;
+  if (*p & 0x80)
+    {
+      /* the sign is the next bit */
+      value = (*p & 0x3f) - (*p & 0x40);
+      for (p++; p < end; p++)
+	{
+	  if (value > LLONG_MAX >> 8 || value < LLONG_MIN >> 8)
+	    return false;
+	  value = value * 256 + *p;
+	}
+      return true;
+    }
+
+  while (p < end && *p == ' ')
+    p++;
+  for (; p < end && *p >= '0' && *p <= '7'; p++)
+    {
+      if (value >> 60)
+	return false;
+      value = value << 3 | (*p - '0');
+    }
+  return p == end || *p == ' ' || *p == '\0';
+}
+
+/* Decode the size, mode and mtime of the header just read */
+bool
+archive_tar::parse_header ()
+{
+  long long size, mode, mtime;
+  if (!tar_number (state.tar_header.size, sizeof state.tar_header.size, size)
+      || !tar_number (state.tar_header.mode, sizeof state.tar_header.mode,
+		      mode)
+      || !tar_number (state.tar_header.mtime, sizeof state.tar_header.mtime,
+		      mtime)
+      || size < 0 || mode < 0
+      || (unsigned long long) size > (size_t) -1 - 511)
+    return false;
+  state.file_length = size;
+  state.file_offset = 0;
+  state.file_mode = mode;
+  state.file_mtime = mtime;
+  return true;
+}
+
 const std::string
 archive_tar::next_file_name ()
 {
@@ -150,16 +214,25 @@ archive_tar::next_file_name ()
   if (n == 0)
     return std::string();
 
-  if (!state.have_longname && state.tar_header.typeflag != 'L')
+  if (!parse_header ())
     {
-      memcpy (state.filename, state.tar_header.name, 100);
-      state.filename[100] = 0;
+      LogPlainPrintf ("error: damaged tar header after %s\n", state.filename);
+      state.archive_err = EIO;
+      return std::string();
     }
-  else if (state.have_longname)
-    state.have_longname = 0;
 
-  sscanf (state.tar_header.size, "%Io", &state.file_length);
-  state.file_offset = 0;
+  switch (state.tar_header.typeflag)
+    {
+    case 'L':			/* GNU tar long name extension */
+    case 'K':			/* GNU tar long link name extension */
+    case 'g':			/* POSIX.1-2001 global extended header */
+    case 'x':			/* POSIX.1-2001 extended header */
+      /* these describe the member which follows */
+      break;
+    default:
+      member_header ();
+      break;
+    }
 
   if (_tar_verbose)
     LogBabblePrintf ("%c %9d %s\n", state.tar_header.typeflag,
@@ -168,6 +241,7 @@ archive_tar::next_file_name ()
   switch (state.tar_header.typeflag)
     {
     case 'L':			/* GNU tar long name extension */
+    case 'K':			/* GNU tar long link name extension */
       /* we read the 'file' into the long filename, then call back into here
        * to find out if the actual file is a real file, or a special file..
        */
@@ -177,31 +251,44 @@ archive_tar::next_file_name ()
 	  LogPlainPrintf( "error: long file name exceeds %d characters\n",
                           CYG_PATH_MAX);
 	  err++;
-	  state.parent->read (&state.tar_header, 512);
-	  sscanf (state.tar_header.size, "%Io", &state.file_length);
-	  state.file_offset = 0;
+	  if (state.parent->read (&state.tar_header, 512) != 512
+	      || !parse_header ())
+	    {
+	      state.archive_err = EIO;
+	      return std::string();
+	    }
+	  member_header ();
 	  skip_file ();
 	  return next_file_name ();
 	}
-      c = state.filename;
-      /* FIXME: this should be a single read() call */
-      while (state.file_length > state.file_offset)
+      c = state.tar_header.typeflag == 'L' ? state.filename : state.linkname;
+      /* the name, padded out to a whole block, fits in filename */
+      if (state.file_length
+	  && state.parent->read (c, blocks (state.file_length) * 512)
+	     != (ssize_t) (blocks (state.file_length) * 512))
+	// FIXME: What's up with the "0"? It's probably a mistake, and
+	// should be "". It used to be written as 0, and was subject to a
+	// bizarre implicit conversion by the unwise String(int)
+	// constructor.
+	return "0";
+      c[state.file_length] = 0;
+      state.file_offset = state.file_length;
+      if (state.tar_header.typeflag == 'L')
+	state.have_longname = 1;
+      else
+	state.have_longlink = 1;
+      skip_file ();
+      return next_file_name ();
+
+    case 'g':			/* POSIX.1-2001 global extended header */
+    case 'x':			/* POSIX.1-2001 extended header */
+      if (!read_pax (state.tar_header.typeflag == 'g'))
 	{
-	  int need =
-	    state.file_length - state.file_offset >
-	    512 ? 512 : state.file_length - state.file_offset;
-	  if (state.parent->read (buf, 512) < 512)
-	    // FIXME: What's up with the "0"? It's probably a mistake, and
-	    // should be "". It used to be written as 0, and was subject to a
-	    // bizarre implicit conversion by the unwise String(int)
-	    // constructor.
-	    return "0";
-	  memcpy (c, buf, need);
-	  c += need;
-	  state.file_offset += need;
+	  LogPlainPrintf ("error: damaged pax header before %s\n",
+			  state.filename);
+	  state.archive_err = EIO;
+	  return std::string();
 	}
-      *c = 0;
-      state.have_longname = 1;
       return next_file_name ();
 
     case '3':			/* char */
@@ -217,10 +304,14 @@ archive_tar::next_file_name ()
     case '2':			/* symbolic link */
     case '5':			/* directory */
     case '7':			/* contiguous file */
+      if (state.name_too_long)
+	break;
       state.header_read = 1;
       return state.filename;
 
     case '1':			/* hard link, we just copy */
+      if (state.name_too_long)
+	break;
       state.header_read = 1;
       return state.filename;
 
@@ -228,13 +319,208 @@ archive_tar::next_file_name ()
       LogPlainPrintf ("error: unknown (or unsupported) file type `%c'\n",
                       state.tar_header.typeflag);
       err++;
-      /* fall through */
-    case 'g':			/* POSIX.1-2001 global extended header */
-    case 'x':			/* POSIX.1-2001 extended header */
-      skip_file ();
-      return next_file_name ();
+      break;
     }
-  return std::string();
+  skip_file ();
+  return next_file_name ();
+}
+
+/* The header just read is of a member proper: take its name and link
+   target, unless they were given by the entries before it, and apply
+   any pax extended header to it. */
+void
+archive_tar::member_header ()
+{
+  if (!state.have_longname)
+    {
+      /* POSIX ustar splits a long name between prefix and name */
+      char *c = state.filename;
+      if (!memcmp (state.tar_header.magic, "ustar", 6)
+	  && state.tar_header.prefix[0])
+	{
+	  c += strnlen (state.tar_header.prefix, sizeof state.tar_header.prefix);
+	  memcpy (state.filename, state.tar_header.prefix, c - state.filename);
+	  *c++ = '/';
+	}
+      memcpy (c, state.tar_header.name, 100);
+      c[100] = 0;
+    }
+  if (!state.have_longlink)
+    {
+      memcpy (state.linkname, state.tar_header.linkname, 100);
+      state.linkname[100] = 0;
+    }
+  state.have_longname = 0;
+  state.have_longlink = 0;
+
+  if (state.have_pax_size)
+    state.file_length = state.pax_size;
+  state.file_mtime_nsec = 0;
+  if (state.have_pax_mtime)
+    {
+      state.file_mtime = state.pax_mtime;
+      state.file_mtime_nsec = state.pax_mtime_nsec;
+    }
+  else if (state.have_global_mtime)
+    {
+      state.file_mtime = state.global_mtime;
+      state.file_mtime_nsec = state.global_mtime_nsec;
+    }
+  state.have_pax_size = 0;
+  state.have_pax_mtime = 0;
+  state.name_too_long = state.pax_name_too_long;
+  state.pax_name_too_long = 0;
+}
+
+/* A decimal number, at most max, filling the whole of [p, end) */
+static bool
+pax_number (const char *p, const char *end, unsigned long long max,
+	    unsigned long long &value)
+{
+  value = 0;
+  if (p == end)
+    return false;
+  for (; p < end; p++)
+    {
+      if (*p < '0' || *p > '9' || value > (max - (*p - '0')) / 10)
+	return false;
+      value = value * 10 + (*p - '0');
+    }
+  return true;
+}
+
+/* A pax time: seconds, perhaps negative, and perhaps a fraction */
+static bool
+pax_time (const char *p, const char *end, time_t &secs, long &nsec)
+{
+  bool negative = p < end && *p == '-';
+  if (negative)
+    p++;
+  const char *dot = (const char *) memchr (p, '.', end - p);
+  unsigned long long s;
+  if (!pax_number (p, dot ? dot : end, 0x7fffffffffffffffULL, s))
+    return false;
+  nsec = 0;
+  if (dot)
+    {
+      long scale = 100000000;
+      for (p = dot + 1; p < end; p++, scale /= 10)
+	{
+	  if (*p < '0' || *p > '9')
+	    return false;
+	  nsec += (*p - '0') * scale;
+	}
+    }
+  secs = (time_t) s;
+  if (negative)
+    {
+      secs = -secs;
+      if (nsec)
+	{
+	  secs--;
+	  nsec = 1000000000 - nsec;
+	}
+    }
+  return true;
+}
+
+/* Read an extended header into state.pax, which is kept from one to the
+   next, and take the records of it which setup uses.  Of a global
+   header, only the mtime is used. */
+bool
+archive_tar::read_pax (bool global)
+{
+  size_t len = state.file_length;
+  if (len > PAX_HEADER_MAX)
+    {
+      LogPlainPrintf ("error: pax header of %lu bytes is too big\n",
+		      (unsigned long) len);
+      return false;
+    }
+  if (!len)
+    return skip_file () == 0;
+  size_t padded = blocks (len) * 512;
+  if (state.pax.size () < padded)
+    state.pax.resize (padded);
+  if (state.parent->read (&state.pax[0], padded) != (ssize_t) padded)
+    return false;
+  state.file_offset = len;
+  skip_file ();
+
+  /* each record is "<length> <key>=<value>\n", the length being of the
+     whole record */
+  const char *p = &state.pax[0];
+  const char *end = p + len;
+  while (p < end)
+    {
+      const char *space = (const char *) memchr (p, ' ', end - p);
+      unsigned long long reclen;
+      if (!space || !pax_number (p, space, end - p, reclen)
+	  || reclen < (unsigned long long) (space - p) + 4
+	  || p[reclen - 1] != '\n')
+	return false;
+      const char *key = space + 1;
+      const char *value_end = p + reclen - 1;
+      const char *eq = (const char *) memchr (key, '=', value_end - key);
+      if (!eq || eq == key)
+	return false;
+      const char *value = eq + 1;
+      size_t keylen = eq - key;
+      p += reclen;
+
+#define PAX_KEY(k) (keylen == sizeof (k) - 1 && !memcmp (key, k, keylen))
+      if (PAX_KEY ("mtime"))
+	{
+	  time_t secs;
+	  long nsec;
+	  if (!pax_time (value, value_end, secs, nsec))
+	    return false;
+	  if (global)
+	    {
+	      state.have_global_mtime = 1;
+	      state.global_mtime = secs;
+	      state.global_mtime_nsec = nsec;
+	    }
+	  else
+	    {
+	      state.have_pax_mtime = 1;
+	      state.pax_mtime = secs;
+	      state.pax_mtime_nsec = nsec;
+	    }
+	}
+      else if (global)
+	continue;
+      else if (PAX_KEY ("size"))
+	{
+	  unsigned long long size;
+	  if (!pax_number (value, value_end, (size_t) -1 - 511, size))
+	    return false;
+	  state.have_pax_size = 1;
+	  state.pax_size = size;
+	}
+      else if (PAX_KEY ("path") || PAX_KEY ("linkpath"))
+	{
+	  bool path = keylen == 4;
+	  size_t n = value_end - value;
+	  if (n > CYG_PATH_MAX)
+	    {
+	      LogPlainPrintf ("error: long file name exceeds %d characters\n",
+			      CYG_PATH_MAX);
+	      err++;
+	      state.pax_name_too_long = 1;
+	      continue;
+	    }
+	  char *to = path ? state.filename : state.linkname;
+	  memcpy (to, value, n);
+	  to[n] = 0;
+	  if (path)
+	    state.have_longname = 1;
+	  else
+	    state.have_longlink = 1;
+	}
+#undef PAX_KEY
+    }
+  return true;
 }
 
 archive_tar::~archive_tar ()
@@ -293,7 +579,7 @@ archive_tar::linktarget ()
   /* TODO: consider .. path traversal issues */
   if (next_file_type () == ARCHIVE_FILE_SYMLINK ||
       next_file_type () == ARCHIVE_FILE_HARDLINK)
-    return state.tar_header.linkname;
+    return state.linkname;
   return std::string();
 }
 
@@ -18,9 +18,11 @@
 #ifndef SETUP_ARCHIVE_TAR_H
 #define SETUP_ARCHIVE_TAR_H
 
+#include <vector>
+
 #include "io_stream.h"
 #include "archive.h"
-#include "win32.h"
+#include "path_max.h"
 
 typedef struct
 {
@@ -55,23 +57,51 @@ tar_map_result_type;
 class tar_state
 {
 public:
-  tar_state ():lasterr (0), eocf (0), have_longname ('\0'), file_offset (0),
-    file_length (0), header_read (0)
+  tar_state ():lasterr (0), archive_err (0), eocf (0), have_longname ('\0'),
+    have_longlink ('\0'), name_too_long ('\0'), file_offset (0),
+    file_length (0), file_mode (0), file_mtime (0), file_mtime_nsec (0),
+    header_read (0), have_pax_size ('\0'), have_pax_mtime ('\0'),
+    have_global_mtime ('\0'), pax_name_too_long ('\0')
   {
     parent = NULL;
     filename[0] = '\0';
+    linkname[0] = '\0';
     tar_map_result = NULL;
   };
   io_stream *parent;
+  /* a member stream was misused, by writing or seeking it */
   int lasterr;
+  /* a header was damaged or the parent stream failed, so the rest of the
+     archive cannot be read; what archive_tar::error () reports */
+  int archive_err;
   int eocf;
   char have_longname;
+  char have_longlink;
+  /* the name given for the member is one which cannot be extracted */
+  char name_too_long;
   /* where in the current file are we? */
   size_t file_offset;
   size_t file_length;
+  /* the numeric fields of tar_header, decoded as it is read */
+  mode_t file_mode;
+  time_t file_mtime;
+  long file_mtime_nsec;
   int header_read;
   tar_header_type tar_header;
   char filename[CYG_PATH_MAX + 512];
+  char linkname[CYG_PATH_MAX + 512];
+  /* the last pax extended header read, and what it says of the member
+     which follows it, or, if global, of all those which follow */
+  std::vector <char> pax;
+  char have_pax_size;
+  size_t pax_size;
+  char have_pax_mtime;
+  time_t pax_mtime;
+  long pax_mtime_nsec;
+  char have_global_mtime;
+  time_t global_mtime;
+  long global_mtime_nsec;
+  char pax_name_too_long;
   tar_map_result_type *tar_map_result;
 };
 
@@ -82,6 +112,10 @@ private:
 public:
   archive_tar_file (tar_state &);
   virtual ssize_t read (void *buffer, size_t len);
+  /* views of the parent's buffer, if it lends one */
+  virtual bool lends () {return state.parent->lends ();};
+  virtual ssize_t read_view (const void **data, size_t len);
+  virtual void consume (size_t len);
   /* provide data to (double duh!) */
   virtual ssize_t write (const void *buffer, size_t len);
   /* read data without removing it from the class's internal buffer */
@@ -94,6 +128,8 @@ public:
   virtual mode_t get_mode ();
   virtual size_t get_size () {return state.file_length;};
   virtual int set_mtime (time_t) { return 1; };
+  /* the part of a second after get_mtime (), if a pax header gave it */
+  long get_mtime_nsec () {return state.file_mtime_nsec;};
   virtual ~ archive_tar_file ();
 private:
     tar_state & state;
@@ -138,6 +174,9 @@ private:
     archive_tar ()
   {
   };
+  bool parse_header ();
+  void member_header ();
+  bool read_pax (bool global);
   tar_state state;
   unsigned int archive_children;
 };
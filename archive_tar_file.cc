@@ -39,9 +39,11 @@ ssize_t archive_tar_file::read (void *buffer, size_t len)
   /* how many bytes do we want to give the user */
   int
     want = std::min (len, state.file_length - state.file_offset);
-  /* how many do we need to read after that to line up the file pointer */
+  /* how many do we need to read after that to line up the file pointer,
+     once the end of the file is reached */
   int
-    roundup = (512 - (want % 512)) % 512;
+    roundup = state.file_offset + want == state.file_length
+	      ? (512 - (state.file_length % 512)) % 512 : 0;
   read_something = true;
   if (want)
     {
@@ -54,7 +56,7 @@ ssize_t archive_tar_file::read (void *buffer, size_t len)
             {
               /* unexpected EOF or read error in the tar parent stream */
               /* the user can query the parent for the error */
-              state.lasterr = EIO;
+              state.archive_err = EIO;
               return -1;
             }
           p += got;
@@ -70,7 +72,7 @@ ssize_t archive_tar_file::read (void *buffer, size_t len)
             {
               /* unexpected EOF or read error in the tar parent stream */
               /* the user can query the parent for the error */
-              state.lasterr = EIO;
+              state.archive_err = EIO;
               return -1;
             }
           p += got2;
@@ -83,6 +85,39 @@ ssize_t archive_tar_file::read (void *buffer, size_t len)
   return 0;
 }
 
+ssize_t
+archive_tar_file::read_view (const void **data, size_t len)
+{
+  *data = NULL;
+  size_t want = std::min (len, state.file_length - state.file_offset);
+  if (!want)
+    return 0;
+  ssize_t got = state.parent->read_view (data, want);
+  if (got <= 0)
+    {
+      /* unexpected EOF or read error in the tar parent stream */
+      /* the user can query the parent for the error */
+      state.archive_err = EIO;
+      return -1;
+    }
+  return got;
+}
+
+void
+archive_tar_file::consume (size_t len)
+{
+  read_something = true;
+  state.parent->consume (len);
+  state.file_offset += len;
+  /* at the end of the file, line up the file pointer as read () does */
+  if (state.file_offset == state.file_length)
+    {
+      size_t roundup = (512 - (state.file_length % 512)) % 512;
+      if (state.parent->skip (roundup) != (ssize_t) roundup)
+	state.archive_err = EIO;
+    }
+}
+
 /* provide data to (double duh!) */
 ssize_t archive_tar_file::write (const void *buffer, size_t len)
 {
@@ -108,7 +143,7 @@ ssize_t archive_tar_file::peek (void *buffer, size_t len)
 	{
 	  /* unexpected EOF or read error in the tar parent stream */
 	  /* the user can query the parent for the error */
-	  state.lasterr = EIO;
+	  state.archive_err = EIO;
 	  return -1;
 	}
     }
@@ -134,21 +169,17 @@ archive_tar_file::seek (long where, io_stream_seek_t whence)
 int
 archive_tar_file::error ()
 {
-  return state.lasterr;
+  return state.lasterr ? state.lasterr : state.archive_err;
 }
 
 time_t
 archive_tar_file::get_mtime ()
 {
-  unsigned long mtime;
-  sscanf (state.tar_header.mtime, "%lo", &mtime);
-  return (time_t) mtime;
+  return state.file_mtime;
 }
 
 mode_t
 archive_tar_file::get_mode ()
 {
-  unsigned long mode;
-  sscanf (state.tar_header.mode, "%lo", &mode);
-  return (mode_t) mode;
+  return state.file_mode;
 }
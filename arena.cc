@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+#include "arena.h"
+
+#include <string.h>
+
+Arena::Arena (size_t size)
+  : head (NULL), cur (NULL), end (NULL), block_size (size), nblocks (0)
+{
+}
+
+void *
+Arena::alloc (size_t len)
+{
+  len = (len + header - 1) & ~(header - 1);
+  if (len <= (size_t) (end - cur))
+    {
+      void *p = cur;
+      cur += len;
+      return p;
+    }
+
+  /* Big allocations get a block to themselves, rather than wasting what
+     is left of the current one. */
+  bool big = len > block_size / 4;
+  size_t size = big ? len : block_size;
+  char *mem = new char[header + size];
+  block *b = (block *) mem;
+  b->next = head;
+  head = b;
+  nblocks++;
+
+  if (big)
+    return mem + header;
+  cur = mem + header + len;
+  end = mem + header + size;
+  return mem + header;
+}
+
+char *
+Arena::strndup (const char *str, size_t len)
+{
+  char *p = (char *) alloc (len + 1);
+  memcpy (p, str, len);
+  p[len] = '\0';
+  return p;
+}
+
+void
+Arena::release ()
+{
+  while (head)
+    {
+      block *next = head->next;
+      delete[] (char *) head;
+      head = next;
+    }
+  cur = end = NULL;
+  nblocks = 0;
+}
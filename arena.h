@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+#ifndef SETUP_ARENA_H
+#define SETUP_ARENA_H
+
+#include <stddef.h>
+
+/* A bump allocator.  Allocations are carved out of large blocks and are
+   never freed individually; everything goes at once, on release () or
+   destruction.  This suits data with a common lifetime, such as the
+   tokens of one setup.ini parse. */
+class Arena
+{
+public:
+  Arena (size_t block_size = 64 * 1024);
+  ~Arena () { release (); }
+  /* len bytes, suitably aligned for any type */
+  void *alloc (size_t len);
+  /* a NUL-terminated copy of the len bytes at str */
+  char *strndup (const char *str, size_t len);
+  void release ();
+  /* the number of blocks taken from the heap since the last release () */
+  size_t blocks () const { return nblocks; }
+private:
+  struct block
+  {
+    block *next;
+  };
+  static const size_t header = 16;
+
+  block *head;
+  char *cur;
+  char *end;
+  size_t block_size;
+  size_t nblocks;
+
+  Arena (const Arena &); // no copy cons
+  Arena &operator= (const Arena &); // no assignment
+};
+
+#endif /* SETUP_ARENA_H */
@@ -31,7 +31,7 @@
 
 #define longest_magic 18 /* ZStandard longest frame header (magic is only 4 bytes) */
 
-io_stream *compress::decompress(io_stream *original) 
+io_stream *compress::decompress(io_stream *original, unsigned int threads)
 {
   if (!original) return NULL;
   
@@ -54,14 +54,14 @@ io_stream *compress::decompress(io_stream *original)
       delete rv;
       return NULL;
     } else if (memcmp(magic, "BZh", 3) == 0) {
-      compress_bz *rv = new compress_bz(original);
+      compress_bz *rv = new compress_bz(original, threads);
       if (!rv->error()) return rv;
       /* else */
       rv->release_original();
       delete rv;
       return NULL;
     } else if (compress_xz::is_xz_or_lzma(magic, 14)) {
-      compress_xz *rv = new compress_xz(original);
+      compress_xz *rv = new compress_xz(original, threads);
       if (!rv->error()) return rv;
       /* else */
       rv->release_original();
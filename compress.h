@@ -24,9 +24,10 @@ public:
   /* Get a decompressed stream from a normal stream. If this function returns non-null
    * a valid compress header was found. The io_stream pointer passed to decompress
    * should be discarded. The old io_stream will be automatically closed when the 
-   * decompression stream is closed
+   * decompression stream is closed.  threads is how many threads the stream
+   * may be decoded with, where the format allows; 1 decodes it as it is read.
    */
-  static io_stream *decompress (io_stream *);
+  static io_stream *decompress (io_stream *, unsigned int threads = 1);
   /* 
    * To create a stream that will be compressed, you should open the url, and then get a new stream
    * from compress::compress. 
@@ -17,13 +17,471 @@
    functions in the libbz2 package.  */
 
 #include "compress_bz.h"
+#include "threadpool.h"
 
+#include <algorithm>
+#include <deque>
 #include <stdexcept>
+#include <memory>
 
 #include <errno.h>
+#include <stdint.h>
 #include <string.h>
 
-compress_bz::compress_bz (io_stream * parent) : peeklen (0), position (0)
+/* A stream of no more than this is decoded as it is read: it is a block
+   or two at most, and not worth the threads. */
+static const size_t parallel_min = 256 * 1024;
+/* how much input is read at a time while cutting it into blocks */
+static const size_t scan_chunk = 256 * 1024;
+
+/* the 48 bit magic numbers before each block and at the end of each
+   stream, which are not aligned to bytes */
+static const uint64_t block_magic = 0x314159265359ULL;
+static const uint64_t eos_magic = 0x177245385090ULL;
+
+/* One block of a bzip2 stream, as cut out of it at its magic number, or
+   the end of a stream, or an error found while cutting. */
+struct bz_block
+{
+  bz_block () : shift (0), bits (0), crc (0), level ('9'), end (false),
+    err (0), done (false) {}
+  std::string in;	/* bytes holding the block */
+  unsigned int shift;	/* the bit of in[0] it starts at */
+  size_t bits;		/* up to the next magic number; 0 for an error */
+  uint32_t crc;		/* the block's CRC, or the stream's if end */
+  char level;		/* from the header of its stream: '1' to '9' */
+  bool end;
+  std::string out;
+  int err;
+  bool done;
+};
+
+/* bits [bit, bit + n) of in, where n <= 32 */
+static uint32_t
+get_bits (const std::string &in, size_t bit, unsigned int n)
+{
+  uint64_t v = 0;
+  for (size_t i = bit / 8; i < (bit + n + 7) / 8; i++)
+    v = v << 8 | (unsigned char) in[i];
+  return (v >> ((8 - (bit + n) % 8) % 8)) & ((1ULL << n) - 1);
+}
+
+/* The bit of in at which the first block or end of stream magic number
+   at or after bit from starts, or npos if there is none wholly in in.  A
+   block may hold either by chance; see parallel_state::scan () and
+   parallel_state::read (). */
+static size_t
+find_magic (const std::string &in, size_t from)
+{
+  const unsigned char *p = (const unsigned char *) in.data ();
+  const uint64_t mask = (1ULL << 48) - 1;
+  uint64_t v = 0;
+  for (size_t i = from / 8; i < in.size (); i++)
+    {
+      v = v << 8 | p[i];
+      for (int s = 7; s >= 0; s--)
+	{
+	  uint64_t w = (v >> s) & mask;
+	  if ((w == block_magic || w == eos_magic)
+	      && (i + 1) * 8 >= from + s + 48)
+	    return (i + 1) * 8 - s - 48;
+	}
+    }
+  return std::string::npos;
+}
+
+/* Appends bits to a string, most significant first */
+class bit_writer
+{
+public:
+  bit_writer (std::string &out) : out (out), acc (0), n (0) {}
+  /* the low count bits of v; count <= 32 */
+  void put (uint64_t v, unsigned int count)
+  {
+    acc = acc << count | (v & ((1ULL << count) - 1));
+    for (n += count; n >= 8; n -= 8)
+      out += (char) (acc >> (n - 8));
+  }
+  void put (const bz_block &b)
+  {
+    const unsigned char *p = (const unsigned char *) b.in.data ();
+    size_t bits = b.bits;
+    if (b.shift)
+      {
+	unsigned int first = std::min ((size_t) 8 - b.shift, bits);
+	put (*p++ >> (8 - b.shift - first), first);
+	bits -= first;
+      }
+    for (; bits >= 8; bits -= 8)
+      put (*p++, 8);
+    if (bits)
+      put (*p >> (8 - bits), bits);
+  }
+  /* pad to a byte */
+  void flush ()
+  {
+    if (n)
+      put (0, 8 - n);
+  }
+private:
+  std::string &out;
+  uint64_t acc;
+  unsigned int n;
+};
+
+/* Decode b, and next after it if given, as a stream of its own: libbz2
+   cannot start at a block, so give it a header before and a stream end
+   after, whose CRC is that of the one block. */
+static void
+decode_block (bz_block &b, const bz_block *next)
+{
+  std::string s;
+  s.reserve (b.in.size () + (next ? next->in.size () : 0) + 16);
+  s += "BZh";
+  s += b.level;
+  bit_writer w (s);
+  w.put (b);
+  if (next)
+    w.put (*next);
+  w.put (eos_magic >> 24, 24);
+  w.put (eos_magic, 24);
+  w.put (b.crc, 32);
+  w.flush ();
+
+  bz_stream strm;
+  memset (&strm, 0, sizeof strm);
+  if (BZ2_bzDecompressInit (&strm, 0, 0) != BZ_OK)
+    {
+      b.err = BZ_MEM_ERROR;
+      return;
+    }
+  strm.next_in = &s[0];
+  strm.avail_in = s.size ();
+  /* a block holds level * 100k bytes, before the run lengths in it are
+     expanded */
+  b.out.resize ((b.level - '0') * 100000);
+  size_t done = 0;
+  int ret;
+  while (1)
+    {
+      strm.next_out = &b.out[done];
+      strm.avail_out = b.out.size () - done;
+      ret = BZ2_bzDecompress (&strm);
+      done = b.out.size () - strm.avail_out;
+      if (ret != BZ_OK || strm.avail_out)
+	break;
+      b.out.resize (b.out.size () * 2);
+    }
+  BZ2_bzDecompressEnd (&strm);
+  b.out.resize (done);
+  if (ret == BZ_STREAM_END)
+    b.err = 0;
+  else
+    b.err = ret == BZ_OK ? BZ_UNEXPECTED_EOF : ret;
+}
+
+/* Cuts a bzip2 stream into its blocks as it is read, decodes them on a
+   pool of threads and hands back what they hold in order, keeping twice
+   as many blocks as threads in hand. */
+struct compress_bz::parallel_state
+{
+  parallel_state (io_stream *original, std::string &head,
+		  unsigned int threads);
+  ~parallel_state ();
+  /* as io_stream::read (); sets err on an error */
+  ssize_t read (void *buffer, size_t len, int &err);
+
+private:
+  bool scan ();
+  bool stream_end ();
+  bool more ();
+  bool have (size_t bits);
+  bool cut (int err);
+  void decode (std::shared_ptr<bz_block> b);
+
+  io_stream *original;
+  ThreadPool *pool;
+  size_t queue_max;
+  CRITICAL_SECTION lock;
+  CONDITION_VARIABLE block_done;
+  bool stopping;
+
+  /* read by the workers only once done */
+  std::deque<std::shared_ptr<bz_block> > blocks;
+  size_t out_pos;
+  uint32_t combined;
+
+  /* the input not yet cut up, from the start of the block being cut */
+  std::string in;
+  size_t pos;
+  size_t search;
+  enum { HEADER, BLOCK, END, DONE } state;
+  char level;
+  bool eof;
+  int read_err;
+
+  parallel_state (const parallel_state &); // no copy cons
+  parallel_state &operator= (const parallel_state &); // no assignment
+};
+
+compress_bz::parallel_state::parallel_state (io_stream *original,
+					     std::string &head,
+					     unsigned int threads)
+  : original (original), pool (new ThreadPool (threads)),
+    queue_max (2 * threads), stopping (false), out_pos (0), combined (0),
+    pos (0), search (0), state (HEADER), level ('9'), eof (false),
+    read_err (0)
+{
+  InitializeCriticalSection (&lock);
+  InitializeConditionVariable (&block_done);
+  in.swap (head);
+}
+
+compress_bz::parallel_state::~parallel_state ()
+{
+  /* let the workers skip what they have yet to start */
+  EnterCriticalSection (&lock);
+  stopping = true;
+  LeaveCriticalSection (&lock);
+  delete pool;
+  DeleteCriticalSection (&lock);
+}
+
+void
+compress_bz::parallel_state::decode (std::shared_ptr<bz_block> b)
+{
+  EnterCriticalSection (&lock);
+  bool skip = stopping;
+  LeaveCriticalSection (&lock);
+  if (!skip)
+    decode_block (*b, NULL);
+  EnterCriticalSection (&lock);
+  b->done = true;
+  WakeAllConditionVariable (&block_done);
+  LeaveCriticalSection (&lock);
+}
+
+/* Read more input, dropping what has been cut up; false at the end of it
+   or on an error. */
+bool
+compress_bz::parallel_state::more ()
+{
+  if (eof)
+    return false;
+  size_t drop = pos / 8;
+  in.erase (0, drop);
+  pos -= drop * 8;
+  search = search > drop * 8 ? search - drop * 8 : 0;
+
+  size_t had = in.size ();
+  in.resize (had + scan_chunk);
+  ssize_t got = original->read (&in[had], scan_chunk);
+  in.resize (had + (got > 0 ? got : 0));
+  if (got < 0)
+    read_err = original->error () ? original->error () : EIO;
+  if (got <= 0)
+    eof = true;
+  return got > 0;
+}
+
+/* whether there are bits of input after pos, reading more if need be */
+bool
+compress_bz::parallel_state::have (size_t bits)
+{
+  while (in.size () * 8 < pos + bits)
+    if (!more ())
+      return false;
+  return true;
+}
+
+/* Queue the block from pos up to search, or an error if err; true */
+bool
+compress_bz::parallel_state::cut (int err)
+{
+  std::shared_ptr<bz_block> b (new bz_block);
+  if (err)
+    {
+      b->err = err;
+      b->done = true;
+      state = DONE;
+    }
+  else
+    {
+      b->in.assign (in, pos / 8, (search + 7) / 8 - pos / 8);
+      b->shift = pos % 8;
+      b->bits = search - pos;
+      b->crc = get_bits (in, pos + 48, 32);
+      b->level = level;
+    }
+  blocks.push_back (b);
+  if (!err)
+    pool->submit ([this, b] () { decode (b); });
+  return true;
+}
+
+/* Whether the end of stream magic number at search really ends a stream,
+   rather than being part of a block by chance: if so, its CRC is followed
+   by zeros up to a byte, then by the end of the input or another stream. */
+bool
+compress_bz::parallel_state::stream_end ()
+{
+  while (in.size () * 8 < (search + 48 + 32 + 7) / 8 * 8 + 32)
+    if (!more ())
+      break;
+  size_t end = search + 48 + 32;
+  size_t next = (end + 7) / 8 * 8;
+  if (in.size () * 8 < next
+      || (next > end && get_bits (in, end, next - end)))
+    return false;
+  if (in.size () * 8 == next)
+    return true;
+  return in.size () * 8 >= next + 32
+    && get_bits (in, next, 24) == 0x425a68 /* BZh */
+    && in[next / 8 + 3] >= '1' && in[next / 8 + 3] <= '9';
+}
+
+/* Cut the next block or stream end out of the input and queue it; false
+   at the end of the input. */
+bool
+compress_bz::parallel_state::scan ()
+{
+  while (1)
+    switch (state)
+      {
+      case HEADER:
+	/* after the end of a stream, there may be another */
+	if (!have (8) && !read_err)
+	  {
+	    state = DONE;
+	    return false;
+	  }
+	if (!have (32 + 48))
+	  return cut (read_err ? read_err : EIO);
+	level = in[pos / 8 + 3];
+	if (get_bits (in, pos, 24) != 0x425a68 /* BZh */
+	    || level < '1' || level > '9')
+	  return cut (BZ_DATA_ERROR_MAGIC);
+	pos += 32;
+	if (get_bits (in, pos, 24) == block_magic >> 24
+	    && get_bits (in, pos + 24, 24) == (block_magic & 0xffffff))
+	  {
+	    state = BLOCK;
+	    search = pos + 48 + 32;
+	  }
+	else
+	  state = END;
+	break;
+
+      case BLOCK:
+	{
+	  size_t next;
+	  while ((next = find_magic (in, search)) == std::string::npos)
+	    {
+	      if (in.size () * 8 > search + 47)
+		search = in.size () * 8 - 47;
+	      if (!more ())
+		return cut (read_err ? read_err : EIO);
+	    }
+	  search = next;
+	  if (get_bits (in, search, 24) == eos_magic >> 24 && !stream_end ())
+	    {
+	      /* in the block, so look on past it */
+	      search++;
+	      break;
+	    }
+	  cut (0);
+	  pos = search;
+	  if (get_bits (in, pos, 24) == block_magic >> 24)
+	    search = pos + 48 + 32;
+	  else
+	    state = END;
+	  return true;
+	}
+
+      case END:
+	{
+	  if (!have (48 + 32))
+	    return cut (read_err ? read_err : EIO);
+	  if (get_bits (in, pos, 24) != eos_magic >> 24
+	      || get_bits (in, pos + 24, 24) != (eos_magic & 0xffffff))
+	    return cut (BZ_DATA_ERROR);
+	  std::shared_ptr<bz_block> b (new bz_block);
+	  b->end = true;
+	  b->crc = get_bits (in, pos + 48, 32);
+	  b->done = true;
+	  blocks.push_back (b);
+	  pos = (pos + 48 + 32 + 7) / 8 * 8;
+	  state = HEADER;
+	  return true;
+	}
+
+      case DONE:
+	return false;
+      }
+}
+
+ssize_t
+compress_bz::parallel_state::read (void *buffer, size_t len, int &err)
+{
+  size_t done = 0;
+  while (done < len)
+    {
+      while (blocks.size () < queue_max && scan ())
+	;
+      if (blocks.empty ())
+	break;
+      std::shared_ptr<bz_block> b = blocks.front ();
+      EnterCriticalSection (&lock);
+      while (!b->done)
+	SleepConditionVariableCS (&block_done, &lock, INFINITE);
+      LeaveCriticalSection (&lock);
+
+      if (b->end)
+	{
+	  if (b->crc != combined)
+	    {
+	      err = BZ_DATA_ERROR;
+	      return -1;
+	    }
+	  combined = 0;
+	  blocks.pop_front ();
+	  continue;
+	}
+      /* A block may hold a block magic number by chance, which cuts it
+	 in two and makes nonsense of the first half: decode it whole.  If
+	 that fails too, the caller starts again as the data is read. */
+      if (b->err && b->bits && blocks.size () > 1
+	  && blocks[1]->bits && !blocks[1]->end)
+	{
+	  decode_block (*b, blocks[1].get ());
+	  if (!b->err)
+	    blocks.erase (blocks.begin () + 1);
+	  b->bits = 0;
+	}
+      if (b->err)
+	{
+	  err = b->err;
+	  return -1;
+	}
+      if (!out_pos)
+	combined = (combined << 1 | combined >> 31) ^ b->crc;
+
+      size_t n = std::min (len - done, b->out.size () - out_pos);
+      memcpy ((char *) buffer + done, b->out.data () + out_pos, n);
+      done += n;
+      out_pos += n;
+      if (out_pos == b->out.size ())
+	{
+	  blocks.pop_front ();
+	  out_pos = 0;
+	}
+    }
+  return done;
+}
+
+compress_bz::compress_bz (io_stream * parent, unsigned int threads) :
+  threads (threads), peeklen (0), position (0), started (false), origin (0),
+  parallel (NULL)
 {
   /* read only via this constructor */
   original = 0;
@@ -71,7 +529,7 @@ compress_bz::read (void *buffer, size_t len)
       ssize_t tmplen = std::min (peeklen, len);
       peeklen -= tmplen;
       memcpy (buffer, peekbuf, tmplen);
-      memmove (peekbuf, peekbuf + tmplen, tmplen);
+      memmove (peekbuf, peekbuf + tmplen, peeklen);
       ssize_t tmpread = read (&((char *) buffer)[tmplen], len - tmplen);
       if (tmpread >= 0)
         return tmpread + tmplen;
@@ -79,6 +537,18 @@ compress_bz::read (void *buffer, size_t len)
         return tmpread;
   }
 
+  if (!started && !start ())
+    return -1;
+  if (parallel)
+    {
+      ssize_t got = parallel->read (buffer, len, lasterr);
+      if (got > 0)
+	position += got;
+      /* libbz2 found fault with what was cut out of the stream */
+      if (got >= 0 || lasterr >= 0 || !restart ())
+	return got;
+    }
+
   strm.avail_out = len;
   strm.next_out = (char *) buffer;
   int rlen = 1;
@@ -140,6 +610,77 @@ compress_bz::read (void *buffer, size_t len)
   return 0;
 }
 
+/* Read ahead, to see whether the stream is large enough to decode in
+   parallel; if not, the serial decoder starts on what was read. */
+bool
+compress_bz::start ()
+{
+  started = true;
+  if (threads < 2)
+    return true;
+  origin = original->tell ();
+  head.resize (parallel_min);
+  size_t got = 0;
+  ssize_t n = 0;
+  while (got < parallel_min
+	 && (n = original->read (&head[got], parallel_min - got)) > 0)
+    got += n;
+  head.resize (got);
+  if (n < 0)
+    {
+      lasterr = original->error ();
+      return false;
+    }
+  if (got == parallel_min)
+    parallel = new parallel_state (original, head, threads);
+  else
+    {
+      strm.next_in = &head[0];
+      strm.avail_in = head.size ();
+    }
+  return true;
+}
+
+/* The blocks decoded in parallel were cut out of the stream wrongly, or
+   the stream is damaged: decode it again from the start as it is read,
+   skipping what has been read already, so that it is only an error if
+   libbz2 finds it so. */
+bool
+compress_bz::restart ()
+{
+  delete parallel;
+  parallel = NULL;
+  if (original->seek (origin, IO_SEEK_SET))
+    return false;
+  BZ2_bzDecompressEnd (&strm);
+  int ret = BZ2_bzDecompressInit (&strm, 0, 0);
+  if (ret)
+    {
+      initialisedOk = 0;
+      lasterr = ret;
+      return false;
+    }
+  strm.avail_in = 0;
+  strm.next_in = 0;
+
+  /* what was peeked is past position already */
+  size_t peeked = peeklen;
+  size_t skip = position;
+  peeklen = 0;
+  position = 0;
+  lasterr = 0;
+  char scratch[16384];
+  while (position < skip)
+    if (read (scratch, std::min (sizeof scratch, skip - position)) <= 0)
+      {
+	if (!lasterr)
+	  lasterr = BZ_DATA_ERROR;
+	return false;
+      }
+  peeklen = peeked;
+  return true;
+}
+
 ssize_t compress_bz::write (const void *buffer, size_t len)
 {
   throw new std::logic_error ("compress_bz::write is not implemented");
@@ -235,6 +776,7 @@ compress_bz::release_original ()
 
 compress_bz::~compress_bz ()
 {
+  delete parallel;
   if (initialisedOk)
     BZ2_bzDecompressEnd (&strm);
   if (original && owns_original)
@@ -19,12 +19,14 @@
 #include "compress.h"
 
 #include <bzlib.h>
+#include <string>
 
 class compress_bz:public compress
 {
 public:
-  /* assumes decompression */
-  compress_bz (io_stream *);
+  /* assumes decompression, with up to threads threads, a block at a time
+     on each; 1 decodes it as one stream, as it is read */
+  compress_bz (io_stream *, unsigned int threads = 1);
   /* allows comp/decomp but this implementation only handles comp */
   compress_bz (io_stream *, const char *);
   /* read data (duh!) */
@@ -56,8 +58,11 @@ public:
   /* if you are still needing these hints... give up now! */
     virtual ~ compress_bz ();
 private:
+  bool start ();
+  bool restart ();
   io_stream *original;
   bool owns_original;
+  unsigned int threads;
   char peekbuf[512];
   size_t peeklen;
   int lasterr;
@@ -67,6 +72,12 @@ private:
   char buf[4096];
   int writing;
   size_t position;
+  bool started;
+  /* the input read by start (), and where it started */
+  std::string head;
+  long origin;
+  struct parallel_state;
+  parallel_state *parallel;
 };
 
 #endif /* SETUP_COMPRESS_BZ_H */
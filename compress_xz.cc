@@ -40,13 +40,21 @@ le64dec(const void *pp)
   return (((uint64_t)le32dec(p + 4) << 32) | le32dec(p));
 }
 
+/* What a 32-bit process can spare of its address space for threaded
+   decoding, whatever the machine has */
+#define MEMLIMIT_THREADING_32 (512U << 20)
+
 /*
  * Predicate: the stream is open for read.
  */
-compress_xz::compress_xz (io_stream * parent)
+size_t compress_xz::in_block_size = 64 * 1024;
+size_t compress_xz::out_block_size = 64 * 1024;
+
+compress_xz::compress_xz (io_stream * parent, unsigned int threads)
 :
   original(NULL),
   owns_original(true),
+  threads(threads),
   peeklen(0),
   lasterr(0),
   compression_type (COMPRESSION_UNKNOWN)
@@ -90,6 +98,26 @@ compress_xz::compress_xz (io_stream * parent)
 ssize_t
 compress_xz::read (void *buffer, size_t len)
 {
+  size_t done = 0;
+  while (done < len)
+    {
+      const void *data;
+      ssize_t got = read_view (&data, len - done);
+      if (got < 0)
+        return -1;
+      if (got == 0)
+        break;
+      memcpy (&((char *) buffer)[done], data, got);
+      consume (got);
+      done += got;
+    }
+  return done;
+}
+
+ssize_t
+compress_xz::read_view (const void **data, size_t len)
+{
+  *data = NULL;
   if (   compression_type != COMPRESSION_XZ
       && compression_type != COMPRESSION_LZMA)
     {
@@ -109,47 +137,56 @@ compress_xz::read (void *buffer, size_t len)
   /* peekbuf is layered on top of existing buffering code */
   if (this->peeklen)
     {
-      ssize_t tmplen = std::min (this->peeklen, len);
-      this->peeklen -= tmplen;
-      memcpy (buffer, this->peekbuf, tmplen);
-      memmove (this->peekbuf, this->peekbuf + tmplen, sizeof(this->peekbuf) - tmplen);
-      ssize_t tmpread = read (&((char *) buffer)[tmplen], len - tmplen);
-      if (tmpread >= 0)
-        return tmpread + tmplen;
-      else
-        return tmpread;
+      *data = this->peekbuf;
+      return std::min (this->peeklen, len);
     }
 
-  if (state->out_p < state->out_block + state->out_pos)
-  /* out_p - out_block < out_pos, but avoid sign/unsigned warning */
+  /* out_p - out_block == out_pos, but avoid sign/unsigned warning */
+  if (state->out_p == state->out_block + state->out_pos && fill ())
     {
-      ssize_t tmplen = std::min ((size_t)(state->out_block + state->out_pos - state->out_p), len);
-      memcpy (buffer, state->out_p, tmplen);
-      state->out_p += tmplen;
-      ssize_t tmpread = read (&((char *) buffer)[tmplen], len - tmplen);
-      if (tmpread >= 0)
-        return tmpread + tmplen;
-      else
-        return tmpread;
+      return -1;
     }
+  *data = state->out_p;
+  return std::min ((size_t)(state->out_block + state->out_pos - state->out_p), len);
+}
 
-  size_t lenRemaining = len;
-  unsigned char * bufp = (unsigned char *)buffer;
+void
+compress_xz::consume (size_t len)
+{
+  if (this->peeklen)
+    {
+      this->peeklen -= len;
+      memmove (this->peekbuf, this->peekbuf + len, this->peeklen);
+    }
+  else
+    state->out_p += len;
+}
+
+/* Decompress into out_block, all of which has been read, until there is
+ * some output or the end of the compressed data.  Returns -1 on error,
+ * with lasterr set.
+ */
+int
+compress_xz::fill ()
+{
   size_t avail_in = 0;
   size_t avail_out = 0;
   size_t decompressed = 0;
   size_t consumed = 0;
-  /* if we made it here, any existing uncompressed data in out_block
-   * has been consumed, so reset out_p and out_pos
-   */
   state->out_p = state->out_block;
   state->out_pos = 0;
-  do
+  while (state->out_pos == 0 && !state->eof)
     {
       if (state->in_pos == state->in_size)
         {
 	  /* no compressed data ready; read some more */
-          state->in_size = (size_t) this->original->read(state->in_block, state->in_block_size);
+          ssize_t got = this->original->read (state->in_block, state->in_block_size);
+          if (got < 0)
+            {
+              this->lasterr = EIO;
+              return -1;
+            }
+          state->in_size = got;
           state->in_pos = 0;
         }
 
@@ -169,12 +206,6 @@ compress_xz::read (void *buffer, size_t len)
 
       state->in_pos += consumed;
       state->out_pos += decompressed;
-
-      ssize_t tmplen = std::min (decompressed, lenRemaining);
-      memcpy (bufp, state->out_p, tmplen);
-      state->out_p += tmplen;
-      bufp += tmplen;
-      lenRemaining -= tmplen;
       state->total_out += decompressed;
       state->total_in += consumed;
 
@@ -219,9 +250,8 @@ compress_xz::read (void *buffer, size_t len)
             return -1;
         }
     }
-  while (lenRemaining != 0 && !state->eof);
 
-  return (len - lenRemaining);
+  return 0;
 }
 
 ssize_t
@@ -239,8 +269,11 @@ compress_xz::peek (void *buffer, size_t len)
 
   if (len > this->peeklen)
     {
-      size_t want = len - this->peeklen;
-      ssize_t got = read (&(this->peekbuf[peeklen]), want);
+      /* read past what is already in peekbuf, onto the end of it */
+      size_t held = this->peeklen;
+      this->peeklen = 0;
+      ssize_t got = read (&(this->peekbuf[held]), len - held);
+      this->peeklen = held;
       if (got >= 0)
         this->peeklen += got;
       else
@@ -395,6 +428,29 @@ compress_xz::init_decoder (void)
   switch (compression_type)
     {
       case COMPRESSION_XZ:
+#if LZMA_VERSION >= 50040002
+	if (threads > 1)
+	  {
+	    /* liblzma only decodes in parallel if the stream is in several
+	       blocks with their sizes in their headers, as xz -T writes
+	       them; otherwise it decodes in this thread, as
+	       lzma_stream_decoder does. */
+	    lzma_mt mt;
+	    memset (&mt, 0, sizeof (mt));
+	    mt.flags = LZMA_CONCATENATED;
+	    mt.threads = threads;
+	    /* a quarter of memory, or of what a 32-bit process can address,
+	       beyond which it uses fewer threads; only one stream at a time
+	       is given more than one */
+	    uint64_t memlimit = lzma_physmem () / 4;
+	    if (sizeof (void *) < 8 && memlimit > MEMLIMIT_THREADING_32)
+	      memlimit = MEMLIMIT_THREADING_32;
+	    mt.memlimit_threading = memlimit;
+	    mt.memlimit_stop = (1U << 30);
+	    ret = lzma_stream_decoder_mt (&(state->stream), &mt);
+	    break;
+	  }
+#endif
 	ret = lzma_stream_decoder (&(state->stream),
                                    (1U << 30),/* memlimit */
                                    LZMA_CONCATENATED);
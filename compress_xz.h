@@ -22,8 +22,14 @@
 class compress_xz:public compress
 {
 public:
-  compress_xz (io_stream *); /* decompress (read) only */
+  /* decompress (read) only, with up to threads threads; 1 uses the single
+     threaded decoder */
+  compress_xz (io_stream *, unsigned int threads = 1);
   virtual ssize_t read (void *buffer, size_t len);
+  /* lends out_block */
+  virtual bool lends () { return true; };
+  virtual ssize_t read_view (const void **data, size_t len);
+  virtual void consume (size_t len);
   virtual ssize_t write (const void *buffer, size_t len); /* not implemented */
   virtual ssize_t peek (void *buffer, size_t len);
   virtual long tell (); /* not implemented */
@@ -41,15 +47,23 @@ public:
   static int  bid_lzma (void *buffer, size_t len);
   virtual void release_original(); /* give up ownership of original io_stream */
 
+  /* the sizes of the buffers compressed data is read into and decoded
+     into, for streams made after they are set: 64 KiB each, unless
+     DecompressBench is trying others */
+  static size_t in_block_size;
+  static size_t out_block_size;
+
 private:
   compress_xz () {};
 
   io_stream *original;
   bool owns_original;
+  unsigned int threads;
   char peekbuf[512];
   size_t peeklen;
   int lasterr;
   void destroy ();
+  int fill ();
 
   struct private_data {
     lzma_stream      stream;
@@ -76,8 +90,6 @@ private:
 
   compression_type_t compression_type;
 
-  static const size_t out_block_size = 64 * 1024;
-  static const size_t in_block_size = 64 * 1024;
   struct private_data *state;
 };
 
@@ -12,6 +12,7 @@
  */
 
 #include "compress_zstd.h"
+#include "LogSingleton.h"
 
 #include <stdexcept>
 
@@ -19,6 +20,9 @@
 #include <memory.h>
 #include <malloc.h>
 
+size_t compress_zstd::in_block_size = 0;
+size_t compress_zstd::out_block_size = 0;
+
 /*
  * Predicate: the stream is open for read.
  */
@@ -52,7 +56,8 @@ compress_zstd::compress_zstd (io_stream * parent)
       return;
     }
   ZSTD_initDStream(state->stream);
-  state->out_block.size = state->out_block.pos  = state->out_pos = state->out_bsz = ZSTD_DStreamOutSize();
+  state->out_bsz = out_block_size ? out_block_size : ZSTD_DStreamOutSize();
+  state->out_block.size = state->out_block.pos  = state->out_pos = state->out_bsz;
   state->out_block.dst  = (unsigned char *)malloc(state->out_bsz);
   if (state->out_block.dst == NULL)
     {
@@ -61,7 +66,8 @@ compress_zstd::compress_zstd (io_stream * parent)
       lasterr = ENOMEM;
       return;
     }
-  state->in_block.size = state->in_block.pos  = state->in_bsz = ZSTD_DStreamInSize();
+  state->in_bsz = in_block_size ? in_block_size : ZSTD_DStreamInSize();
+  state->in_block.size = state->in_block.pos  = state->in_bsz;
   state->in_block.src  = (unsigned char *)malloc(state->in_bsz);
   state->in_pos  = 0;
   if (state->in_block.src == NULL)
@@ -77,6 +83,30 @@ compress_zstd::compress_zstd (io_stream * parent)
 ssize_t
 compress_zstd::read (void *buffer, size_t len)
 {
+  size_t done = 0;
+  while (done < len)
+    {
+      const void *data;
+      ssize_t got = read_view (&data, len - done);
+      if (got < 0)
+	{
+	  return -1;
+	}
+      if (got == 0)
+	{
+	  break;
+	}
+      memcpy (&((char *)buffer)[done], data, got);
+      consume (got);
+      done += got;
+    }
+  return done;
+}
+
+ssize_t
+compress_zstd::read_view (const void **data, size_t len)
+{
+  *data = NULL;
   /* there is no recovery from a busted stream */
   if (this->lasterr)
     {
@@ -87,10 +117,12 @@ compress_zstd::read (void *buffer, size_t len)
       return 0;
     }
 
-  size_t lenRemaining = len;
-  size_t lenBuffered  = 0;
-  do
+  while (state->out_pos >= state->out_block.pos)
     {
+      if (state->eof)
+	{
+	  return 0;
+	}
       if (state->in_block.size > 0 && state->in_block.pos >= state->in_block.size)
         {
 	  /* no compressed data ready; read some more input */
@@ -109,40 +141,34 @@ compress_zstd::read (void *buffer, size_t len)
 	  continue;
         }
 
-      if (state->out_pos < state->out_block.pos)
+      /* output buffer is empty; decompress more data */
+      state->out_block.size = state->out_bsz;
+      state->out_pos = state->out_block.pos = 0;
+      size_t ret = ZSTD_decompressStream (state->stream, &state->out_block, &state->in_block);
+      if (ZSTD_isError(ret))
 	{
-	  /* output buffer has unused data */
-	  ssize_t tmplen = std::min (state->out_block.pos - state->out_pos, lenRemaining);
-	  memcpy (&((char *)buffer)[lenBuffered], &((char *)state->out_block.dst)[state->out_pos], tmplen);
-	  state->out_pos += tmplen;
-	  lenBuffered    += tmplen;
-	  lenRemaining   -= tmplen;
-	  if (state->eof)
-	    {
-	      break;
-	    }
+	  LogPlainPrintf ("Zstd library error: %s\n", ZSTD_getErrorName (ret));
+	  lasterr = EINVAL;
+	  return -1;
 	}
-      else
+      state->eof = (ret == 0);
+      if (!state->eof && state->out_block.pos == 0 && state->in_block.size == 0)
 	{
-	  if (state->eof)
-	    {
-	      break;
-	    }
-	  /* output buffer is empty; decompress more data */
-	  state->out_block.size = state->out_bsz;
-	  state->out_pos = state->out_block.pos = 0;
-	  size_t ret = ZSTD_decompressStream (state->stream, &state->out_block, &state->in_block);
-	  if (ZSTD_isError(ret))
-	    {
-	      // TODO return/print error
-	      return -1;
-	    }
-	  state->eof = (ret == 0);
+	  /* the compressed data ends part way through a frame */
+	  LogPlainPrintf ("Zstd library error: truncated input\n");
+	  lasterr = EIO;
+	  return -1;
 	}
     }
-  while (lenRemaining != 0);
 
-  return (len - lenRemaining);
+  *data = &((char *)state->out_block.dst)[state->out_pos];
+  return std::min (state->out_block.pos - state->out_pos, len);
+}
+
+void
+compress_zstd::consume (size_t len)
+{
+  state->out_pos += len;
 }
 
 ssize_t
@@ -22,6 +22,10 @@ class compress_zstd:public compress
 public:
   compress_zstd (io_stream *); /* decompress (read) only */
   virtual ssize_t read (void *buffer, size_t len);
+  /* lends out_block */
+  virtual bool lends () { return true; };
+  virtual ssize_t read_view (const void **data, size_t len);
+  virtual void consume (size_t len);
   virtual ssize_t write (const void *buffer, size_t len); /* not implemented */
   virtual ssize_t peek (void *buffer, size_t len);
   virtual long tell (); /* not implemented */
@@ -36,6 +40,12 @@ public:
   static bool is_zstd (void *buffer, size_t len);
   virtual void release_original(); /* give up ownership of original io_stream */
 
+  /* the sizes of the buffers compressed data is read into and decoded
+     into, for streams made after they are set; 0, as setup leaves them,
+     for the ones libzstd suggests, about 128 KiB each */
+  static size_t in_block_size;
+  static size_t out_block_size;
+
 private:
   compress_zstd () {};
 
@@ -18,6 +18,7 @@
 #include <unistd.h>
 #include <vector>
 #include "io_stream.h"
+#include "io_stream_memory.h"
 #include "crypto.h"
 #include "compress.h"
 #include "gcrypt.h"
@@ -250,6 +251,19 @@ shovel_stream_data_into_md (io_stream *stream, size_t nbytes, gcry_md_hd_t md)
   size_t this_time, total = 0;
   ssize_t actual;
   MESSAGE ("shovel %d bytes at pos $%08x\n", nbytes, stream->tell ());
+  if (stream->lends ())
+    {
+      /* straight from the stream's buffer */
+      const void *view;
+      while (nbytes && (actual = stream->read_view (&view, nbytes)) > 0)
+        {
+          gcry_md_write (md, view, actual);
+          stream->consume (actual);
+          total += actual;
+          nbytes -= actual;
+        }
+      return total;
+    }
   while (nbytes)
     {
       this_time = (nbytes > TMPBUFSZ) ? TMPBUFSZ : nbytes;
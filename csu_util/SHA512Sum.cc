@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+#include "SHA512Sum.h"
+#include <string.h>
+
+SHA512Sum::SHA512Sum() : hd(0)
+{
+  if (gcry_md_open(&hd, GCRY_MD_SHA512, 0) != GPG_ERR_NO_ERROR)
+  {
+    hd = 0;
+    SHA512Init(&ctx);
+  }
+}
+
+SHA512Sum::~SHA512Sum()
+{
+  if (hd) gcry_md_close(hd);
+}
+
+void
+SHA512Sum::append(const unsigned char* data, size_t nbytes)
+{
+  if (hd)
+    gcry_md_write(hd, data, nbytes);
+  else
+    SHA512Update(&ctx, data, nbytes);
+}
+
+void
+SHA512Sum::finish(unsigned char digest[SHA512_DIGEST_LENGTH])
+{
+  if (hd)
+    memcpy(digest, gcry_md_read(hd, GCRY_MD_SHA512), SHA512_DIGEST_LENGTH);
+  else
+    SHA512Final(digest, &ctx);
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+#ifndef SETUP_SHA512SUM_H
+#define SETUP_SHA512SUM_H
+
+/*
+ * Incremental SHA-512.
+ *
+ * The work is done by libgcrypt, which picks the fastest implementation
+ * the CPU supports at run time (SSSE3, AVX, AVX2 or AVX512 on x86, the
+ * crypto extensions on ARMv8).  The portable code in sha2.c is used if
+ * libgcrypt can't provide SHA-512 for some reason.
+ *
+ * Usage: sha->append(); ...; sha->finish(digest);
+ */
+
+#include "sha2.h"
+#include "win32.h"
+#include <gcrypt.h>
+
+class SHA512Sum
+{
+  public:
+    SHA512Sum();
+    ~SHA512Sum();
+
+    void append(const unsigned char* data, size_t nbytes);
+    void finish(unsigned char digest[SHA512_DIGEST_LENGTH]);
+
+    /* true if the accelerated (libgcrypt) implementation is in use */
+    bool accelerated() const { return hd != 0; };
+
+  private:
+    gcry_md_hd_t hd;
+    SHA2_CTX ctx;
+
+    SHA512Sum(const SHA512Sum&); // no copy cons
+    SHA512Sum& operator= (const SHA512Sum&); // no assignment
+};
+
+#endif /* SETUP_SHA512SUM_H */
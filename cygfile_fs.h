@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+#ifndef SETUP_CYGFILE_FS_H
+#define SETUP_CYGFILE_FS_H
+
+/* The filesystem under cygfile://, and under the uninstaller: what
+ * io_stream_cygfile and cygmkdir_p do to the Cygwin tree, given paths
+ * in it such as "/usr/bin/ls".  The Win32 one, which finds the tree
+ * through the mount table, is used unless another is; the POSIX one in
+ * cygfile_fs_posix.h keeps the tree in a directory of its own, so that
+ * installing can be run and measured on a host with no Windows.
+ * Unless said otherwise, methods return 0 for success.
+ */
+
+#include "io_stream.h"
+#include <stdio.h>
+
+class cygfile_fs
+{
+public:
+  virtual ~cygfile_fs () {}
+  /* the one in use */
+  static cygfile_fs *get ();
+  static void use (cygfile_fs *);
+
+  /* path as the host names it, for messages */
+  virtual std::string native (const std::string &path) = 0;
+  /* 1 if there is anything at path */
+  virtual int exists (const std::string &path) = 0;
+  /* as fopen, giving a file made perms; NULL with errno set on failure */
+  virtual FILE *open (const std::string &path, const char *mode,
+		      mode_t perms) = 0;
+  /* remove the file at path, moving a directory there out of the way
+     first; 0 too if there was nothing there */
+  virtual int remove (const std::string &path) = 0;
+  /* remove the file at path, read-only or not, but never a directory */
+  virtual int unlink (const std::string &path) = 0;
+  /* remove the directory at path, if it is empty */
+  virtual int rmdir (const std::string &path) = 0;
+  virtual int move (const std::string &from, const std::string &to) = 0;
+  /* as mkdir_p () */
+  virtual int mkdir_p (path_type_t isadir, const std::string &path,
+		       mode_t mode) = 0;
+  /* make from a link to target, which is left as it is */
+  virtual int symlink (const std::string &from, const std::string &target) = 0;
+  /* make from another name for to; 1 if the filesystem can't */
+  virtual int hardlink (const std::string &from, const std::string &to) = 0;
+  virtual int set_mtime (const std::string &path, time_t mtime) = 0;
+  /* 0 if it can't be found */
+  virtual size_t get_size (const std::string &path) = 0;
+  /* as io_stream::preallocate, for fp open on a file in the tree */
+  virtual int preallocate (FILE *fp, size_t len) = 0;
+
+private:
+  static cygfile_fs *current;
+};
+
+#endif /* SETUP_CYGFILE_FS_H */
@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+#include "cygfile_fs_posix.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+
+#include "LogSingleton.h"
+
+#ifdef _WIN32
+/* MinGW has enough of POSIX to try this out with, short of links */
+#define lstat stat
+#define mkdir(path, mode) mkdir (path)
+#else
+#define O_BINARY 0
+#endif
+
+std::string
+cygfile_fs_posix::native (const std::string &path)
+{
+  return root + path;
+}
+
+int
+cygfile_fs_posix::exists (const std::string &path)
+{
+  struct stat st;
+  return !lstat (native (path).c_str (), &st);
+}
+
+FILE *
+cygfile_fs_posix::open (const std::string &path, const char *mode,
+			mode_t perms)
+{
+  std::string name = native (path);
+  int flags;
+  switch (mode[0])
+    {
+    case 'r':
+      return fopen (name.c_str (), mode);
+    case 'w':
+      flags = O_CREAT | O_TRUNC;
+      break;
+    case 'a':
+      flags = O_CREAT | O_APPEND;
+      break;
+    default:
+      errno = EINVAL;
+      return NULL;
+    }
+  flags |= O_BINARY | (strchr (mode, '+') ? O_RDWR : O_WRONLY);
+  /* 0 means no POSIX perms */
+  int fd = ::open (name.c_str (), flags, perms ? perms : 0644);
+  if (fd < 0)
+    return NULL;
+  FILE *fp = fdopen (fd, mode);
+  if (!fp)
+    {
+      int err = errno;
+      close (fd);
+      errno = err;
+    }
+  return fp;
+}
+
+int
+cygfile_fs_posix::remove (const std::string &path)
+{
+  std::string name = native (path);
+  struct stat st;
+  if (lstat (name.c_str (), &st))
+    return 0;
+  if (S_ISDIR (st.st_mode))
+    {
+      std::string tmp;
+      int i = 0;
+      do
+	{
+	  char suffix[20];
+	  sprintf (suffix, "old-%d", ++i);
+	  tmp = name + suffix;
+	}
+      while (!lstat (tmp.c_str (), &st));
+      Log (LOG_TIMESTAMP) << "warning: moving directory \"" << path.c_str()
+                          << "\" out of the way." << endLog;
+      return rename (name.c_str (), tmp.c_str ()) ? 1 : 0;
+    }
+  return ::unlink (name.c_str ()) ? 1 : 0;
+}
+
+int
+cygfile_fs_posix::unlink (const std::string &path)
+{
+  std::string name = native (path);
+  struct stat st;
+  if (lstat (name.c_str (), &st) || S_ISDIR (st.st_mode))
+    return 1;
+  return ::unlink (name.c_str ()) ? 1 : 0;
+}
+
+int
+cygfile_fs_posix::rmdir (const std::string &path)
+{
+  return ::rmdir (native (path).c_str ()) ? 1 : 0;
+}
+
+int
+cygfile_fs_posix::move (const std::string &from, const std::string &to)
+{
+  return rename (native (from).c_str (), native (to).c_str ()) ? 1 : 0;
+}
+
+/* as mkdir_p (), short of root */
+int
+cygfile_fs_posix::mkdir_p (path_type_t isadir, const std::string &path,
+			   mode_t mode)
+{
+  std::string dir (path);
+  if (isadir == PATH_TO_FILE)
+    {
+      std::string::size_type slash = dir.rfind ('/');
+      if (slash == std::string::npos)
+	return 0;
+      dir.erase (slash);
+    }
+  while (dir.size () && dir[dir.size () - 1] == '/')
+    dir.erase (dir.size () - 1);
+  if (!dir.size ())
+    return 0;
+
+  std::string name = native (dir);
+  struct stat st;
+  if (!stat (name.c_str (), &st) && S_ISDIR (st.st_mode))
+    return 0;
+  if (mkdir_p (PATH_TO_FILE, dir, mode ? 0755 : 0))
+    return 1;
+  if (!mkdir (name.c_str (), mode ? mode : 0755))
+    return 0;
+  if (errno != EEXIST)
+    return 1;
+  Log (LOG_TIMESTAMP) << "warning: deleting \"" << name
+		      << "\" so I can make a directory there" << endLog;
+  if (::unlink (name.c_str ()) || mkdir (name.c_str (), mode ? mode : 0755))
+    return 1;
+  return 0;
+}
+
+int
+cygfile_fs_posix::symlink (const std::string &from, const std::string &target)
+{
+#ifdef _WIN32
+  errno = ENOSYS;
+  return 1;
+#else
+  return ::symlink (target.c_str (), native (from).c_str ()) ? 1 : 0;
+#endif
+}
+
+int
+cygfile_fs_posix::hardlink (const std::string &from, const std::string &to)
+{
+#ifdef _WIN32
+  errno = ENOSYS;
+  return 1;
+#else
+  return link (native (to).c_str (), native (from).c_str ()) ? 1 : 0;
+#endif
+}
+
+int
+cygfile_fs_posix::set_mtime (const std::string &path, time_t mtime)
+{
+  struct utimbuf times;
+  times.actime = mtime;
+  times.modtime = mtime;
+  return utime (native (path).c_str (), &times) ? 1 : 0;
+}
+
+size_t
+cygfile_fs_posix::get_size (const std::string &path)
+{
+  struct stat st;
+  if (stat (native (path).c_str (), &st))
+    return 0;
+  return st.st_size;
+}
+
+int
+cygfile_fs_posix::preallocate (FILE *fp, size_t len)
+{
+#ifdef FALLOC_FL_KEEP_SIZE
+  /* as on Windows, the file's end stays where it is */
+  return fallocate (fileno (fp), FALLOC_FL_KEEP_SIZE, 0, len) ? 1 : 0;
+#else
+  return 1;
+#endif
+}
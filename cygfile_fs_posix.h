@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+#ifndef SETUP_CYGFILE_FS_POSIX_H
+#define SETUP_CYGFILE_FS_POSIX_H
+
+/* A Cygwin tree kept in a directory by POSIX calls, for running the
+ * install and uninstall code against a scratch directory on a POSIX host.
+ * It knows nothing of mount tables, ACLs or Windows shortcuts, and built
+ * with MinGW makes no links, so hard links are copied there and symlinks
+ * fail.  Setup itself never uses it; something wanting it passes it to
+ * cygfile_fs::use () before touching cygfile://.
+ */
+
+#include "cygfile_fs.h"
+
+class cygfile_fs_posix : public cygfile_fs
+{
+public:
+  /* root holds what is at "/", and must exist */
+  cygfile_fs_posix (const std::string &root) : root (root) {}
+  std::string native (const std::string &path);
+  int exists (const std::string &path);
+  FILE *open (const std::string &path, const char *mode, mode_t perms);
+  int remove (const std::string &path);
+  int unlink (const std::string &path);
+  int rmdir (const std::string &path);
+  int move (const std::string &from, const std::string &to);
+  int mkdir_p (path_type_t isadir, const std::string &path, mode_t mode);
+  int symlink (const std::string &from, const std::string &target);
+  int hardlink (const std::string &from, const std::string &to);
+  int set_mtime (const std::string &path, time_t mtime);
+  size_t get_size (const std::string &path);
+  int preallocate (FILE *fp, size_t len);
+private:
+  std::string root;
+};
+
+#endif /* SETUP_CYGFILE_FS_POSIX_H */
@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+/* The Cygwin tree as Windows has it, found through the mount table. */
+
+#include "win32.h"
+#include "mklink2.h"
+#include "filemanip.h"
+#include "mkdir.h"
+#include "mount.h"
+
+#include <stdlib.h>
+#include <errno.h>
+#include <io.h>
+
+#include "cygfile_fs.h"
+#include "LogSingleton.h"
+
+static bool
+get_root_dir_now ()
+{
+  /* do this every time because the mount points may change due to
+   * fwd/back button use...
+   * TODO: make this less...manual
+   */
+  if (!get_root_dir ().size())
+    read_mounts (std::string ());
+  /* TODO: assign a errno for "no mount table :} " */
+  return get_root_dir ().size();
+}
+
+class cygfile_fs_win32 : public cygfile_fs
+{
+public:
+  cygfile_fs_win32 () { use (this); }
+  std::string native (const std::string &path);
+  int exists (const std::string &path);
+  FILE *open (const std::string &path, const char *mode, mode_t perms);
+  int remove (const std::string &path);
+  int unlink (const std::string &path);
+  int rmdir (const std::string &path);
+  int move (const std::string &from, const std::string &to);
+  int mkdir_p (path_type_t isadir, const std::string &path, mode_t mode);
+  int symlink (const std::string &from, const std::string &target);
+  int hardlink (const std::string &from, const std::string &to);
+  int set_mtime (const std::string &path, time_t mtime);
+  size_t get_size (const std::string &path);
+  int preallocate (FILE *fp, size_t len);
+private:
+  static cygfile_fs_win32 theInstance;
+};
+cygfile_fs_win32 cygfile_fs_win32::theInstance;
+
+std::string
+cygfile_fs_win32::native (const std::string &path)
+{
+  get_root_dir_now ();
+  return cygpath (path);
+}
+
+int
+cygfile_fs_win32::exists (const std::string &path)
+{
+  if (!get_root_dir_now ())
+    return 0;
+  size_t len = cygpath (path).size () + 7;
+  WCHAR wname[len];
+  mklongpath (wname, cygpath (path).c_str (), len);
+  DWORD attr = GetFileAttributesW (wname);
+  if (attr != INVALID_FILE_ATTRIBUTES)
+    return 1;
+  return 0;
+}
+
+FILE *
+cygfile_fs_win32::open (const std::string &path, const char *mode,
+			mode_t perms)
+{
+  if (!get_root_dir_now ())
+    {
+      Log (LOG_TIMESTAMP) << "io_stream_cygfile: Error reading mounts" << endLog;
+      errno = ENOENT;
+      return NULL;
+    }
+  std::string fname = cygpath (path);
+  size_t len = fname.size () + 7;
+  WCHAR wname[len];
+  mklongpath (wname, fname.c_str (), len);
+  return nt_wfopen (wname, mode, perms);
+}
+
+int
+cygfile_fs_win32::remove (const std::string &path)
+{
+  if (!get_root_dir_now ())
+    return 1;
+
+  size_t len = cygpath (path).size () + 7;
+  WCHAR wpath[len];
+  mklongpath (wpath, cygpath (path).c_str (), len);
+
+  unsigned long w = GetFileAttributesW (wpath);
+  if (w != INVALID_FILE_ATTRIBUTES && w & FILE_ATTRIBUTE_DIRECTORY)
+    {
+      len = wcslen (wpath);
+      WCHAR tmp[len + 10];
+      wcscpy (tmp, wpath);
+      int i = 0;
+      do
+        {
+	  ++i;
+	  swprintf (tmp + len, L"old-%d", i);
+	}
+      while (GetFileAttributesW (tmp) != INVALID_FILE_ATTRIBUTES);
+      Log (LOG_TIMESTAMP) << "warning: moving directory \"" << path.c_str()
+                          << "\" out of the way." << endLog;
+      MoveFileW (wpath, tmp);
+    }
+  return io_stream::remove (std::string ("file://") + cygpath (path).c_str());
+}
+
+int
+cygfile_fs_win32::unlink (const std::string &path)
+{
+  std::string d = native (path);
+  WCHAR wname[d.size () + 7];
+  mklongpath (wname, d.c_str (), d.size () + 7);
+  DWORD dw = GetFileAttributesW (wname);
+  if (dw == INVALID_FILE_ATTRIBUTES || dw & FILE_ATTRIBUTE_DIRECTORY)
+    return 1;
+  SetFileAttributesW (wname, dw & ~FILE_ATTRIBUTE_READONLY);
+  return !DeleteFileW (wname);
+}
+
+int
+cygfile_fs_win32::rmdir (const std::string &path)
+{
+  std::string d = native (path);
+  WCHAR wname[d.size () + 7];
+  mklongpath (wname, d.c_str (), d.size () + 7);
+  return !RemoveDirectoryW (wname);
+}
+
+int
+cygfile_fs_win32::move (const std::string &from, const std::string &to)
+{
+  if (!get_root_dir_now ())
+    return 1;
+  return rename (cygpath (from).c_str(), cygpath (to).c_str());
+}
+
+int
+cygfile_fs_win32::mkdir_p (path_type_t isadir, const std::string &path,
+			   mode_t mode)
+{
+  if (!get_root_dir_now ())
+    return 1;
+  return ::mkdir_p (isadir == PATH_TO_DIR ? 1 : 0, cygpath (path).c_str(),
+		    mode);
+}
+
+int
+cygfile_fs_win32::symlink (const std::string &from, const std::string &target)
+{
+  return mkcygsymlink (cygpath (from).c_str(), target.c_str());
+}
+
+int
+cygfile_fs_win32::hardlink (const std::string &from, const std::string &to)
+{
+  return mkcyghardlink (cygpath (from).c_str(), cygpath (to).c_str ());
+}
+
+int
+cygfile_fs_win32::set_mtime (const std::string &path, time_t mtime)
+{
+  long long ftimev = mtime * NSPERSEC + FACTOR;
+  FILETIME ftime;
+  ftime.dwHighDateTime = ftimev >> 32;
+  ftime.dwLowDateTime = ftimev;
+  std::string fname = native (path);
+  WCHAR wname[fname.size () + 7];
+  mklongpath (wname, fname.c_str (), fname.size () + 7);
+  HANDLE h;
+  h = CreateFileW (wname, GENERIC_WRITE,
+		   FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING,
+		   FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS, 0);
+  if (h == INVALID_HANDLE_VALUE)
+    return 1;
+  SetFileTime (h, 0, 0, &ftime);
+  CloseHandle (h);
+  return 0;
+}
+
+size_t
+cygfile_fs_win32::get_size (const std::string &path)
+{
+  std::string fname = native (path);
+  WCHAR wname[fname.size () + 7];
+  mklongpath (wname, fname.c_str (), fname.size () + 7);
+  HANDLE h;
+  DWORD ret = 0;
+  h = CreateFileW (wname, GENERIC_READ,
+		   FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING,
+		   FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS, 0);
+  if (h != INVALID_HANDLE_VALUE)
+    {
+      ret = GetFileSize (h, NULL);
+      CloseHandle (h);
+    }
+  return ret;
+}
+
+int
+cygfile_fs_win32::preallocate (FILE *fp, size_t len)
+{
+  /* the file's end stays where it is; only its clusters are found now */
+  FILE_ALLOCATION_INFO info;
+  info.AllocationSize.QuadPart = len;
+  HANDLE h = (HANDLE) _get_osfhandle (_fileno (fp));
+  if (h == INVALID_HANDLE_VALUE
+      || !SetFileInformationByHandle (h, FileAllocationInfo, &info,
+				      sizeof info))
+    return 1;
+  return 0;
+}
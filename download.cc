@@ -23,6 +23,9 @@
 #include "win32.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #include <unistd.h>
 #include <process.h>
 #include <vector>
@@ -34,6 +37,9 @@
 #include "state.h"
 #include "LogFile.h"
 #include "filemanip.h"
+#include "diskfull.h"
+#include "mount.h"
+#include "fetch.h"
 
 #include "io_stream.h"
 
@@ -44,9 +50,16 @@
 #include "threebar.h"
 
 #include "Exception.h"
+#include "threadpool.h"
+
+#include "getopt++/StringOption.h"
 
 extern ThreeBarProgressPage g_Progress;
 
+static StringOption ConcurrentDownloadsOption ("", '\0', "concurrent-downloads",
+					       "Number of packages to download "
+					       "at once (default: 4)", false);
+
 // Return true if selected checks pass, false if they don't and the
 // user chooses to delete the file; otherwise throw an exception.
 static bool
@@ -144,86 +157,177 @@ check_for_cached (packagesource & pkgsource, HWND owner, bool mirror_mode,
   return 0;
 }
 
-/* download a file from a mirror site to the local cache. */
-static int
-download_one (packagesource & pkgsource, HWND owner)
+void
+check_hashes (const std::vector <packagesource *> &sources)
 {
-  try
+  std::vector <packagesource *> todo;
+  long long total = 0;
+  for (std::vector <packagesource *>::const_iterator i = sources.begin ();
+       i != sources.end (); ++i)
+    if ((*i)->Cached () && !(*i)->Validated ()
+	&& ((*i)->sha512_isSet || (*i)->md5.isSet ()))
+      {
+	todo.push_back (*i);
+	total += (*i)->size;
+      }
+  if (todo.empty ())
+    return;
+
+  Log (LOG_BABBLE) << "Checking hashes of " << todo.size ()
+		   << " packages in parallel" << endLog;
+
+  g_Progress.SetText1 ("Checking hashes...");
+  g_Progress.SetText2 ("");
+  g_Progress.SetText3 ("");
+  g_Progress.SetText4 ("Progress:");
+  g_Progress.SetBar1 (0);
+
+  /* Each job reads and hashes one file, so with a thread per CPU the reads
+     of some files overlap with the hashing of others.  Even with just the
+     one thread, this thread is left free to show the progress.  */
+  volatile long long hashed = 0;
+  volatile LONG done = 0;
+  ThreadPool pool;
+  for (std::vector <packagesource *>::iterator i = todo.begin ();
+       i != todo.end (); ++i)
     {
-      if (check_for_cached (pkgsource, owner))
-        return 0;
+      packagesource *source = *i;
+      pool.submit ([source, &hashed, &done] () {
+	try
+	  {
+	    source->check_hash (&hashed);
+	  }
+	catch (Exception *e)
+	  {
+	    delete e;
+	  }
+	InterlockedIncrement (&done);
+      });
     }
-  catch (Exception * e)
+
+  DWORD start_tics = GetTickCount ();
+  bool idle;
+  do
     {
-      // We know what to do with these..
-      if (e->errNo() == APPERR_CORRUPT_PACKAGE)
-	{
-	  fatal (owner, IDS_CORRUPT_PACKAGE, pkgsource.Canonical());
-    	  return 1;
-	}
-      // Unexpected exception.
-      throw e;
+      idle = pool.wait (200);
+
+      char buf[100];
+      DWORD tics = GetTickCount () - start_tics;
+      double mbps = tics ? hashed / 1000.0 / tics : 0;
+      sprintf (buf, "%ld of %u packages  %03.1f MB/s", (long) done,
+	       (unsigned int) todo.size (), mbps);
+      g_Progress.SetText3 (buf);
+      if (total > 0)
+	g_Progress.SetBar1 (hashed * 100 / total);
     }
-  /* try the download sites one after another */
+  while (!idle);
 
-  int success = 0;
-  for (packagesource::sitestype::const_iterator n = pkgsource.sites.begin();
-       n != pkgsource.sites.end() && !success; ++n)
-    {
-      const std::string local = local_dir + "/" +
-				  rfc1738_escape_part (n->key) + "/" +
-				  pkgsource.Canonical ();
-      io_stream::mkpath_p (PATH_TO_FILE, "file://" + local, 0);
+  Log (LOG_BABBLE) << "Hashed " << hashed << " bytes in "
+		   << GetTickCount () - start_tics << " ms" << endLog;
+}
 
-      if (get_url_to_file(n->key + pkgsource.Canonical (),
-			  local + ".tmp", pkgsource.size, owner))
-	{
-	  /* FIXME: note new source ? */
-	  continue;
-	}
-      else
-	{
+static std::vector <packageversion> download_failures;
+static std::string download_warn_pkgs;
+
+static unsigned int
+concurrent_download_count ()
+{
+  int n = atoi (static_cast<std::string> (ConcurrentDownloadsOption).c_str ());
+  return n > 0 ? n : 4;
+}
+
+/* Download the packages in q, nconcurrent at a time, each starting at a
+   different mirror.  A package which fails on one mirror moves on to the
+   next without holding up the others.  The downloads run on worker
+   threads, which only hand back what happened; this thread shows the
+   progress and reports the failures.  Returns the number of failures,
+   which are also added to download_failures in queue order.  */
+static int
+download_packages (const std::vector <packageversion> &q,
+		   unsigned int nconcurrent, HWND owner)
+{
+  struct outcome
+  {
+    fetch_result result;
+    std::string file;
+    int err;
+  };
+  std::vector <outcome> outcomes (q.size ());
+  volatile LONG done = 0;
+  /* big packages are fetched in pieces from several mirrors at once,
+     unless we're already downloading several packages at once */
+  bool split = nconcurrent == 1;
+
+  Log (LOG_BABBLE) << "Downloading " << q.size () << " packages, "
+		   << nconcurrent << " at a time" << endLog;
+
+  g_Progress.SetText1 ("Downloading...");
+  g_Progress.SetText2 ("");
+  g_Progress.SetText3 ("");
+  g_Progress.SetBar1 (0);
+
+  {
+    ThreadPool pool (nconcurrent);
+    for (size_t i = 0; i < q.size (); ++i)
+      {
+	packagesource *source = q[i].source ();
+	outcome *o = &outcomes[i];
+	pool.submit ([source, o, i, split, &done] () {
 	  try
 	    {
-	      if (_access (local.c_str(), 0) == 0)
-		remove (local.c_str());
-	      rename ((local + ".tmp").c_str(), local.c_str());
-	      pkgsource.check_size_and_cache ("file://" + local);
-	      pkgsource.check_hash ();
-	      Log (LOG_PLAIN) << "Downloaded " << local << endLog;
-	      success = 1;
-	      // FIXME: move the downloaded file to the 
-	      //  original locations - without the mirror site dir in the way
-	      continue;
+	      o->result = fetch_package (*source, local_dir, i, split,
+					 &total_download_bytes_sofar,
+					 o->file);
+	      o->err = errno;
 	    }
-	  catch (Exception *e)
+	  catch (...)
 	    {
-	      remove (local.c_str());
-	      pkgsource.set_cached ("");
-	      if (e->errNo() == APPERR_CORRUPT_PACKAGE)
-		{
-		  Log (LOG_PLAIN) << "Downloaded file " << local
-				  << " is corrupt; deleting." << endLog;
-		  continue;
-		}
-	      else
-		{
-		  Log (LOG_PLAIN) << "Unexpected exception while validating "
-				  << "downloaded file " << local
-				  << "; deleting." << endLog;
-		  throw e;
-		}
+	      Log (LOG_PLAIN) << "Unexpected exception while downloading "
+			      << source->Canonical () << endLog;
+	      o->result = fetch_failed;
 	    }
+	  InterlockedIncrement (&done);
+	});
+      }
+
+    DWORD start_tics = GetTickCount ();
+    bool idle;
+    do
+      {
+	idle = pool.wait (200);
+
+	char buf[100];
+	long long sofar =
+	  InterlockedExchangeAdd64 (&total_download_bytes_sofar, 0);
+	DWORD tics = GetTickCount () - start_tics;
+	sprintf (buf, "%ld of %u packages  %03.1f kB/s", (long) done,
+		 (unsigned int) q.size (), tics ? (double) sofar / tics : 0.0);
+	g_Progress.SetText3 (buf);
+	g_Progress.SetBar1 (done, q.size ());
+	if (total_download_bytes > 0)
+	  {
+	    g_Progress.SetBar2 (sofar, total_download_bytes);
+	    g_Progress.SetBar3 (diskfull (get_root_dir ().c_str ()));
+	  }
+      }
+    while (!idle);
+  }
+
+  int errors = 0;
+  for (size_t i = 0; i < q.size (); ++i)
+    {
+      if (outcomes[i].result == fetch_cant_write)
+	fatal (owner, IDS_ERR_OPEN_WRITE, outcomes[i].file.c_str (),
+	       strerror (outcomes[i].err));
+      if (outcomes[i].result != fetch_ok)
+	{
+	  errors++;
+	  download_failures.push_back (q[i]);
 	}
     }
-  if (success)
-    return 0;
-  return 1;
+  return errors;
 }
 
-static std::vector <packageversion> download_failures;
-static std::string download_warn_pkgs;
-
 static INT_PTR CALLBACK
 download_error_proc (HWND h, UINT message, WPARAM wParam, LPARAM lParam)
 {
@@ -284,14 +388,35 @@ static int do_download_thread(HINSTANCE h, HWND owner)
   packagedb db;
   const SolverTransactionList &t = db.solution.transactions();
 
+  /* find the packages which are already in the cache and hash them all at
+     once, so that the loop below only has to re-check any failures */
+  std::vector<packagesource *> cached;
+  for (SolverTransactionList::const_iterator i = t.begin(); i != t.end(); ++i) {
+    if (i->type != SolverTransaction::transInstall) continue;
+    packageversion version = i->version;
+
+    try {
+      if (check_for_cached(*version.source(), owner, false, false))
+        cached.push_back(version.source());
+    } catch (Exception *e) {
+      if (e->errNo() == APPERR_CORRUPT_PACKAGE)
+        fatal(owner, IDS_CORRUPT_PACKAGE, version.Name().c_str());
+      throw e;
+    }
+  }
+  check_hashes(cached);
+
   /* calculate the total size of the download */
+  std::vector<packageversion> to_fetch;
   for (SolverTransactionList::const_iterator i = t.begin(); i != t.end(); ++i) {
     if (i->type != SolverTransaction::transInstall) continue;
     packageversion version = i->version;
 
     try {
-      if (!check_for_cached(*version.source(), owner))
+      if (!check_for_cached(*version.source(), owner)) {
         total_download_bytes += version.source()->size;
+        to_fetch.push_back(version);
+      }
     } catch (Exception *e) {
       // We know what to do with these..
       if (e->errNo() == APPERR_CORRUPT_PACKAGE)
@@ -304,21 +429,11 @@ static int do_download_thread(HINSTANCE h, HWND owner)
   /* and do the download. FIXME: This here we assign a new name for the cached version
    * and check that above.
    */
-  for (SolverTransactionList::const_iterator i = t.begin(); i != t.end(); ++i) {
-    if (i->type != SolverTransaction::transInstall) continue;
-    packageversion version = i->version;
-
-    {
-      int e = 0;
-      e += download_one(*version.source(), owner);
-      errors += e;
-      if (e) download_failures.push_back(version);
-#if 0
-	  if (e)
-	    pkg->action = ACTION_ERROR;
-#endif
-    }
-  }
+  unsigned int nconcurrent = concurrent_download_count();
+  if (nconcurrent > to_fetch.size())
+    nconcurrent = to_fetch.size();
+  if (nconcurrent)
+    errors += download_packages(to_fetch, nconcurrent, owner);
 
   if (errors) {
     // In unattended mode we retry the download, but not forever.
@@ -18,8 +18,15 @@
 
 #include "win32.h"
 
+#include <vector>
+
 class packagesource;
 int check_for_cached (packagesource & pkgsource, HWND owner,
 		      bool mirror_mode = false, bool check_hash = true);
+/* Hash the cached files of many sources at once, across several threads,
+   showing the combined progress.  Failures are not reported here: they
+   are left unvalidated, so that the caller's own check_hash () finds
+   them again and handles them as usual.  */
+void check_hashes (const std::vector <packagesource *> &sources);
 
 #endif /* SETUP_DOWNLOAD_H */
@@ -0,0 +1,376 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+/* The purpose of this file is to fetch packages from the mirrors into the
+   local package cache without touching the GUI, so that download.cc can
+   fetch several at once on worker threads. */
+
+#include "fetch.h"
+
+#include "win32.h"
+
+#include <stdio.h>
+#include <errno.h>
+
+#include "csu_util/rfc1738.h"
+#include "netio.h"
+#include "io_stream.h"
+#include "filemanip.h"
+#include "package_source.h"
+#include "threadpool.h"
+#include "Exception.h"
+#include "LogSingleton.h"
+
+/* Packages at least this big are fetched in up to SPLIT_DOWNLOAD_RANGES
+   pieces, from different mirrors at once. */
+#define SPLIT_DOWNLOAD_SIZE (64 * 1024 * 1024)
+#define SPLIT_DOWNLOAD_RANGES 4
+
+/* Add the first len bytes of an existing file to digest.  Returns nonzero
+   on failure. */
+static int
+digest_file (const std::string &filename, long long len,
+	     packagedigest *digest)
+{
+  FILE *f = nt_fopen (filename.c_str (), "rb");
+  if (!f)
+    return 1;
+  while (len > 0)
+    {
+      unsigned char buf[64 * 1024];
+      size_t count = fread (buf, 1, len < (long long) sizeof (buf)
+				    ? (size_t) len : sizeof (buf), f);
+      if (count == 0)
+	break;
+      digest->append (buf, count);
+      len -= count;
+    }
+  fclose (f);
+  return len != 0;
+}
+
+fetch_result
+fetch_to_file (const std::string &url, const std::string &filename,
+	       long long expected_length, packagedigest *digest,
+	       volatile long long *fetched)
+{
+  Log (LOG_BABBLE) << "fetch_to_file " << url << " " << filename << endLog;
+
+  /* A .tmp file is only left behind by an interrupted download, so if
+     there is one, just ask for the rest of the file. */
+  long long resume_from = 0;
+  if (expected_length > 0)
+    {
+      size_t partial = get_file_size ("file://" + filename);
+      if (partial > 0 && (long long) partial < expected_length)
+	resume_from = partial;
+    }
+  if (!resume_from)
+    remove (filename.c_str ()); /* but ignore errors */
+
+  NetIO *n = NetIO::open (url.c_str (), false, resume_from);
+  if (!n || !n->ok ())
+    {
+      delete n;
+      return fetch_failed;
+    }
+
+  if (resume_from && n->offset != resume_from)
+    {
+      Log (LOG_BABBLE) << "Range request not honoured, fetching " << url
+		       << " from the start" << endLog;
+      resume_from = 0;
+    }
+
+  /* The bytes we already have are read once, here, so that the digest
+     covers the whole file without reading it back afterwards. */
+  if (resume_from && digest && digest_file (filename, resume_from, digest))
+    {
+      Log (LOG_PLAIN) << "Unable to read partial download " << filename
+		      << endLog;
+      delete n;
+      remove (filename.c_str ());
+      return fetch_failed;
+    }
+
+  FILE *f = nt_fopen (filename.c_str (), resume_from ? "ab" : "wb");
+  if (!f)
+    {
+      int err = errno;
+      delete n;
+      errno = err;
+      return fetch_cant_write;
+    }
+
+  if (resume_from)
+    Log (LOG_PLAIN) << "Resuming download of " << url << " at byte "
+		    << resume_from << endLog;
+
+  long long total_bytes = resume_from;
+  InterlockedExchangeAdd64 (fetched, resume_from);
+  int count;
+  while (1)
+    {
+      char buf[8192];
+      count = n->read (buf, sizeof (buf));
+      if (count <= 0)
+	break;
+      fwrite (buf, 1, count, f);
+      if (digest)
+	digest->append ((unsigned char *) buf, count);
+      total_bytes += count;
+      InterlockedExchangeAdd64 (fetched, count);
+    }
+
+  fclose (f);
+  delete n;
+
+  /* Keep what we got of an interrupted transfer, for the next attempt to
+     resume from. */
+  if (count < 0 || (expected_length > 0 && total_bytes < expected_length))
+    {
+      Log (LOG_PLAIN) << "Download of " << url << " interrupted after "
+		      << total_bytes << " bytes" << endLog;
+      return fetch_failed;
+    }
+
+  return fetch_ok;
+}
+
+/* Fetch bytes [start, start + length) of url into the same place in an
+   existing file, counting them in got as well as fetched.  Fails if the
+   server ignores the range request. */
+static fetch_result
+fetch_range (const std::string &url, const std::string &filename,
+	     long long start, long long length, long long &got,
+	     volatile long long *fetched)
+{
+  got = 0;
+  NetIO *n = NetIO::open (url.c_str (), false, start, length);
+  if (!n || !n->ok () || n->offset != start)
+    {
+      delete n;
+      return fetch_failed;
+    }
+
+  FILE *f = nt_fopen (filename.c_str (), "r+b");
+  if (!f || _fseeki64 (f, start, SEEK_SET))
+    {
+      if (f)
+	fclose (f);
+      delete n;
+      return fetch_failed;
+    }
+
+  while (got < length)
+    {
+      char buf[8192];
+      int count = n->read (buf, sizeof (buf));
+      if (count <= 0)
+	break;
+      if (count > length - got)
+	count = length - got;
+      if (fwrite (buf, 1, count, f) != (size_t) count)
+	break;
+      got += count;
+      InterlockedExchangeAdd64 (fetched, count);
+    }
+
+  fclose (f);
+  delete n;
+  return got == length ? fetch_ok : fetch_failed;
+}
+
+fetch_result
+fetch_ranges_to_file (const std::vector<std::string> &urls,
+		      const std::string &filename, long long length,
+		      packagedigest *digest, volatile long long *fetched)
+{
+  Log (LOG_BABBLE) << "fetch_ranges_to_file " << urls[0] << " " << filename
+		   << endLog;
+
+  FILE *f = nt_fopen (filename.c_str (), "wb");
+  if (!f)
+    return fetch_cant_write;
+  fclose (f);
+
+  /* one range per mirror */
+  struct range
+  {
+    long long start, length, got;
+    fetch_result result;
+  };
+  size_t nranges = urls.size ();
+  std::vector<range> ranges (nranges);
+  for (size_t i = 0; i < nranges; i++)
+    {
+      ranges[i].start = length * i / nranges;
+      ranges[i].length = length * (i + 1) / nranges - ranges[i].start;
+      ranges[i].got = 0;
+      ranges[i].result = fetch_failed;
+    }
+
+  {
+    ThreadPool pool (nranges);
+    for (size_t i = 0; i < nranges; i++)
+      {
+	range *r = &ranges[i];
+	std::string url = urls[i];
+	pool.submit ([r, url, filename, fetched] () {
+	  r->result = fetch_range (url, filename, r->start, r->length, r->got,
+				   fetched);
+	});
+      }
+  }
+
+  /* A range which failed is tried on each of the other mirrors in turn,
+     having taken back what it got the first time. */
+  for (size_t i = 0; i < nranges; i++)
+    for (size_t k = 1; ranges[i].result != fetch_ok && k < nranges; k++)
+      {
+	Log (LOG_BABBLE) << "Retrying bytes " << ranges[i].start << "-"
+			 << ranges[i].start + ranges[i].length - 1 << " from "
+			 << urls[(i + k) % nranges] << endLog;
+	InterlockedExchangeAdd64 (fetched, -ranges[i].got);
+	ranges[i].result = fetch_range (urls[(i + k) % nranges], filename,
+					ranges[i].start, ranges[i].length,
+					ranges[i].got, fetched);
+      }
+
+  for (size_t i = 0; i < nranges; i++)
+    if (ranges[i].result != fetch_ok)
+      {
+	remove (filename.c_str ());
+	return fetch_failed;
+      }
+
+  /* The pieces arrived out of order, so the digest has to be computed from
+     the finished file. */
+  if (digest && digest_file (filename, length, digest))
+    {
+      remove (filename.c_str ());
+      return fetch_failed;
+    }
+
+  return fetch_ok;
+}
+
+/* Move a completed download from tmpname to local and check it.  Returns
+   true if it's good; a corrupt download is deleted. */
+static bool
+accept_download (packagesource &pkgsource, const std::string &local,
+		 const std::string &tmpname, packagedigest &digest)
+{
+  try
+    {
+      if (_access (local.c_str (), 0) == 0)
+	remove (local.c_str ());
+      rename (tmpname.c_str (), local.c_str ());
+      pkgsource.check_size_and_cache ("file://" + local);
+      pkgsource.check_hash (digest);
+      Log (LOG_PLAIN) << "Downloaded " << local << endLog;
+      // FIXME: move the downloaded file to the
+      //  original locations - without the mirror site dir in the way
+      return true;
+    }
+  catch (Exception *e)
+    {
+      remove (local.c_str ());
+      pkgsource.set_cached ("");
+      if (e->errNo () == APPERR_CORRUPT_PACKAGE)
+	{
+	  Log (LOG_PLAIN) << "Downloaded file " << local
+			  << " is corrupt; deleting." << endLog;
+	  return false;
+	}
+      else
+	{
+	  Log (LOG_PLAIN) << "Unexpected exception while validating "
+			  << "downloaded file " << local
+			  << "; deleting." << endLog;
+	  throw e;
+	}
+    }
+}
+
+fetch_result
+fetch_package (packagesource &pkgsource, const std::string &cache_dir,
+	       size_t first_site, bool split, volatile long long *fetched,
+	       std::string &failed_file)
+{
+  size_t nsites = pkgsource.sites.size ();
+
+  if (split && nsites > 1 && pkgsource.size >= SPLIT_DOWNLOAD_SIZE)
+    {
+      std::vector<std::string> urls;
+      for (size_t k = 0; k < nsites && k < SPLIT_DOWNLOAD_RANGES; ++k)
+	urls.push_back (pkgsource.sites[(first_site + k) % nsites].key
+			+ pkgsource.Canonical ());
+      const std::string local = cache_dir + "/" +
+	rfc1738_escape_part (pkgsource.sites[first_site % nsites].key) + "/" +
+	pkgsource.Canonical ();
+      io_stream::mkpath_p (PATH_TO_FILE, "file://" + local, 0);
+
+      packagedigest digest (pkgsource);
+      switch (fetch_ranges_to_file (urls, local + ".split", pkgsource.size,
+				    &digest, fetched))
+	{
+	case fetch_ok:
+	  if (accept_download (pkgsource, local, local + ".split", digest))
+	    return fetch_ok;
+	  break;
+	case fetch_cant_write:
+	  {
+	    int err = errno;
+	    failed_file = local + ".split";
+	    errno = err;
+	  }
+	  return fetch_cant_write;
+	case fetch_failed:
+	  break;
+	}
+    }
+
+  /* try the download sites one after another */
+  for (size_t k = 0; k < nsites; ++k)
+    {
+      packagesource::sitestype::const_iterator n =
+	pkgsource.sites.begin () + (first_site + k) % nsites;
+      const std::string local = cache_dir + "/" +
+				  rfc1738_escape_part (n->key) + "/" +
+				  pkgsource.Canonical ();
+      io_stream::mkpath_p (PATH_TO_FILE, "file://" + local, 0);
+
+      /* hash the package as it arrives, rather than reading it back */
+      packagedigest digest (pkgsource);
+      switch (fetch_to_file (n->key + pkgsource.Canonical (), local + ".tmp",
+			     pkgsource.size, &digest, fetched))
+	{
+	case fetch_ok:
+	  if (accept_download (pkgsource, local, local + ".tmp", digest))
+	    return fetch_ok;
+	  break;
+	case fetch_cant_write:
+	  {
+	    int err = errno;
+	    failed_file = local + ".tmp";
+	    errno = err;
+	  }
+	  return fetch_cant_write;
+	case fetch_failed:
+	  /* FIXME: note new source ? */
+	  break;
+	}
+    }
+  return fetch_failed;
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+#ifndef SETUP_FETCH_H
+#define SETUP_FETCH_H
+
+/* Fetch packages from the mirrors into the local package cache.  Nothing
+ * here touches the GUI, so any thread may fetch: the bytes which arrive
+ * are added (atomically) to a counter, and whoever started the fetch
+ * shows the progress and reports the result.  The one exception is a
+ * server or proxy asking for credentials, which NetIO_IE5 asks the user
+ * for once, however many fetches it turned away.
+ */
+
+#include <string>
+#include <vector>
+
+class packagesource;
+class packagedigest;
+
+enum fetch_result
+{
+  fetch_ok = 0,
+  /* nothing usable arrived; another mirror, or another go, may do */
+  fetch_failed,
+  /* the file couldn't be created; errno says why */
+  fetch_cant_write
+};
+
+/* Fetch url into filename, of which expected_length bytes are expected.
+   If a previous attempt left part of filename behind, only the rest of
+   it is asked for, and what was already there is counted as fetched.
+   If digest is given, the whole file is added to it.  An interrupted
+   transfer leaves what arrived in filename, for the next attempt. */
+fetch_result fetch_to_file (const std::string &url,
+			    const std::string &filename,
+			    long long expected_length, packagedigest *digest,
+			    volatile long long *fetched);
+
+/* Fetch a file in as many pieces as there are urls (mirrors of the same
+   file), all at once, using HTTP range requests.  A piece which fails is
+   tried on each of the other mirrors in turn.  On failure the file is
+   removed. */
+fetch_result fetch_ranges_to_file (const std::vector<std::string> &urls,
+				   const std::string &filename,
+				   long long length, packagedigest *digest,
+				   volatile long long *fetched);
+
+/* Fetch pkgsource into cache_dir, trying its sites in turn, starting with
+   the first_site'th (modulo the number of sites), so that concurrent
+   fetches can be spread over the mirrors.  If split, a big package is
+   fetched in pieces from several mirrors at once.  Each download is
+   checked against the package's size and hash, and a corrupt one is
+   deleted; a good one becomes pkgsource's cached copy.  On
+   fetch_cant_write, failed_file is the file which couldn't be created.
+   Throws on unexpected errors, as packagesource's checks do. */
+fetch_result fetch_package (packagesource &pkgsource,
+			    const std::string &cache_dir, size_t first_site,
+			    bool split, volatile long long *fetched,
+			    std::string &failed_file);
+
+#endif /* SETUP_FETCH_H */
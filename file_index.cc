@@ -0,0 +1,523 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+#include "file_index.h"
+
+#include <string.h>
+#include <algorithm>
+
+#include "io_stream.h"
+
+/* The layout of files.idx: a header, the package names, each followed
+   by a NUL and its version and another NUL, the offsets of every RESTART_INTERVALth entry, and then the
+   entries.  An entry is the length of the path it shares with the one
+   before, the length and bytes of the rest, and the number of owners
+   and their numbers, all unsigned LEB128.  It is only ever read on the
+   machine which wrote it, so the header is in native byte order. */
+
+#define FILE_INDEX "cygfile:///etc/setup/files.idx"
+#define FILE_INDEX_NEW "cygfile:///etc/setup/files.idx.new"
+#define FILE_INDEX_MAGIC "SETUPFIX"
+#define FILE_INDEX_FORMAT 2
+#define RESTART_INTERVAL 16
+
+struct file_index_header
+{
+  char magic[8];
+  uint32_t format;
+  uint32_t npackages;
+  uint32_t nentries;
+  uint32_t nrestarts;
+  uint32_t names_len;
+  uint32_t entries_len;
+};
+
+static bool
+get_varint (const unsigned char *&p, const unsigned char *end, uint32_t &v)
+{
+  v = 0;
+  for (int shift = 0; shift < 35; shift += 7)
+    {
+      if (p >= end)
+	return false;
+      unsigned char c = *p++;
+      v |= (uint32_t) (c & 0x7f) << shift;
+      if (!(c & 0x80))
+	return true;
+    }
+  return false;
+}
+
+static void
+put_varint (std::string &out, uint32_t v)
+{
+  while (v >= 0x80)
+    {
+      out += (char) (v | 0x80);
+      v >>= 7;
+    }
+  out += (char) v;
+}
+
+/* Decodes the entries of the table in turn */
+struct FileIndex::cursor
+{
+  cursor (const unsigned char *p, const unsigned char *end)
+    : p (p), end (end), shared (0) {}
+  /* the next entry; false at the end, or if it is damaged */
+  bool next ()
+  {
+    uint32_t unshared, n;
+    if (p >= end || !get_varint (p, end, shared)
+	|| !get_varint (p, end, unshared) || shared > path.size ()
+	|| unshared > (size_t) (end - p))
+      return false;
+    path.resize (shared);
+    path.append ((const char *) p, unshared);
+    p += unshared;
+    if (!get_varint (p, end, n) || n > (size_t) (end - p))
+      return false;
+    owners.resize (n);
+    for (uint32_t i = 0; i < n; i++)
+      if (!get_varint (p, end, owners[i]))
+	return false;
+    return true;
+  }
+
+  const unsigned char *p;
+  const unsigned char *end;
+  uint32_t shared;
+  std::string path;
+  std::vector <uint32_t> owners;
+};
+
+void
+FileIndex::clear ()
+{
+  buf.clear ();
+  entries = entries_end = restarts = NULL;
+  nrestarts = table_packages = 0;
+  names.clear ();
+  versions.clear ();
+  numbers.clear ();
+  present.clear ();
+  stale.clear ();
+  begun.clear ();
+  added.clear ();
+  changed = false;
+}
+
+bool
+FileIndex::load (const package_versions &installed)
+{
+  io_stream *in = io_stream::open (FILE_INDEX, "rb", 0);
+  if (!in)
+    {
+      clear ();
+      return false;
+    }
+  bool ok = read (in);
+  delete in;
+  if (!ok)
+    return false;
+  if (!matches (installed))
+    {
+      clear ();
+      return false;
+    }
+  return true;
+}
+
+bool
+FileIndex::matches (const package_versions &installed) const
+{
+  /* names are distinct, so this is a comparison of the two sets */
+  uint32_t count = std::count (present.begin (), present.end (), 1);
+  if (installed.size () != count)
+    return false;
+  for (package_versions::const_iterator i = installed.begin ();
+       i != installed.end (); ++i)
+    {
+      std::map <std::string, uint32_t>::const_iterator n =
+	numbers.find (i->first);
+      if (n == numbers.end () || !present[n->second]
+	  || versions[n->second] != i->second)
+	return false;
+    }
+  return true;
+}
+
+bool
+FileIndex::read (io_stream *in)
+{
+  clear ();
+  file_index_header h;
+  if (!buf.read (in) || buf.size () < sizeof h)
+    {
+      clear ();
+      return false;
+    }
+  memcpy (&h, buf.data (), sizeof h);
+  if (memcmp (h.magic, FILE_INDEX_MAGIC, sizeof h.magic)
+      || h.format != FILE_INDEX_FORMAT
+      || (uint64_t) sizeof h + h.names_len + (uint64_t) h.nrestarts * 4
+	 + h.entries_len != buf.size ()
+      || h.nrestarts != (h.nentries + RESTART_INTERVAL - 1) / RESTART_INTERVAL
+      || (h.names_len && buf.data ()[sizeof h + h.names_len - 1] != '\0'))
+    {
+      clear ();
+      return false;
+    }
+
+  const char *name = buf.data () + sizeof h;
+  const char *names_end = name + h.names_len;
+  while (name < names_end)
+    {
+      std::string n (name);
+      name += n.size () + 1;
+      if (name >= names_end || numbers.find (n) != numbers.end ())
+	{
+	  clear ();
+	  return false;
+	}
+      std::string version (name);
+      name += version.size () + 1;
+      versions[number (n)] = version;
+    }
+  if (names.size () != h.npackages)
+    {
+      clear ();
+      return false;
+    }
+  table_packages = h.npackages;
+  std::fill (present.begin (), present.end (), 1);
+
+  restarts = (const unsigned char *) names_end;
+  nrestarts = h.nrestarts;
+  entries = restarts + (size_t) nrestarts * 4;
+  entries_end = entries + h.entries_len;
+  if (!validate (h.nentries))
+    {
+      clear ();
+      return false;
+    }
+  changed = false;
+  return true;
+}
+
+/* Check the whole table once, so that lookups need not */
+bool
+FileIndex::validate (uint32_t nentries)
+{
+  cursor c (entries, entries_end);
+  std::string prev;
+  uint32_t n;
+  for (n = 0; c.p < entries_end; n++)
+    {
+      const unsigned char *at = c.p;
+      if (!c.next () || c.owners.empty ())
+	return false;
+      if (n % RESTART_INTERVAL == 0)
+	{
+	  uint32_t offset;
+	  memcpy (&offset, restarts + (n / RESTART_INTERVAL) * 4, 4);
+	  if (c.shared != 0 || offset != at - entries)
+	    return false;
+	}
+      if (n && !(prev < c.path))
+	return false;
+      for (size_t i = 0; i < c.owners.size (); i++)
+	if (c.owners[i] >= table_packages)
+	  return false;
+      prev = c.path;
+    }
+  return n == nentries;
+}
+
+uint32_t
+FileIndex::number (const std::string &package)
+{
+  std::map <std::string, uint32_t>::iterator n = numbers.find (package);
+  if (n != numbers.end ())
+    return n->second;
+  uint32_t num = names.size ();
+  names.push_back (package);
+  versions.push_back (std::string ());
+  numbers[package] = num;
+  present.push_back (0);
+  stale.push_back (0);
+  begun.push_back (0);
+  return num;
+}
+
+/* Drop what package number n was added as owning */
+void
+FileIndex::forget (uint32_t n)
+{
+  if (!begun[n])
+    return;
+  pathmap::iterator i = added.begin ();
+  while (i != added.end ())
+    {
+      std::vector <uint32_t> &o = i->second;
+      o.erase (std::remove (o.begin (), o.end (), n), o.end ());
+      if (o.empty ())
+	added.erase (i++);
+      else
+	++i;
+    }
+}
+
+void
+FileIndex::begin (const std::string &package, const std::string &version)
+{
+  uint32_t n = number (package);
+  forget (n);
+  versions[n] = version;
+  if (n < table_packages)
+    stale[n] = 1;
+  present[n] = 1;
+  begun[n] = 1;
+  changed = true;
+}
+
+void
+FileIndex::add (const std::string &package, const std::string &path)
+{
+  uint32_t n = number (package);
+  std::vector <uint32_t> &o = added[path];
+  if (std::find (o.begin (), o.end (), n) == o.end ())
+    o.push_back (n);
+  changed = true;
+}
+
+void
+FileIndex::remove (const std::string &package)
+{
+  std::map <std::string, uint32_t>::iterator i = numbers.find (package);
+  if (i == numbers.end ())
+    return;
+  uint32_t n = i->second;
+  forget (n);
+  if (n < table_packages)
+    stale[n] = 1;
+  present[n] = 0;
+  changed = true;
+}
+
+/* How the path stored whole at restart point i compares with path */
+int
+FileIndex::compare_restart (uint32_t i, const std::string &path) const
+{
+  uint32_t offset, shared, len;
+  memcpy (&offset, restarts + i * 4, 4);
+  const unsigned char *p = entries + offset;
+  get_varint (p, entries_end, shared);
+  get_varint (p, entries_end, len);
+  int cmp = memcmp (p, path.data (), std::min ((size_t) len, path.size ()));
+  if (cmp)
+    return cmp;
+  return len < path.size () ? -1 : len > path.size ();
+}
+
+void
+FileIndex::table_owners (const std::string &path,
+			 std::vector <uint32_t> &result) const
+{
+  if (!nrestarts || compare_restart (0, path) > 0)
+    return;
+
+  /* the last restart point at or before path */
+  uint32_t lo = 0, hi = nrestarts;
+  while (hi - lo > 1)
+    {
+      uint32_t mid = lo + (hi - lo) / 2;
+      if (compare_restart (mid, path) <= 0)
+	lo = mid;
+      else
+	hi = mid;
+    }
+
+  uint32_t offset;
+  memcpy (&offset, restarts + lo * 4, 4);
+  cursor c (entries + offset, entries_end);
+  for (int i = 0; i < RESTART_INTERVAL && c.next (); i++)
+    {
+      int cmp = c.path.compare (path);
+      if (cmp > 0)
+	return;
+      if (cmp == 0)
+	{
+	  for (size_t j = 0; j < c.owners.size (); j++)
+	    if (!stale[c.owners[j]])
+	      result.push_back (c.owners[j]);
+	  return;
+	}
+    }
+}
+
+std::vector <std::string>
+FileIndex::owners (const std::string &path) const
+{
+  std::vector <uint32_t> nums;
+  table_owners (path, nums);
+  /* the table's owners are not stale, and those added are all begun
+     since, so the two cannot overlap */
+  pathmap::const_iterator a = added.find (path);
+  if (a != added.end ())
+    nums.insert (nums.end (), a->second.begin (), a->second.end ());
+
+  std::vector <std::string> result;
+  for (size_t i = 0; i < nums.size (); i++)
+    result.push_back (names[nums[i]]);
+  return result;
+}
+
+/* Number the packages which are still installed afresh, in order;
+   their names and versions go to names_out, if given.  Returns how many
+   there are. */
+uint32_t
+FileIndex::renumber (std::vector <uint32_t> &to, std::string *names_out) const
+{
+  uint32_t count = 0;
+  to.assign (names.size (), 0);
+  for (size_t i = 0; i < names.size (); i++)
+    if (present[i])
+      {
+	to[i] = count++;
+	if (names_out)
+	  {
+	    *names_out += names[i];
+	    *names_out += '\0';
+	    *names_out += versions[i];
+	    *names_out += '\0';
+	  }
+      }
+  return count;
+}
+
+/* Merge the table with the changes made since it was read, in order,
+   encoding the result into entries_out and restarts_out, if given.
+   Returns the number of entries. */
+uint32_t
+FileIndex::merge (std::vector <uint32_t> const &to, std::string *entries_out,
+		  std::string *restarts_out) const
+{
+  cursor t (entries, entries_end);
+  bool have_t = entries && t.next ();
+  pathmap::const_iterator a = added.begin ();
+  std::string prev;
+  std::vector <uint32_t> o;
+  uint32_t count = 0;
+
+  while (have_t || a != added.end ())
+    {
+      int cmp = !have_t ? 1 : a == added.end () ? -1 : t.path.compare (a->first);
+      const std::string &path = cmp <= 0 ? t.path : a->first;
+      o.clear ();
+      if (cmp <= 0)
+	for (size_t i = 0; i < t.owners.size (); i++)
+	  if (!stale[t.owners[i]])
+	    o.push_back (to[t.owners[i]]);
+      if (cmp >= 0)
+	for (size_t i = 0; i < a->second.size (); i++)
+	  o.push_back (to[a->second[i]]);
+
+      if (!o.empty ())
+	{
+	  if (entries_out)
+	    {
+	      size_t shared = 0;
+	      if (count % RESTART_INTERVAL == 0)
+		{
+		  uint32_t offset = entries_out->size ();
+		  restarts_out->append ((const char *) &offset, 4);
+		}
+	      else
+		while (shared < prev.size () && shared < path.size ()
+		       && prev[shared] == path[shared])
+		  shared++;
+	      put_varint (*entries_out, shared);
+	      put_varint (*entries_out, path.size () - shared);
+	      entries_out->append (path, shared, std::string::npos);
+	      put_varint (*entries_out, o.size ());
+	      for (size_t i = 0; i < o.size (); i++)
+		put_varint (*entries_out, o[i]);
+	      prev = path;
+	    }
+	  count++;
+	}
+
+      if (cmp <= 0)
+	have_t = t.next ();
+      if (cmp >= 0)
+	++a;
+    }
+  return count;
+}
+
+size_t
+FileIndex::size () const
+{
+  std::vector <uint32_t> to;
+  renumber (to, NULL);
+  return merge (to, NULL, NULL);
+}
+
+bool
+FileIndex::write (io_stream *out)
+{
+  std::string names_out, entries_out, restarts_out;
+  std::vector <uint32_t> to;
+
+  file_index_header h;
+  memcpy (h.magic, FILE_INDEX_MAGIC, sizeof h.magic);
+  h.format = FILE_INDEX_FORMAT;
+  h.npackages = renumber (to, &names_out);
+  h.nentries = merge (to, &entries_out, &restarts_out);
+  h.nrestarts = restarts_out.size () / 4;
+  h.names_len = names_out.size ();
+  h.entries_len = entries_out.size ();
+
+  return out->write (&h, sizeof h) == (ssize_t) sizeof h
+    && out->write (names_out.data (), names_out.size ())
+       == (ssize_t) names_out.size ()
+    && out->write (restarts_out.data (), restarts_out.size ())
+       == (ssize_t) restarts_out.size ()
+    && out->write (entries_out.data (), entries_out.size ())
+       == (ssize_t) entries_out.size ();
+}
+
+bool
+FileIndex::save ()
+{
+  if (!changed)
+    return true;
+
+  io_stream::mkpath_p (PATH_TO_FILE, FILE_INDEX_NEW, 0755);
+  io_stream *out = io_stream::open (FILE_INDEX_NEW, "wb", 0644);
+  if (!out)
+    return false;
+  bool written = write (out);
+  delete out;
+  if (!written)
+    {
+      io_stream::remove (FILE_INDEX_NEW);
+      return false;
+    }
+  io_stream::remove (FILE_INDEX);
+  if (io_stream::move (FILE_INDEX_NEW, FILE_INDEX))
+    return false;
+  changed = false;
+  return true;
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+#ifndef SETUP_FILE_INDEX_H
+#define SETUP_FILE_INDEX_H
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "IniBuffer.h"
+
+class io_stream;
+
+/* Which installed packages own which files: every
+   /etc/setup/<package>.lst.gz inverted into one table, so that the
+   owners of a path can be found without decompressing any manifests.
+
+   The table is kept in /etc/setup/files.idx, sorted by path, with each
+   path stored as the length it shares with the one before and the rest.
+   Every sixteenth path is stored whole, and those are binary searched,
+   so a lookup decodes at most sixteen entries.  Changes are held in
+   memory on top of the table, and merged into it by save ().
+
+   Paths are as they appear in the manifests: relative to the root, with
+   a trailing slash for directories.  Each package's version is kept with
+   its name, so that a table left behind by an older install, or by one
+   that never saved it, is rebuilt rather than trusted. */
+class FileIndex
+{
+public:
+  FileIndex () : entries (NULL), entries_end (NULL), restarts (NULL),
+    nrestarts (0), table_packages (0), changed (false) {}
+
+  /* installed packages, by name, with their versions */
+  typedef std::map <std::string, std::string> package_versions;
+
+  /* Load files.idx.  False, leaving the index empty, if it is missing or
+     damaged, or if it is not for exactly the packages and versions in
+     installed, in which case it should be built afresh with begin () and
+     add (). */
+  bool load (const package_versions &installed);
+  /* Write files.idx, if anything has changed; false on error */
+  bool save ();
+
+  /* as load () and save (), from and to any stream */
+  bool read (io_stream *);
+  bool write (io_stream *);
+  /* is for exactly the packages and versions in installed */
+  bool matches (const package_versions &installed) const;
+
+  /* version of package is being installed: forget what it owned before */
+  void begin (const std::string &package, const std::string &version);
+  /* package, which has been begun, owns path */
+  void add (const std::string &package, const std::string &path);
+  /* package has been uninstalled */
+  void remove (const std::string &package);
+
+  /* the packages which own path */
+  std::vector <std::string> owners (const std::string &path) const;
+  /* the number of paths, if saved now */
+  size_t size () const;
+
+private:
+  struct cursor;
+  void clear ();
+  bool validate (uint32_t nentries);
+  uint32_t number (const std::string &package);
+  void forget (uint32_t);
+  int compare_restart (uint32_t, const std::string &path) const;
+  void table_owners (const std::string &path,
+		     std::vector <uint32_t> &result) const;
+  uint32_t renumber (std::vector <uint32_t> &, std::string *names_out) const;
+  uint32_t merge (std::vector <uint32_t> const &, std::string *entries_out,
+		  std::string *restarts_out) const;
+
+  /* the table, as loaded */
+  IniBuffer buf;
+  const unsigned char *entries;
+  const unsigned char *entries_end;
+  const unsigned char *restarts;
+  uint32_t nrestarts;
+  uint32_t table_packages;
+
+  /* every package, by number, those in the table first */
+  std::vector <std::string> names;
+  /* the version of each, by number */
+  std::vector <std::string> versions;
+  std::map <std::string, uint32_t> numbers;
+  /* installed, by number */
+  std::vector <char> present;
+  /* has been uninstalled or begun again, so that what the table says it
+     owns no longer holds, by number */
+  std::vector <char> stale;
+  /* begun in this session, so perhaps with paths in added */
+  std::vector <char> begun;
+  /* paths owned by packages since begun */
+  typedef std::map <std::string, std::vector <uint32_t> > pathmap;
+  pathmap added;
+  bool changed;
+
+  FileIndex (const FileIndex &); // no copy cons
+  FileIndex &operator= (const FileIndex &); // no assignment
+};
+
+#endif /* SETUP_FILE_INDEX_H */
@@ -139,7 +139,7 @@ getUrlToStream (const std::string &_url, io_stream *output)
   Log (LOG_BABBLE) << "Fetched URL: " << _url << endLog;
 }
 
-io_stream *
+io_stream_memory *
 get_url_to_membuf (const std::string &_url, HWND owner)
 {
   io_stream_memory *membuf = new io_stream_memory ();
@@ -169,7 +169,7 @@ get_url_to_membuf (const std::string &_url, HWND owner)
 std::string
 get_url_to_string (const std::string &_url, HWND owner)
 {
-  io_stream *stream = get_url_to_membuf (_url, owner);
+  io_stream_memory *stream = get_url_to_membuf (_url, owner);
   if (!stream)
     return std::string();
   size_t bytes = stream->get_size ();
@@ -180,62 +180,8 @@ get_url_to_string (const std::string &_url, HWND owner)
       Log (LOG_BABBLE) << "get_url_to_string(): couldn't retrieve buffer size, or zero length buffer" << endLog;
       return std::string();
     }
-  char temp [bytes + 1];
-  /* membufs are quite safe */
-  stream->read (temp, bytes);
-  temp [bytes] = '\0';
+  /* up to any NUL, as before */
+  std::string s (stream->data (), strnlen (stream->data (), bytes));
   delete stream;
-  return std::string(temp);
-}
-
-int get_url_to_file(const std::string &_url, const std::string &_filename,
-                    int expected_length, HWND owner) 
-{
-  Log(LOG_BABBLE) << "get_url_to_file " << _url << " " << _filename << endLog;
-  if (total_download_bytes > 0) {
-    int df = diskfull(get_root_dir().c_str());
-    g_Progress.SetBar3(df);
-  }
-  init_dialog(_url, expected_length);
-
-  remove(_filename.c_str()); /* but ignore errors */
-
-  NetIO *n = NetIO::open(_url.c_str(), false);
-  if (!n || !n->ok()) {
-    delete n;
-    return 1;
-  }
-
-  FILE *f = nt_fopen(_filename.c_str(), "wb");
-  if (!f) {
-    const char *err = strerror(errno);
-    if (!err) err = "(unknown error)";
-    fatal(owner, IDS_ERR_OPEN_WRITE, _filename.c_str(), err);
-  }
-
-  if (n->file_size) max_bytes = n->file_size;
-
-  int total_bytes = 0;
-  progress(0);
-  while (1) {
-    char buf[8192];
-    int count;
-    count = n->read(buf, sizeof(buf));
-    if (count <= 0) break;
-    fwrite(buf, 1, count, f);
-    total_bytes += count;
-    progress(total_bytes);
-  }
-
-  total_download_bytes_sofar += total_bytes;
-
-  fclose(f);
-  if (n) delete n;
-
-  if (total_download_bytes > 0) {
-    int df = diskfull(get_root_dir().c_str());
-    g_Progress.SetBar3(df);
-  }
-
-  return 0;
+  return s;
 }
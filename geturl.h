@@ -25,10 +25,9 @@ extern long long int total_download_bytes;
 extern long long int total_download_bytes_sofar;
 
 class io_stream;
+class io_stream_memory;
 
-io_stream *get_url_to_membuf (const std::string &_url, HWND owner);
+io_stream_memory *get_url_to_membuf (const std::string &_url, HWND owner);
 std::string get_url_to_string (const std::string &_url, HWND owner);
-int get_url_to_file (const std::string &_url, const std::string &_filename,
-                     int expected_size, HWND owner);
 
 #endif /* SETUP_GETURL_H */
@@ -43,6 +43,9 @@
 
 #include "io_stream.h"
 #include "io_stream_memory.h"
+#include "IniBuffer.h"
+#include "IniDBBuilderRecorder.h"
+#include "threadpool.h"
 
 #include "threebar.h"
 
@@ -52,6 +55,7 @@
 #include "Exception.h"
 #include "crypto.h"
 #include "package_db.h"
+#include "sha2.h"
 
 extern ThreeBarProgressPage g_Progress;
 
@@ -129,52 +133,47 @@ public:
   int yyerror_count;
 };
 
-static io_stream*
-decompress_ini (io_stream *ini_file, std::string &current_ini_name)
+/* ini_file is a stream over raw, which is replaced by its decompressed
+   contents in ini.  ini_file is consumed either way. */
+static bool
+decompress_ini (io_stream *ini_file, IniBuffer &raw, IniBuffer &ini,
+		std::string &current_ini_name)
 {
-  // Replace the current compressed setup stream with its decompressed
-  // version.  Which decompressor to use is determined by file magic.
+  // Which decompressor to use is determined by file magic.
   io_stream *compressed_stream = compress::decompress (ini_file);
   if (!compressed_stream)
     {
       /* This isn't a known compression format or an uncompressed file
 	 stream.  Pass it on in case it was uncompressed, it will
 	 generate a parser error if it was some unknown format. */
-      delete compressed_stream;
+      delete ini_file;
+      ini.swap (raw);
+      return true;
     }
-  else
+
+  /* Decompress the entire file into a single buffer, which the scanner
+     then tokenizes in place.  This has the advantage that we know the
+     size during parsing and we'll have an accurate status bar, and
+     that the local cached copy of the .ini file below can be written
+     straight out of it.  The current uncompressed size of the
+     setup.ini file as of 2015 is about 5 MiB, so this is not a great
+     deal of memory.  */
+  bool ok = true;
+  if (!ini.read (compressed_stream) || (compressed_stream->error () != 0))
     {
-      /* Decompress the entire file in memory.  This has the advantage
-	 that input_stream->get_size () will work during parsing and
-	 we'll have an accurate status bar.  Also, we can't seek
-	 compressed streams, so when we write out a local cached copy
-	 of the .ini file below, we'd otherwise have to delete this
-	 stream and uncompress it again from the start, which is
-	 wasteful.  The current uncompressed size of the setup.ini
-	 file as of 2015 is about 5 MiB, so this is not a great deal
-	 of memory.  */
-      io_stream *uncompressed = new io_stream_memory ();
-      /* Note that the decompress io_stream now "owns" the underlying
-	 compressed io_stream instance, so it need not be deleted
-	 explicitly. */
-      if ((io_stream::copy (compressed_stream, uncompressed) != 0) ||
-	  (compressed_stream->error () != 0))
-	{
-	  /* There was a problem decompressing compressed_stream.  */
-	  Log (LOG_PLAIN) <<
-	    "Warning: Error code " << compressed_stream->error () <<
-	    " occurred while uncompressing " << current_ini_name <<
-	    " - possibly truncated or corrupt file. " << endLog;
-	  delete uncompressed;
-	  ini_file = NULL;
-	}
-      else
-	{
-	  ini_file = uncompressed;
-	  ini_file->seek (0, IO_SEEK_SET);
-	}
+      /* There was a problem decompressing compressed_stream.  */
+      Log (LOG_PLAIN) <<
+	"Warning: Error code " << compressed_stream->error () <<
+	" occurred while uncompressing " << current_ini_name <<
+	" - possibly truncated or corrupt file. " << endLog;
+      ini.clear ();
+      ok = false;
     }
-  return ini_file;
+  /* Note that the decompress io_stream "owns" the underlying compressed
+     io_stream instance, so deleting it deletes ini_file too. */
+  delete compressed_stream;
+  raw.clear ();
+  return ok;
 }
 
 static io_stream*
@@ -212,68 +211,262 @@ check_ini_sig (io_stream* ini_file, io_stream* ini_sig_file,
   return ini_file;
 }
 
+/* Feedback for a parse on a worker thread, which has to leave the GUI
+   alone: errors are kept, to be handed on to a GuiParseFeedback
+   afterwards. */
+class DeferredParseFeedback : public IniParseFeedback
+{
+public:
+  virtual void progress(unsigned long const, unsigned long const) {}
+  virtual void iniName(const std::string&) {}
+  virtual void babble(const std::string& message) const {
+    Log(LOG_BABBLE) << message << endLog;
+  }
+  virtual void warning(const std::string& message) const {
+    Log(LOG_PLAIN) << message << endLog;
+  }
+  virtual void note_error(int lineno, const std::string& error) {
+    errors.push_back(std::make_pair(lineno, error));
+  }
+  virtual bool has_errors() const { return !errors.empty(); }
+  virtual void show_errors() const {}
+  void replay(IniParseFeedback& to) const {
+    for (std::vector<std::pair<int, std::string> >::const_iterator i =
+             errors.begin();
+         i != errors.end(); ++i)
+      to.note_error(i->first, i->second);
+  }
+
+ private:
+  std::vector<std::pair<int, std::string> > errors;
+};
+
+/* One setup.ini, decompressed and parsed on a worker thread into a
+   recording, which is replayed into the package database on this thread
+   afterwards.  Replaying in the order the files were found gives the
+   same result as parsing them one after another.
+
+   When cache_path is set, a good recording is saved there, and used
+   instead of parsing the next time the same file comes from the same
+   site for the same version of setup. */
+class IniJob
+{
+public:
+  IniJob(const std::string& name, const std::string& site)
+      : name(name), site(site), ini_file(NULL), builder(feedback),
+        recorder(builder, &parser), parser(&recorder, parse_feedback),
+        decompressed(false), cached(false), result(0) {}
+
+  /* on a worker thread; consumes ini_file, a stream over raw */
+  void run() {
+    std::string key;
+    if (!cache_path.empty()) {
+      key = cache_key();
+      if (load_cache(key)) {
+        Log(LOG_BABBLE) << "Using cached package index " << cache_path
+                        << endLog;
+        delete ini_file;
+        ini_file = NULL;
+        decompressed = cached = true;
+        return;
+      }
+    }
+    decompressed = decompress_ini(ini_file, raw, ini, name);
+    ini_file = NULL;
+    if (decompressed) result = parser.parse(ini);
+    if (!key.empty() && !result && !parse_feedback.has_errors())
+      save_cache(key);
+  }
+
+  /* back on this thread, once run() has finished */
+  bool finish() {
+    feedback.iniName(name);
+    recorder.replay(&feedback);
+    parse_feedback.replay(feedback);
+    if (result || feedback.has_errors()) {
+      feedback.show_errors();
+      return false;
+    }
+    return true;
+  }
+
+  std::string name;
+  std::string site;
+  IniBuffer raw, ini;
+  io_stream* ini_file;
+  GuiParseFeedback feedback;
+  IniDBBuilderPackage builder;
+  DeferredParseFeedback parse_feedback;
+  IniDBBuilderRecorder recorder;
+  IniParser parser;
+  std::string cache_path;
+  IniBuffer cache;
+  bool decompressed;
+  bool cached;
+  int result;
+
+private:
+  /* The file as it was downloaded and verified, hashed, stands in for
+     its timestamp and signature. */
+  std::string cache_key() {
+    char digest[SHA256_DIGEST_STRING_LENGTH];
+    SHA256Data((const u_int8_t*)raw.data(), raw.size(), digest);
+    return site + "\n" + setup_version + "\n" + digest;
+  }
+
+  bool load_cache(const std::string& key) {
+    if (!cache.map(cache_path)) {
+      io_stream* f = io_stream::open("file://" + cache_path, "rb", 0);
+      if (!f) return false;
+      bool read = cache.read(f);
+      delete f;
+      if (!read) return false;
+    }
+    if (recorder.load(cache.data(), cache.size(), key)) return true;
+    cache.clear();
+    return false;
+  }
+
+  void save_cache(const std::string& key) {
+    const std::string fp = "file://" + cache_path;
+    io_stream::mkpath_p(PATH_TO_FILE, fp, 0);
+    if (io_stream* out = io_stream::open(fp, "wb", 0)) {
+      bool written = recorder.save(out, key);
+      delete out;
+      if (!written) io_stream::remove(fp);
+    }
+  }
+};
+
+/* Run the jobs, and merge their results into the package database in
+   order.  The IniDBBuilderPackage for each is destroyed (which is when
+   it finishes with the database) before the next is replayed. */
+static bool run_ini_jobs(ThreadPool& pool, std::vector<IniJob*>& jobs,
+                         HWND owner,
+                         void (*on_success)(IniJob*) = NULL)
+{
+  bool ini_error = false;
+  g_Progress.SetText1("Parsing...");
+  g_Progress.SetText2("");
+  g_Progress.SetText3("");
+  pool.wait();
+
+  for (std::vector<IniJob*>::iterator j = jobs.begin(); j != jobs.end(); ++j) {
+    IniJob* job = *j;
+    if (!job->decompressed) {
+      note(owner, IDS_SETUPINI_MISSING, SetupBaseName.c_str(),
+           job->site.c_str());
+      ini_error = true;
+    } else {
+      if (!job->finish())
+        ini_error = true;
+      else if (on_success)
+        on_success(job);
+      if (job->builder.timestamp > setup_timestamp) {
+        setup_timestamp = job->builder.timestamp;
+        ini_setup_version = job->builder.version;
+      }
+    }
+    delete job;
+    *j = NULL;
+  }
+  return ini_error;
+}
+
 static bool do_local_ini (HWND owner)
 {
   bool ini_error = false;
   io_stream *ini_file, *ini_sig_file;
+  ThreadPool pool;
+  std::vector<IniJob*> jobs;
   // iterate over all setup files found in do_from_local_dir
   for (IniList::const_iterator n = g_found_ini_list.begin();
        n != g_found_ini_list.end(); ++n) {
-    GuiParseFeedback myFeedback;
-    IniDBBuilderPackage aBuilder(myFeedback);
     bool sig_fail = false;
     std::string current_ini_ext, current_ini_name, current_ini_sig_name;
 
     current_ini_name = *n;
     current_ini_sig_name = current_ini_name + ".sig";
     current_ini_ext = current_ini_name.substr(current_ini_name.rfind(".") + 1);
+    IniJob* job = new IniJob(current_ini_name, "localdir");
     ini_sig_file = io_stream::open("file://" + current_ini_sig_name, "rb", 0);
-    ini_file = io_stream::open("file://" + current_ini_name, "rb", 0);
+    // map the file if we can, so that an uncompressed one is never copied
+    ini_file = NULL;
+    if (job->raw.map(current_ini_name))
+      ini_file = job->raw.stream();
+    else if (io_stream* f = io_stream::open("file://" + current_ini_name, "rb", 0)) {
+      if (job->raw.read(f)) ini_file = job->raw.stream();
+      delete f;
+    }
     ini_file = check_ini_sig(ini_file, ini_sig_file, sig_fail, "localdir",
                              current_ini_sig_name.c_str(), owner);
-    if (ini_file) ini_file = decompress_ini(ini_file, current_ini_name);
     if (!ini_file || sig_fail) {
       // no setup found or signature invalid
       note(owner, IDS_SETUPINI_MISSING, SetupBaseName.c_str(), "localdir");
       ini_error = true;
+      delete ini_file;
+      delete job;
     } else {
       // grok information from setup
-      myFeedback.babble("Found ini file - " + current_ini_name);
-      myFeedback.iniName(current_ini_name);
+      job->feedback.babble("Found ini file - " + current_ini_name);
       int ldl = local_dir.length() + 1;
       int cap = current_ini_name.rfind("/" + SetupArch);
-      aBuilder.parse_mirror =
+      job->builder.parse_mirror =
           rfc1738_unescape(current_ini_name.substr(ldl, cap - ldl));
-      ini_init(ini_file, &aBuilder, myFeedback);
-
-      if (yyparse() || myFeedback.has_errors()) {
-        myFeedback.show_errors();
-        ini_error = true;
-      }
-
-      if (aBuilder.timestamp > setup_timestamp) {
-        setup_timestamp = aBuilder.timestamp;
-        ini_setup_version = aBuilder.version;
-      }
-      delete ini_file;
-      ini_file = NULL;
+      job->ini_file = ini_file;
+      jobs.push_back(job);
+      pool.submit([job] () { job->run(); });
     }
   }
+  if (run_ini_jobs(pool, jobs, owner))
+    ini_error = true;
   return ini_error;
 }
 
+/* where a site's files are kept locally */
+static std::string remote_ini_path(const std::string& site,
+                                   const std::string& ext)
+{
+  return local_dir + "/" + rfc1738_escape_part(site) + "/" + SetupIniDir +
+         SetupBaseName + "." + ext;
+}
+
+/* save a known-good setup.ini locally; the scanner has put back every
+   byte it borrowed by the time it reached the end.  One which came from
+   the cache was saved when it was first parsed, and is only decompressed
+   again if that copy has gone since. */
+static void save_remote_ini(IniJob* job)
+{
+  const std::string fp = "file://" + remote_ini_path(job->site, "ini");
+  if (job->cached) {
+    if (io_stream::exists(fp)) return;
+    if (!decompress_ini(job->raw.stream(), job->raw, job->ini, job->name))
+      return;
+  }
+  io_stream::mkpath_p(PATH_TO_FILE, fp, 0);
+  if (io_stream* out = io_stream::open(fp, "wb", 0)) {
+    bool written =
+        out->write(job->ini.data(), job->ini.size()) == (ssize_t)job->ini.size();
+    delete out;
+    if (!written) io_stream::remove(fp);
+  }
+}
+
 static bool do_remote_ini (HWND owner)
 {
   bool ini_error = false;
   io_stream *ini_file = NULL, *ini_sig_file;
+  ThreadPool pool;
+  std::vector<IniJob*> jobs;
 
   /* FIXME: Get rid of this io_stream pointer travesty.  The need to
      explicitly delete these things is ridiculous. */
 
+  /* Each site's setup.ini is parsed while the next one downloads. */
+
   // iterate over all sites
   for (SiteList::const_iterator n = site_list.begin(); n != site_list.end(); ++n) {
-    GuiParseFeedback myFeedback;
-    IniDBBuilderPackage aBuilder(myFeedback);
+    IniJob* job = new IniJob("", n->url);
     bool sig_fail = false;
     std::string current_ini_ext, current_ini_name, current_ini_sig_name;
     // iterate over known extensions for setup
@@ -284,46 +477,32 @@ static bool do_remote_ini (HWND owner)
           n->url + SetupIniDir + SetupBaseName + "." + current_ini_ext;
       current_ini_sig_name = current_ini_name + ".sig";
       ini_sig_file = get_url_to_membuf(current_ini_sig_name, owner);
-      ini_file = get_url_to_membuf(current_ini_name, owner);
+      io_stream_memory* membuf = get_url_to_membuf(current_ini_name, owner);
+      ini_file = membuf && job->raw.take(membuf) ? job->raw.stream() : NULL;
+      delete membuf;
       ini_file = check_ini_sig(ini_file, ini_sig_file, sig_fail, n->url.c_str(),
                                current_ini_sig_name.c_str(), owner);
       // stop searching as soon as we find a setup file
       if (ini_file) break;
     }
-    if (ini_file) ini_file = decompress_ini(ini_file, current_ini_name);
     if (!ini_file || sig_fail) {
       // no setup found or signature invalid
       note(owner, IDS_SETUPINI_MISSING, SetupBaseName.c_str(), n->url.c_str());
       ini_error = true;
-    } else {
-      // grok information from setup
-      myFeedback.iniName(current_ini_name);
-      aBuilder.parse_mirror = n->url;
-      ini_init(ini_file, &aBuilder, myFeedback);
-
-      if (yyparse() || myFeedback.has_errors()) {
-        myFeedback.show_errors();
-        ini_error = true;
-      } else {
-        /* save known-good setup.ini locally */
-        const std::string fp = "file://" + local_dir + "/" +
-                               rfc1738_escape_part(n->url) + "/" + SetupIniDir +
-                               SetupBaseName + ".ini";
-        io_stream::mkpath_p(PATH_TO_FILE, fp, 0);
-        if (io_stream* out = io_stream::open(fp, "wb", 0)) {
-          ini_file->seek(0, IO_SEEK_SET);
-          if (io_stream::copy(ini_file, out) != 0) io_stream::remove(fp);
-          delete out;
-        }
-      }
-      if (aBuilder.timestamp > setup_timestamp) {
-        setup_timestamp = aBuilder.timestamp;
-        ini_setup_version = aBuilder.version;
-      }
       delete ini_file;
-      ini_file = NULL;
+      delete job;
+    } else {
+      job->name = current_ini_name;
+      job->cache_path = remote_ini_path(n->url, "idx");
+      job->builder.parse_mirror = n->url;
+      job->ini_file = ini_file;
+      jobs.push_back(job);
+      pool.submit([job] () { job->run(); });
     }
+    ini_file = NULL;
   }
+  if (run_ini_jobs(pool, jobs, owner, save_remote_ini))
+    ini_error = true;
   return ini_error;
 }
 
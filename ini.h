@@ -19,6 +19,7 @@
 class io_stream;
 #include <string>
 #include <vector>
+#include "arena.h"
 
 typedef std::vector <std::string> IniList;
 extern IniList g_found_ini_list, g_setup_ext_list;
@@ -32,9 +33,38 @@ extern std::string SetupBaseName;
 class IniState;
 class IniDBBuilder;
 class IniParseFeedback;
-void ini_init (io_stream *, IniDBBuilder *, IniParseFeedback &);
+class IniBuffer;
 #define YYSTYPE char *
 
+/* One parse of a setup.ini.  All of the scanner's and the grammar's state
+   lives here rather than in globals, so different threads may parse
+   different files at once, given a builder and feedback each. */
+class IniParser
+{
+public:
+  IniParser (IniDBBuilder *, IniParseFeedback &);
+  ~IniParser ();
+  /* Scan buffer in place; the strings handed to the builder stay valid
+     for as long as the parser does.  Returns non-zero if the parse
+     failed, like yyparse(). */
+  int parse (IniBuffer &);
+
+  /* for the use of the scanner and the grammar */
+  int lineno ();
+  void error (const std::string &);
+  IniDBBuilder *builder;
+  IniParseFeedback &feedback;
+  Arena tokens;
+  void *scanner;
+  const char *input_start;
+  const char *input_reported;
+  size_t input_size;
+
+private:
+  IniParser (const IniParser &); // no copy cons
+  IniParser &operator= (const IniParser &); // no assignment
+};
+
 /* When setup.ini is parsed, the information is stored according to
    the declarations here.  ini.cc (via inilex and iniparse)
    initializes these structures.  choose.cc sets the action and trust
@@ -42,8 +72,6 @@ void ini_init (io_stream *, IniDBBuilder *, IniParseFeedback &);
    packages (the chosen "install" field).  install.cc installs
    selected packages. */
 
-extern int yyparse ();
-
 /* The following definitions are used in the parser implementation */
 
 #define hexnibble(val)  ('\xff' & (val > '9') ? val - 'a' + 10 : val - '0')
@@ -16,8 +16,9 @@
  */
 
 /* tokenize the setup.ini files.  We parse a string which we've
-   previously downloaded.  The program must call ini_init() to specify
-   that string. */
+   previously downloaded, and which IniParser::parse() hands us to scan
+   in place.  The scanner is reentrant; all of its state belongs to the
+   IniParser, so that several files can be parsed at once. */
 
 #include "win32.h"
 #include <string.h>
@@ -27,16 +28,21 @@
 #include "String++.h"
 #include "IniParseFeedback.h"
 #include "sha2.h"
+#include "IniBuffer.h"
+#include "arena.h"
 
-#define YY_READ_BUF_SIZE 65536
-#define YY_INPUT(buf,result,max_size) { result = ini_getchar(buf, max_size); }
+#define YY_DECL static int ini_lex (YYSTYPE *yylval_param, void *yyscanner)
+#define YY_USER_ACTION ini_progress (yyextra, yytext);
 
-static int ini_getchar(char *buf, int max_size);
-static void ignore_line (void);
+static void ini_progress (IniParser *, const char *);
+static void ignore_line (void *);
 
 %}
 
 /*%option debug */
+%option reentrant
+%option bison-bridge
+%option extra-type="IniParser *"
 %option nounput
 %option noyywrap
 %option yylineno
@@ -49,37 +55,41 @@ B64	[a-zA-Z0-9_-]
 %%
 
 {HEX}{32} {
-    yylval = (char *) new unsigned char[16];
-    memset (yylval, 0, 16);
+    unsigned char *d = (unsigned char *) yyextra->tokens.alloc (16);
+    memset (d, 0, 16);
     int i, j;
     unsigned char v1, v2;
     for (i = 0, j = 0; i < 32; i += 2, ++j)
       {
 	v1 = hexnibble((unsigned char) yytext[i+0]);
 	v2 = hexnibble((unsigned char) yytext[i+1]);
-	((unsigned char *) yylval) [j] = nibbled1(v1, v2);
+	d[j] = nibbled1(v1, v2);
       }
+    *yylval = (char *) d;
     return MD5;
 }
 
 {HEX}{128} {
-    yylval = (char *) new unsigned char[SHA512_DIGEST_LENGTH];
-    memset (yylval, 0, SHA512_DIGEST_LENGTH);
+    unsigned char *d =
+      (unsigned char *) yyextra->tokens.alloc (SHA512_DIGEST_LENGTH);
+    memset (d, 0, SHA512_DIGEST_LENGTH);
     int i, j;
     unsigned char v1, v2;
     for (i = 0, j = 0; i < SHA512_BLOCK_LENGTH; i += 2, ++j)
       {
 	v1 = hexnibble((unsigned char) yytext[i+0]);
 	v2 = hexnibble((unsigned char) yytext[i+1]);
-	((unsigned char *) yylval) [j] = nibbled1(v1, v2);
+	d[j] = nibbled1(v1, v2);
       }
+    *yylval = (char *) d;
     return SHA512;
 }
 
 {B64}{86} {
     /* base64url as defined in RFC4648 */
-    yylval = (char *) new unsigned char[SHA512_DIGEST_LENGTH];
-    memset (yylval, 0, SHA512_DIGEST_LENGTH);
+    unsigned char *d =
+      (unsigned char *) yyextra->tokens.alloc (SHA512_DIGEST_LENGTH);
+    memset (d, 0, SHA512_DIGEST_LENGTH);
     int i, j;
     unsigned char v1, v2, v3, v4;
     for (i = 0, j = 0; i < 4*(SHA512_DIGEST_LENGTH/3); i += 4, j += 3)
@@ -88,21 +98,20 @@ B64	[a-zA-Z0-9_-]
 	v2 = b64url(((unsigned char) yytext[i+1]));
 	v3 = b64url(((unsigned char) yytext[i+2]));
 	v4 = b64url(((unsigned char) yytext[i+3]));
-	((unsigned char *) yylval) [j+0] = b64d1(v1, v2, v3, v4);
-	((unsigned char *) yylval) [j+1] = b64d2(v1, v2, v3, v4);
-	((unsigned char *) yylval) [j+2] = b64d3(v1, v2, v3, v4);
+	d[j+0] = b64d1(v1, v2, v3, v4);
+	d[j+1] = b64d2(v1, v2, v3, v4);
+	d[j+2] = b64d3(v1, v2, v3, v4);
       }
     v1 = b64url((unsigned char) yytext[i+0]);
     v2 = b64url((unsigned char) yytext[i+1]);
     v3 = 0;
     v4 = 0;
-    ((unsigned char *) yylval) [j+0] = b64d1(v1, v2, v3, v4);
+    d[j+0] = b64d1(v1, v2, v3, v4);
+    *yylval = (char *) d;
     return SHA512;
 }
 
-\"[^"]*\"		{ yylval = new char [strlen (yytext+1) + 1];
-			  strcpy (yylval, yytext+1);
-			  yylval[strlen (yylval)-1] = 0;
+\"[^"]*\"		{ *yylval = yyextra->tokens.strndup (yytext + 1, yyleng - 2);
 			  return STRING; }
 
 "setup-timestamp:"	return SETUP_TIMESTAMP;
@@ -130,7 +139,7 @@ B64	[a-zA-Z0-9_-]
 [pP]"rovides:"		return PROVIDES;
 [cC]"onflicts:"	return CONFLICTS;
 
-^{STR}":"		ignore_line ();
+^{STR}":"		ignore_line (yyscanner);
 
 "[curr]"		return T_CURR;
 "[test]"		return T_TEST;
@@ -150,8 +159,7 @@ B64	[a-zA-Z0-9_-]
 \,			return COMMA;
 "@"			return AT;
 
-{STR}			{ yylval = new char [strlen(yytext) + 1];
-  			  strcpy (yylval, yytext);
+{STR}			{ *yylval = yyextra->tokens.strndup (yytext, yyleng);
 			  return STRING; }
 
 [ \t\r]+		/* do nothing */;
@@ -163,45 +171,77 @@ B64	[a-zA-Z0-9_-]
 
 %%
 
-#include "io_stream.h"
+IniParser::IniParser (IniDBBuilder *aBuilder, IniParseFeedback &aFeedback)
+  : builder (aBuilder), feedback (aFeedback), scanner (NULL),
+    input_start (NULL), input_reported (NULL), input_size (0)
+{
+  yylex_init_extra (this, &scanner);
+}
+
+IniParser::~IniParser ()
+{
+  yylex_destroy (scanner);
+}
+
+int
+IniParser::parse (IniBuffer &buffer)
+{
+  /* yy_scan_buffer () wants the terminating NULs counted in the size */
+  YY_BUFFER_STATE input = yy_scan_buffer (buffer.data (), buffer.size () + 2,
+					  scanner);
+  yyset_lineno (1, scanner);
+  input_start = input_reported = buffer.data ();
+  input_size = buffer.size ();
+
+  int result = yyparse (this);
+
+  yy_delete_buffer (input, scanner);
+  return result;
+}
+
+int
+IniParser::lineno ()
+{
+  return yyget_lineno (scanner);
+}
+
+void
+IniParser::error (const std::string& s)
+{
+  struct yyguts_t *yyg = (struct yyguts_t *) scanner;
+  feedback.note_error(yylineno - (!!YY_AT_BOL ()), s);
+}
 
-static io_stream *input_stream = 0;
-extern IniDBBuilder *iniBuilder;
-static IniParseFeedback *iniFeedback;
+int
+yylex (YYSTYPE *lvalp, IniParser *parser)
+{
+  return ini_lex (lvalp, parser->scanner);
+}
 
 void
-ini_init(io_stream *stream, IniDBBuilder *aBuilder, IniParseFeedback &aFeedback)
+yyerror (IniParser *parser, const std::string& s)
 {
-  input_stream = stream;
-  iniBuilder = aBuilder;
-  iniFeedback = &aFeedback;
-  YY_FLUSH_BUFFER;
-  yylineno = 1;
+  parser->error (s);
 }
 
-static int
-ini_getchar(char *buf, int max_size)
+/* There's no reading to hang progress reports on any more, so report
+   every 64k of tokens instead. */
+static void
+ini_progress (IniParser *parser, const char *text)
 {
-  if (input_stream)
+  if (text - parser->input_reported >= 65536)
     {
-      ssize_t len = input_stream->read (buf, max_size);
-      if (len < 1)
-        {
-	  len = 0;
-	  input_stream = 0;
-	}
-      else
-        iniFeedback->progress (input_stream->tell(), input_stream->get_size());
-      return len;
+      parser->input_reported = text;
+      parser->feedback.progress (text - parser->input_start,
+				 parser->input_size);
     }
-  return 0;
 }
 
 static void
-ignore_line ()
+ignore_line (void *yyscanner)
 {
   char c;
-  while ((c = yyinput ()))
+  while ((c = yyinput (yyscanner)))
     {
       if (c == EOF)
 	return;
@@ -209,9 +249,3 @@ ignore_line ()
 	return;
     }
 }
-
-void
-yyerror (const std::string& s)
-{
-  iniFeedback->note_error(yylineno - (!!YY_AT_BOL ()), s);
-}
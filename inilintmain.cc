@@ -14,6 +14,7 @@
  */
 
 #include "io_stream.h"
+#include "IniBuffer.h"
 #include "IniDBBuilderLint.h"
 #include "CliParseFeedback.h"
 #include "ini.h"
@@ -39,20 +40,25 @@ main (int argc, char **argv)
   std::string inifilename = argv[1];
 
   // Note: this only accepts absolute pathnames
-  io_stream *ini_file = io_stream::open ("file://" + inifilename, "rb", 0);
-  if (!ini_file)
+  IniBuffer ini;
+  if (!ini.map (inifilename))
     {
-      std::cerr << "could not open " << inifilename << std::endl;
-      return 1;
+      io_stream *ini_file = io_stream::open ("file://" + inifilename, "rb", 0);
+      if (!ini_file || !ini.read (ini_file))
+	{
+	  std::cerr << "could not open " << inifilename << std::endl;
+	  return 1;
+	}
+      delete ini_file;
     }
 
   CliParseFeedback feedback;
   IniDBBuilderLint builder;
-  ini_init(ini_file, &builder, feedback);
+  IniParser parser (&builder, feedback);
 
   // Note: unrecognized lines are ignored by ignore_line(), so this is currently
   // only useful for finding where recognized lines don't fit the grammar.
-  yyparse();
+  parser.parse (ini);
 
   return 0;
 }
@@ -22,19 +22,24 @@
 #include "iniparse.hh"
 #include "PackageTrust.h"
 
-extern int yyerror (const std::string& s);
-int yylex ();
+extern void yyerror (IniParser *, const std::string& s);
+int yylex (YYSTYPE *, IniParser *);
 
 #include "IniDBBuilder.h"
 
 #define YYERROR_VERBOSE 1
 #define YYINITDEPTH 1000
 /*#define YYDEBUG 1*/
-
-IniDBBuilder *iniBuilder;
-extern int yylineno;
 %}
 
+%code requires { class IniParser; }
+
+/* Everything the parse needs is in the IniParser, so that several can
+   run at once on different threads. */
+%define api.pure full
+%parse-param {IniParser *parser}
+%lex-param {IniParser *parser}
+
 %token STRING
 %token SETUP_TIMESTAMP
 %token SETUP_VERSION
@@ -72,11 +77,11 @@ setup_headers: /* empty */
  ;
 
 header /* non-empty */
- : SETUP_TIMESTAMP STRING	{ iniBuilder->buildTimestamp ($2); } NL
- | SETUP_VERSION STRING		{ iniBuilder->buildVersion ($2); } NL
- | RELEASE STRING		{ iniBuilder->set_release ($2); } NL
- | ARCH STRING			{ iniBuilder->set_arch ($2); } NL
- | SETUP_MINIMUM_VERSION STRING { std::string e = iniBuilder->buildMinimumVersion ($2); if (!e.empty()) { yyerror(e); } } NL
+ : SETUP_TIMESTAMP STRING	{ parser->builder->buildTimestamp ($2); } NL
+ | SETUP_VERSION STRING		{ parser->builder->buildVersion ($2); } NL
+ | RELEASE STRING		{ parser->builder->set_release ($2); } NL
+ | ARCH STRING			{ parser->builder->set_arch ($2); } NL
+ | SETUP_MINIMUM_VERSION STRING { std::string e = parser->builder->buildMinimumVersion ($2); if (!e.empty()) { yyerror(parser, e); } } NL
  ;
 
 packages: /* empty */
@@ -92,8 +97,8 @@ package /* non-empty */
  ;
 
 packagename /* non-empty */
- : AT STRING		{ iniBuilder->buildPackage ($2); }
- | PACKAGENAME STRING	{ iniBuilder->buildPackage ($2); }
+ : AT STRING		{ parser->builder->buildPackage ($2); }
+ | PACKAGENAME STRING	{ parser->builder->buildPackage ($2); }
  ;
 
 packagedata: /* empty */
@@ -101,44 +106,44 @@ packagedata: /* empty */
  ;
 
 singleitem /* non-empty */
- : PACKAGEVERSION STRING NL	{ iniBuilder->buildPackageVersion ($2); }
- | SDESC STRING NL		{ iniBuilder->buildPackageSDesc($2); }
- | LDESC STRING NL		{ iniBuilder->buildPackageLDesc($2); }
- | T_PREV NL 			{ iniBuilder->buildPackageTrust (TRUST_PREV); }
- | T_CURR NL			{ iniBuilder->buildPackageTrust (TRUST_CURR); }
- | T_TEST NL			{ iniBuilder->buildPackageTrust (TRUST_TEST); }
- | T_OTHER NL			{ iniBuilder->buildPackageTrust (TRUST_OTHER); }
+ : PACKAGEVERSION STRING NL	{ parser->builder->buildPackageVersion ($2); }
+ | SDESC STRING NL		{ parser->builder->buildPackageSDesc($2); }
+ | LDESC STRING NL		{ parser->builder->buildPackageLDesc($2); }
+ | T_PREV NL 			{ parser->builder->buildPackageTrust (TRUST_PREV); }
+ | T_CURR NL			{ parser->builder->buildPackageTrust (TRUST_CURR); }
+ | T_TEST NL			{ parser->builder->buildPackageTrust (TRUST_TEST); }
+ | T_OTHER NL			{ parser->builder->buildPackageTrust (TRUST_OTHER); }
  | SOURCEPACKAGE source NL
  | CATEGORY categories NL
- | INSTALL STRING STRING MD5 NL { iniBuilder->buildPackageInstall ($2, $3, $4, hashType::md5); }
- | INSTALL STRING STRING SHA512 NL { iniBuilder->buildPackageInstall ($2, $3, $4, hashType::sha512); }
- | SOURCE STRING STRING MD5 NL {iniBuilder->buildPackageSource ($2, $3, $4, hashType::md5); }
- | SOURCE STRING STRING SHA512 NL {iniBuilder->buildPackageSource ($2, $3, $4, hashType::sha512); }
- | DEPENDS { iniBuilder->buildBeginDepends(); } versionedpackagelist NL
- | REQUIRES { iniBuilder->buildBeginDepends(); } versionedpackagelistsp NL
- | BUILDDEPENDS { iniBuilder->buildBeginBuildDepends(); } versionedpackagelist NL
- | OBSOLETES { iniBuilder->buildBeginObsoletes(); } versionedpackagelist NL
- | PROVIDES { iniBuilder->buildBeginProvides(); } versionedpackagelist NL
- | CONFLICTS { iniBuilder->buildBeginConflicts(); } versionedpackagelist NL
+ | INSTALL STRING STRING MD5 NL { parser->builder->buildPackageInstall ($2, $3, $4, hashType::md5); }
+ | INSTALL STRING STRING SHA512 NL { parser->builder->buildPackageInstall ($2, $3, $4, hashType::sha512); }
+ | SOURCE STRING STRING MD5 NL {parser->builder->buildPackageSource ($2, $3, $4, hashType::md5); }
+ | SOURCE STRING STRING SHA512 NL {parser->builder->buildPackageSource ($2, $3, $4, hashType::sha512); }
+ | DEPENDS { parser->builder->buildBeginDepends(); } versionedpackagelist NL
+ | REQUIRES { parser->builder->buildBeginDepends(); } versionedpackagelistsp NL
+ | BUILDDEPENDS { parser->builder->buildBeginBuildDepends(); } versionedpackagelist NL
+ | OBSOLETES { parser->builder->buildBeginObsoletes(); } versionedpackagelist NL
+ | PROVIDES { parser->builder->buildBeginProvides(); } versionedpackagelist NL
+ | CONFLICTS { parser->builder->buildBeginConflicts(); } versionedpackagelist NL
  | REPLACE_VERSIONS versionlist NL
 
- | MESSAGE STRING STRING NL	{ iniBuilder->buildMessage ($2, $3); }
- | error NL			{ yyerror (std::string("unrecognized line ")
-					  + stringify(yylineno)
+ | MESSAGE STRING STRING NL	{ parser->builder->buildMessage ($2, $3); }
+ | error NL			{ yyerror (parser, std::string("unrecognized line ")
+					  + stringify(parser->lineno ())
 					  + " (do you have the latest setup?)");
 				}
  ;
 
 categories: /* empty */
- | categories STRING		{ iniBuilder->buildPackageCategory ($2); }
+ | categories STRING		{ parser->builder->buildPackageCategory ($2); }
  ;
 
 source /* non-empty */
- : STRING { iniBuilder->buildSourceName ($1); } versioninfo
+ : STRING { parser->builder->buildSourceName ($1); } versioninfo
  ;
 
 versioninfo: /* empty */
- | OPENBRACE STRING CLOSEBRACE { iniBuilder->buildSourceNameVersion ($2); }
+ | OPENBRACE STRING CLOSEBRACE { parser->builder->buildSourceNameVersion ($2); }
  ;
 
 versionedpackagelist: /* empty */
@@ -157,23 +162,23 @@ listseparator /* non-empty */
  ;
 
 versionedpackageentry /* non-empty */
- : STRING { iniBuilder->buildPackageListNode($1); } versioncriteria
+ : STRING { parser->builder->buildPackageListNode($1); } versioncriteria
  ;
 
 versioncriteria: /* empty */
- | OPENBRACE operator STRING CLOSEBRACE { iniBuilder->buildPackageListOperatorVersion ($3); }
+ | OPENBRACE operator STRING CLOSEBRACE { parser->builder->buildPackageListOperatorVersion ($3); }
  ;
 
 operator /* non-empty */
- : EQUAL { iniBuilder->buildPackageListOperator (PackageSpecification::Equals); }
- | LT { iniBuilder->buildPackageListOperator (PackageSpecification::LessThan); }
- | GT { iniBuilder->buildPackageListOperator (PackageSpecification::MoreThan); }
- | LTEQUAL { iniBuilder->buildPackageListOperator (PackageSpecification::LessThanEquals); }
- | GTEQUAL { iniBuilder->buildPackageListOperator (PackageSpecification::MoreThanEquals); }
+ : EQUAL { parser->builder->buildPackageListOperator (PackageSpecification::Equals); }
+ | LT { parser->builder->buildPackageListOperator (PackageSpecification::LessThan); }
+ | GT { parser->builder->buildPackageListOperator (PackageSpecification::MoreThan); }
+ | LTEQUAL { parser->builder->buildPackageListOperator (PackageSpecification::LessThanEquals); }
+ | GTEQUAL { parser->builder->buildPackageListOperator (PackageSpecification::MoreThanEquals); }
  ;
 
 versionlist: /* empty */
- | versionlist STRING { iniBuilder->buildPackageReplaceVersionsList ($2); }
+ | versionlist STRING { parser->builder->buildPackageReplaceVersionsList ($2); }
  ;
 
 %%
@@ -33,11 +33,13 @@
 #include <sys/stat.h>
 #include <errno.h>
 #include <process.h>
+#include <algorithm>
 
 #include "ini.h"
 #include "resource.h"
 #include "dialog.h"
 #include "geturl.h"
+#include "download.h"
 #include "state.h"
 #include "diskfull.h"
 #include "msg.h"
@@ -45,11 +47,16 @@
 #include "mount.h"
 #include "filemanip.h"
 #include "io_stream.h"
+#include "io_stream_readahead.h"
+#include "cygfile_fs.h"
 #include "compress.h"
-#include "compress_gz.h"
 #include "archive.h"
 #include "archive_tar.h"
+#include "prefetch.h"
 #include "script.h"
+#include "threadpool.h"
+#include "file_index.h"
+#include "manifest.h"
 
 #include "package_db.h"
 #include "package_meta.h"
@@ -82,22 +89,30 @@ class Installer
     Installer();
     void initDialog();
     void progress (int bytes);
+    void loadFiles ();
     void preremoveOne (packagemeta &);
     void uninstallOne (packagemeta &);
     void replaceOnRebootFailed (const std::string& fn);
     void replaceOnRebootSucceeded (const std::string& fn, bool &rebootneeded);
     void installOne (packagemeta &pkg, const packageversion &ver,
                      packagesource &source,
-                     const std::string& , const std::string&, HWND );
+                     const std::string& , const std::string&, HWND,
+                     io_stream *prefetched = NULL);
     int errors;
+    FileIndex files;
   private:
+    ManifestWriter::method manifest_method;
+    int manifest_level;
     bool extract_replace_on_reboot(archive *, const std::string&,
                                    const std::string&, std::string);
+    /* the directories made so far, which need no checking again */
+    extract_context extracted;
 
 };
 
 Installer::Installer() : errors(0)
 {
+  ManifestWriter::configured(manifest_method, manifest_level);
 }
 
 void
@@ -145,6 +160,45 @@ Installer::StandardDirs[] = {
 
 static int s_num_installs, s_num_uninstalls;
 
+/* Load the index of which installed package owns which file, or, if it
+   is missing or out of date, build it afresh from their manifests. */
+void
+Installer::loadFiles ()
+{
+  packagedb db;
+  FileIndex::package_versions installed;
+  for (packagedb::packagecollection::iterator i = db.packages.begin ();
+       i != db.packages.end (); ++i)
+    if (i->second->installed)
+      installed[i->first] = i->second->installed.Canonical_version ();
+
+  if (files.load (installed))
+    return;
+
+  g_Progress.SetText1 ("Indexing installed files...");
+  Log (LOG_BABBLE) << "Building the installed file index" << endLog;
+  for (FileIndex::package_versions::iterator n = installed.begin ();
+       n != installed.end (); ++n)
+    {
+      files.begin (n->first, n->second);
+      io_stream *listfile =
+        io_stream::open ("cygfile:///etc/setup/" + n->first + ".lst.gz",
+                         "rb", 0);
+      io_stream *listdata = compress::decompress (listfile);
+      if (!listdata)
+        {
+          delete listfile;
+          continue;
+        }
+      char getfilenamebuffer[CYG_PATH_MAX];
+      while (const char *sz =
+               listdata->gets (getfilenamebuffer, sizeof (getfilenamebuffer)))
+        if (*sz)
+          files.add (n->first, sz);
+      delete listdata;
+    }
+}
+
 void
 Installer::preremoveOne (packagemeta & pkg)
 {
@@ -165,66 +219,30 @@ void Installer::uninstallOne(packagemeta &pkg)
   g_Progress.SetText2 (pkg.name.c_str());
   Log (LOG_PLAIN) << "Uninstalling " << pkg.name << endLog;
 
-  std::set<std::string> dirs;
-
   io_stream *listfile = io_stream::open ("cygfile:///etc/setup/" + pkg.name + ".lst.gz", "rb", 0);
   io_stream *listdata = compress::decompress (listfile);
 
-  while (listdata) {
-    char getfilenamebuffer[CYG_PATH_MAX];
-    const char *sz =
-        listdata->gets(getfilenamebuffer, sizeof(getfilenamebuffer));
-    if (sz == NULL) break;
-
-    std::string line(sz);
-
-    /* Insert the paths of all parent directories of line into dirs. */
-    size_t idx = line.length();
-    while ((idx = line.find_last_of('/', idx - 1)) != std::string::npos) {
-      std::string dir_path = line.substr(0, idx);
-      bool was_new = dirs.insert(dir_path).second;
-      /* If the path was already present in dirs, then all parent paths
-       * must necessarily be present also, so don't do any further work.
-       * */
-      if (!was_new) break;
-    }
-
-    std::string d = cygpath("/" + line);
-    WCHAR wname[d.size() + 11]; /* Prefix + ".lnk". */
-    mklongpath(wname, d.c_str(), d.size() + 11);
-    DWORD dw = GetFileAttributesW(wname);
-    if (dw != INVALID_FILE_ATTRIBUTES && !(dw & FILE_ATTRIBUTE_DIRECTORY)) {
-      Log(LOG_BABBLE) << "unlink " << d << endLog;
-      SetFileAttributesW(wname, dw & ~FILE_ATTRIBUTE_READONLY);
-      DeleteFileW(wname);
-    }
-    /* Check for Windows shortcut of same name. */
-    d += ".lnk";
-    wcscat(wname, L".lnk");
-    dw = GetFileAttributesW(wname);
-    if (dw != INVALID_FILE_ATTRIBUTES && !(dw & FILE_ATTRIBUTE_DIRECTORY)) {
-      Log(LOG_BABBLE) << "unlink " << d << endLog;
-      SetFileAttributesW(wname, dw & ~FILE_ATTRIBUTE_READONLY);
-      DeleteFileW(wname);
-    }
-  }
+  remove_listed_files(listdata, cygfile_fs::get(),
+                      [&] (const std::string &line) -> bool {
+    /* Leave files which another installed package has claimed since */
+    std::vector<std::string> owners = files.owners(line);
+    for (size_t i = 0; i < owners.size(); i++)
+      if (owners[i] != pkg.name) {
+        Log(LOG_BABBLE) << "Leaving /" << line << ", which " << owners[i]
+                        << " also owns" << endLog;
+        return true;
+      }
+    return false;
+  });
 
   /* Remove the listing file */
   delete listdata;
   io_stream::remove("cygfile:///etc/setup/" + pkg.name + ".lst.gz");
-
-  /* An STL set maintains itself in sorted order. Thus, iterating over it
-   * in reverse order will ensure we process directories depth-first. */
-  std::set<std::string>::const_iterator it = dirs.end();
-  while (it != dirs.begin()) {
-    it--;
-    std::string d = cygpath("/" + *it);
-    WCHAR wname[d.size() + 11];
-    mklongpath(wname, d.c_str(), d.size() + 11);
-    if (RemoveDirectoryW(wname)) Log(LOG_BABBLE) << "rmdir " << d << endLog;
-  }
+  files.remove(pkg.name);
 
   pkg.installed = packageversion();
+  packagedb db;
+  db.journal(pkg);
   s_num_uninstalls++;
 }
 
@@ -376,7 +394,8 @@ bool Installer::extract_replace_on_reboot(archive *tarstream,
 {
   /* Extract a copy of the file with extension .new appended and
      indicate it should be replaced on the next reboot.  */
-  if (archive::extract_file(tarstream, prefixURL, prefixPath, ".new") != 0) {
+  if (archive::extract_file(tarstream, prefixURL, prefixPath, ".new",
+                            &extracted) != 0) {
     Log(LOG_PLAIN) << "Unable to install file " << prefixURL << prefixPath << fn
                    << ".new" << endLog;
     ++errors;
@@ -402,13 +421,15 @@ bool Installer::extract_replace_on_reboot(archive *tarstream,
 
 static char all_null[512];
 
-/* install one source at a given prefix. */
+/* install one source at a given prefix.  If prefetched is non-NULL, it is
+   the already decompressed contents of source, and is used instead of
+   reading the cached file. */
 void
 Installer::installOne (packagemeta &pkgm, const packageversion &ver,
                        packagesource &source,
                        const std::string& prefixURL,
                        const std::string& prefixPath,
-                       HWND owner)
+                       HWND owner, io_stream *prefetched)
 {
   if (!source.Canonical()) return;
   g_Progress.SetText1("Installing");
@@ -422,7 +443,9 @@ Installer::installOne (packagemeta &pkgm, const packageversion &ver,
     return;
   }
 
-  if (!io_stream::exists(source.Cached()) ||
+  if (prefetched)
+    pkgfile = prefetched;
+  else if (!io_stream::exists(source.Cached()) ||
       !(pkgfile = io_stream::open(source.Cached(), "rb", 0))) {
     note(NULL, IDS_ERR_OPEN_READ, source.Cached(), "No such file");
     ++errors;
@@ -443,8 +466,16 @@ Installer::installOne (packagemeta &pkgm, const packageversion &ver,
 
   archive *tarstream = NULL;
   io_stream *try_decompress = NULL;
+  /* if set, pkgfile is read on its thread, and only it may ask where
+     pkgfile is */
+  io_stream_readahead *ahead = NULL;
+
+  if (prefetched)
+    try_decompress = prefetched;
+  else
+    try_decompress = decompress_package(pkgfile, &ahead);
 
-  if ((try_decompress = compress::decompress(pkgfile)) != NULL) {
+  if (try_decompress) {
     if ((tarstream = archive::extract(try_decompress)) == NULL) {
       /* Decompression succeeded but we couldn't grok it as a valid tar
          archive.  */
@@ -458,7 +489,12 @@ Installer::installOne (packagemeta &pkgm, const packageversion &ver,
          Same goes for tar archives consisting of a big block of
          all zero bytes (the famous 46 bytes tar archives). */
       {
-        if (ver.Type() == package_binary) pkgm.installed = ver;
+        if (ver.Type() == package_binary) {
+          files.begin(pkgm.name, ver.Canonical_version());
+          pkgm.installed = ver;
+          packagedb db;
+          db.journal(pkgm);
+        }
       } else {
         note(NULL, IDS_ERR_OPEN_READ, source.Cached(),
              "Invalid or unsupported tar format");
@@ -479,9 +515,10 @@ Installer::installOne (packagemeta &pkgm, const packageversion &ver,
   /* For binary packages, create a manifest in /etc/setup/ that lists the
      filename of each file that was unpacked.  */
 
-  io_stream *lst = NULL;
+  ManifestWriter *lst = NULL;
+  std::string lstfn = "cygfile:///etc/setup/" + pkgm.name + ".lst.gz";
   if (ver.Type() == package_binary) {
-    std::string lstfn = "cygfile:///etc/setup/" + pkgm.name + ".lst.gz";
+    files.begin(pkgm.name, ver.Canonical_version());
 
     io_stream *tmp;
     if ((tmp = io_stream::open(lstfn, "wb", 0644)) == NULL)
@@ -489,17 +526,8 @@ Installer::installOne (packagemeta &pkgm, const packageversion &ver,
           << "Warning: Unable to create lst file " + lstfn +
                  " - uninstall of this package will leave orphaned files."
           << endLog;
-    else {
-      lst = new compress_gz(tmp, "w9");
-      if (lst->error()) {
-        delete lst;
-        lst = NULL;
-        Log(LOG_PLAIN)
-            << "Warning: gzip unable to write to lst file " + lstfn +
-                   " - uninstall of this package will leave orphaned files."
-            << endLog;
-      }
-    }
+    else
+      lst = new ManifestWriter(tmp, manifest_method, manifest_level);
   }
 
   bool error_in_this_package = false;
@@ -523,15 +551,14 @@ Installer::installOne (packagemeta &pkgm, const packageversion &ver,
     g_Progress.SetText3(canonicalfn.c_str());
     Log(LOG_BABBLE) << "Installing file " << prefixURL << prefixPath << fn
                     << endLog;
-    if (lst) {
-      std::string tmp = fn + "\n";
-      lst->write(tmp.c_str(), tmp.size());
-    }
+    if (lst) lst->add(fn);
+    if (ver.Type() == package_binary) files.add(pkgm.name, fn);
     if (Script::isAScript(fn)) pkgm.addScript(Script(canonicalfn));
 
     int iteration = 0;
     archive::extract_results extres;
-    while ((extres = archive::extract_file(tarstream, prefixURL, prefixPath)) !=
+    while ((extres = archive::extract_file(tarstream, prefixURL, prefixPath,
+                                           std::string(), &extracted)) !=
            archive::extract_ok) {
       bool error_in_this_file = false;
 
@@ -680,11 +707,29 @@ Installer::installOne (packagemeta &pkgm, const packageversion &ver,
 
       break;
     }
-    progress(pkgfile->tell());
+    /* progress is measured in compressed bytes; a prefetched stream only
+       knows its position in the decompressed data, so scale it */
+    if (prefetched && pkgfile->get_size())
+      progress((long long int) pkgfile->tell() * package_bytes
+               / pkgfile->get_size());
+    else if (ahead)
+      progress(ahead->source_tell());
+    else
+      progress(pkgfile->tell());
     s_num_installs++;
   }
+  if (tarstream->error()) {
+    Log(LOG_PLAIN) << "Damaged archive " << source.Cached() << endLog;
+    ++errors;
+    error_in_this_package = true;
+  }
 
-  if (lst) delete lst;
+  if (lst && !lst->close())
+    Log(LOG_PLAIN)
+        << "Warning: Unable to write to lst file " + lstfn +
+               " - uninstall of this package will leave orphaned files."
+        << endLog;
+  delete lst;
   delete tarstream;
 
   total_bytes_sofar += package_bytes;
@@ -693,8 +738,11 @@ Installer::installOne (packagemeta &pkgm, const packageversion &ver,
   int df = diskfull(get_root_dir().c_str());
   g_Progress.SetBar3(df);
 
-  if (ver.Type() == package_binary && !error_in_this_package)
+  if (ver.Type() == package_binary && !error_in_this_package) {
     pkgm.installed = ver;
+    packagedb db;
+    db.journal(pkgm);
+  }
 }
 
 static void
@@ -775,14 +823,20 @@ static void do_install_thread(HINSTANCE h, HWND owner)
   /* Calculate the amount of data to md5sum */
   g_Progress.SetText1("Calculating...");
   long long int md5sum_total_bytes = 0;
+  std::vector<packagesource *> to_check;
   for (SolverTransactionList::const_iterator i = t.begin(); i != t.end(); ++i) {
     packageversion version = i->version;
 
     if (i->type == SolverTransaction::transInstall) {
       md5sum_total_bytes += version.source()->size;
+      to_check.push_back(version.source());
     }
   }
 
+  /* Hash as many packages at once as we have threads for.  Anything this
+     fails to validate is checked again, and reported, in the loop below. */
+  check_hashes(to_check);
+
   /* md5sum the packages, build lists of packages to install and uninstall
      and calculate the total amount of data to install.
      The hash checking is relevant only for local installs.  For a
@@ -828,6 +882,9 @@ static void do_install_thread(HINSTANCE h, HWND owner)
       g_Progress.SetBar2(md5sum_total_bytes_sofar, md5sum_total_bytes);
   }
 
+  if (!uninstall_q.empty() || !install_q.empty())
+    myInstaller.loadFiles();
+
   /* start with uninstalls - remove files that new packages may replace */
   g_Progress.SetBar2(0);
   for (std::vector<packageversion>::iterator i = uninstall_q.begin();
@@ -847,14 +904,28 @@ static void do_install_thread(HINSTANCE h, HWND owner)
                        uninstall_q.size());
   }
 
+  /* With more than one thread available, decompress packages further down
+     the queue while the current one is being written out.  Those too big
+     for that are decoded by installOne with all of the threads. */
+  std::vector<packagesource *> install_sources;
+  for (std::vector<packageversion>::iterator i = install_q.begin();
+       i != install_q.end(); ++i)
+    install_sources.push_back(i->source());
+  InstallPrefetcher *prefetcher = NULL;
+  if (ThreadPool::default_size() > 1 && install_q.size() > 1)
+    prefetcher = new InstallPrefetcher(install_sources);
+
   for (std::vector<packageversion>::iterator i = install_q.begin();
        i != install_q.end(); ++i) {
     packageversion &pkg = *i;
     packagemeta *pkgm = db.findBinary(PackageSpecification(i->Name()));
+    io_stream *prefetched = NULL;
+    if (prefetcher)
+      prefetched = prefetcher->take(std::distance(install_q.begin(), i));
 
     try {
       myInstaller.installOne(*pkgm, pkg, *pkg.source(), "cygfile://", "/",
-                             owner);
+                             owner, prefetched);
     } catch (std::exception *e) {
       if (yesno(owner, IDS_INSTALL_ERROR, e->what()) != IDYES) {
         Log(LOG_TIMESTAMP) << "User cancelled setup after install error"
@@ -865,6 +936,8 @@ static void do_install_thread(HINSTANCE h, HWND owner)
     }
   }
 
+  delete prefetcher;
+
   for (std::vector<packageversion>::iterator i = sourceinstall_q.begin();
        i != sourceinstall_q.end(); ++i) {
     packagemeta *pkgm = db.findSource(PackageSpecification(i->Name()));
@@ -881,6 +954,9 @@ static void do_install_thread(HINSTANCE h, HWND owner)
     if (!err) err = "(unknown error)";
     fatal(owner, IDS_ERR_OPEN_WRITE, "Package Database", err);
   }
+  if (!myInstaller.files.save())
+    Log(LOG_PLAIN) << "Warning: Unable to write the installed file index"
+                   << endLog;
 
   if (!myInstaller.errors) check_for_old_cygwin(owner);
   if (s_num_installs == 0 && s_num_uninstalls == 0) {
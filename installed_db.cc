@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+#include "installed_db.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "filemanip.h"
+
+bool
+InstalledDbReader::map (const std::string &path)
+{
+  bool mapped = buf.map (path);
+  start ();
+  return mapped;
+}
+
+bool
+InstalledDbReader::read (io_stream *in)
+{
+  bool ok = buf.read (in);
+  start ();
+  return ok;
+}
+
+void
+InstalledDbReader::start ()
+{
+  pos = buf.data ();
+  end = pos + buf.size ();
+  dbver = 0;
+}
+
+int
+InstalledDbReader::version ()
+{
+  if (dbver || pos >= end)
+    return dbver;
+
+  /* Look for header line (absent in version 1) */
+  char *p = pos;
+  while (p < end && (*p == ' ' || *p == '\t'))
+    p++;
+  if (end - p > 12 && !strncasecmp (p, "INSTALLED.DB", 12)
+      && isspace ((unsigned char) p[12]))
+    {
+      dbver = strtol (p + 12, NULL, 10);
+      char *eol = (char *) memchr (p, '\n', end - p);
+      pos = eol ? eol + 1 : end;
+    }
+  else
+    dbver = 1;
+  return dbver;
+}
+
+/* Split the next line into at most three fields, terminating them where
+   they lie; the number found, or -1 at the end. */
+int
+InstalledDbReader::fields (char *field[3])
+{
+  if (pos >= end)
+    return -1;
+  char *eol = (char *) memchr (pos, '\n', end - pos);
+  if (!eol)
+    eol = end;
+
+  int n = 0;
+  char *p = pos;
+  while (n < 3)
+    {
+      while (p < eol && isspace ((unsigned char) *p))
+	p++;
+      if (p == eol)
+	break;
+      field[n++] = p;
+      while (p < eol && !isspace ((unsigned char) *p))
+	p++;
+      /* at end, this is one of the buffer's two NULs */
+      *p = '\0';
+      if (p < eol)
+	p++;
+    }
+  pos = eol + 1;
+  return n;
+}
+
+bool
+InstalledDbReader::next (char *&pkgname, char *&inst, int &user_picked)
+{
+  char *field[3];
+  int n;
+  while ((n = fields (field)) >= 0)
+    {
+      if (n < 3)
+	continue;
+      char *e;
+      long flags = strtol (field[2], &e, 10);
+      if (e == field[2])
+	continue;
+      pkgname = field[0];
+      inst = field[1];
+      user_picked = flags;
+      return true;
+    }
+  return false;
+}
+
+static bool
+ends_with (const char *s, const char *e, const char *suffix)
+{
+  size_t n = strlen (suffix);
+  return (size_t) (e - s) >= n && !strncasecmp (e - n, suffix, n);
+}
+
+const char *
+InstalledDbReader::version (char *inst)
+{
+  /* as find_tar_ext () */
+  size_t len = strlen (inst);
+  if (len <= 9)
+    return NULL;
+  char *ext = strstr (inst + len - 9, ".tar");
+  if (!ext)
+    return NULL;
+
+  /* Setup never records source or patch archives; leave them, and
+     their special cases, to parse_filename (). */
+  if (ends_with (inst, ext, "-src") || ends_with (inst, ext, "-patch"))
+    {
+      fileparse f;
+      if (!parse_filename (inst, f))
+	return NULL;
+      slow_version = f.ver;
+      return slow_version.c_str ();
+    }
+
+  /* The version starts after the first hyphen followed by a digit */
+  *ext = '\0';
+  for (char *v = inst; *v; v++)
+    if (*v == '-' && isdigit ((unsigned char) v[1]))
+      return v + 1;
+  return "0.0";
+}
+
+std::string
+journal_record (const std::string &line)
+{
+  /* and the empty line between whole records is ignored as well */
+  return "\n" + line;
+}
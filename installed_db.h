@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+#ifndef SETUP_INSTALLED_DB_H
+#define SETUP_INSTALLED_DB_H
+
+#include <string>
+#include "IniBuffer.h"
+
+class io_stream;
+
+/* Reads an installed.db, or its journal, in a single pass over one
+   buffer, splitting its lines into fields where they lie.  The strings
+   handed out point into the buffer, and last as long as the reader. */
+class InstalledDbReader
+{
+public:
+  InstalledDbReader () : pos (NULL), end (NULL), dbver (0) {}
+  /* map the local file path; false if it cannot be mapped, in which case
+     it should be read () instead */
+  bool map (const std::string &path);
+  /* the whole of stream; false on a read error */
+  bool read (io_stream *);
+  /* The INSTALLED.DB version given in the header line, which is
+     consumed; 1 if there is none, 0 if the file is empty.  */
+  int version ();
+  /* The next line with at least three fields, as sscanf ("%s %s %d")
+     would have found them; false at the end. */
+  bool next (char *&pkgname, char *&inst, int &user_picked);
+  /* The version in inst, a package file name, as parse_filename ()
+     would have found it; NULL if inst is not the name of a tarball.
+     inst may be changed. */
+  const char *version (char *inst);
+
+private:
+  int fields (char *field[3]);
+  void start ();
+
+  IniBuffer buf;
+  char *pos;
+  char *end;
+  int dbver;
+  std::string slow_version;
+
+  InstalledDbReader (const InstalledDbReader &); // no copy cons
+  InstalledDbReader &operator= (const InstalledDbReader &); // no assignment
+};
+
+/* line, an installed.db line, as a record to append to the journal.  It
+   starts a new line, so that a record cut short by a crash ends there
+   and is ignored, instead of running into the next. */
+std::string journal_record (const std::string &line);
+
+#endif /* SETUP_INSTALLED_DB_H */
@@ -163,15 +163,21 @@ ssize_t io_stream::copy (io_stream * in, io_stream * out)
   ssize_t
     countin,
     countout;
-  while ((countin = in->read (buffer, sizeof(buffer))) > 0)
+  /* straight from in's buffer, if it will lend it */
+  bool lends = in->lends ();
+  const void *view = buffer;
+  while ((countin = lends ? in->read_view (&view, sizeof(buffer))
+			  : in->read (buffer, sizeof(buffer))) > 0)
     {
-      countout = out->write (buffer, countin);
+      countout = out->write (view, countin);
       if (countout != countin)
 	{
 	  Log (LOG_TIMESTAMP) << "io_stream::copy failed to write "
 	    << countin << " bytes" << endLog;
 	  return countout ? countout : -1;
 	}
+      if (lends)
+	in->consume (countin);
     }
 
   /*
@@ -203,6 +209,48 @@ io_stream::move (const std::string& from, const std::string& to)
   		      &to.c_str()[top->key.size()]);
 }
 
+ssize_t
+io_stream::skip (size_t len)
+{
+  char buffer[65536];
+  size_t done = 0;
+  while (done < len)
+    {
+      size_t want = len - done < sizeof (buffer) ? len - done : sizeof (buffer);
+      ssize_t got = read (buffer, want);
+      if (got < 0)
+	return -1;
+      if (got == 0)
+	break;
+      done += got;
+    }
+  return done;
+}
+
+int
+io_stream::preallocate (size_t len)
+{
+  return 1;
+}
+
+bool
+io_stream::lends ()
+{
+  return false;
+}
+
+ssize_t
+io_stream::read_view (const void **data, size_t len)
+{
+  *data = NULL;
+  return -1;
+}
+
+void
+io_stream::consume (size_t len)
+{
+}
+
 char * io_stream::gets (char *buffer, size_t length)
 {
   char *pos = buffer;
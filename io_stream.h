@@ -139,6 +139,25 @@ public:
   /* ever read the f* functions from libc ? */
   virtual long tell () = 0;
   virtual int seek (long, io_stream_seek_t) = 0;
+  /* discard the next len bytes, seeking past them where the stream can.
+   * Returns the number discarded, fewer only at the end, or -1 on error.
+   */
+  virtual ssize_t skip (size_t len);
+  /* a hint that len bytes are about to be written, so the space can be
+   * found for them in one go. 0 if taken, 1 if not, as by default.
+   */
+  virtual int preallocate (size_t len);
+  /* Zero-copy reading, for streams which read through a buffer of their
+   * own, and say so with lends ().  read_view points data at the next
+   * bytes in that buffer, at most len of them, and returns how many: 0 at
+   * the end, -1 on error.  They stay in the stream, and data stays good,
+   * until consume () is told how many were used; any other call on the
+   * stream may invalidate it.  A sink takes a view with write () as usual.
+   * Other streams are read with read () and lend nothing.
+   */
+  virtual bool lends ();
+  virtual ssize_t read_view (const void **data, size_t len);
+  virtual void consume (size_t len);
   /* try guessing this one */
   virtual int error () = 0;
   /* hmm, yet another for the guessing books */
@@ -13,19 +13,15 @@
  *
  */
 
-#include "win32.h"
-#include "mklink2.h"
-#include "filemanip.h"
-#include "mkdir.h"
-#include "mount.h"
-
 #include <stdlib.h>
 #include <errno.h>
-#include <unistd.h>
+#include <string.h>
 
 #include "io_stream_cygfile.h"
+#include "cygfile_fs.h"
 #include "IOStreamProvider.h"
 #include "LogSingleton.h"
+#include "String++.h"
 
 
 /* completely private iostream registration class */
@@ -65,6 +61,19 @@ private:
 };
 CygFileProvider CygFileProvider::theInstance = CygFileProvider();
 
+cygfile_fs *cygfile_fs::current = NULL;
+
+cygfile_fs *
+cygfile_fs::get ()
+{
+  return current;
+}
+
+void
+cygfile_fs::use (cygfile_fs *fs)
+{
+  current = fs;
+}
 
 std::string io_stream_cygfile::cwd("/");
   
@@ -108,27 +117,7 @@ io_stream_cygfile::normalise (const std::string& unixpath)
   return rv;
 }
 
-wchar_t *
-io_stream_cygfile::w_str ()
-{
-  if (!wname)
-    {
-      wname = new wchar_t [fname.size () + 7];
-      if (wname)
-	mklongpath (wname, fname.c_str (), fname.size () + 7);
-    }
-  return wname;
-}
-
-static void
-get_root_dir_now ()
-{
-  if (get_root_dir ().size())
-    return;
-  read_mounts (std::string ());
-}
-
-io_stream_cygfile::io_stream_cygfile (const std::string& name, const std::string& mode, mode_t perms) : fp(), lasterr (0), fname(), wname (NULL)
+io_stream_cygfile::io_stream_cygfile (const std::string& name, const std::string& mode, mode_t perms) : fp(), lasterr (0), fname()
 {
   errno = 0;
   if (!name.size())
@@ -137,24 +126,13 @@ io_stream_cygfile::io_stream_cygfile (const std::string& name, const std::string
     return;
   }
 
-  /* do this every time because the mount points may change due to fwd/back button use...
-   * TODO: make this less...manual
-   */
-  get_root_dir_now ();
-  if (!get_root_dir ().size())
-  {
-    /* TODO: assign a errno for "no mount table :} " */
-    Log (LOG_TIMESTAMP) << "io_stream_cygfile: Error reading mounts" << endLog;
-    return;
-  }
-
-  fname = cygpath (normalise(name));
+  fname = normalise(name);
   if (mode.size ())
     {
       if (fname.rfind (".exe") != std::string::npos
 	  || fname.rfind (".dll") != std::string::npos)
         perms |= 0111;	/* Make .exe and .dll always executable. */
-      fp = nt_wfopen (w_str(), mode.c_str (), perms);
+      fp = cygfile_fs::get ()->open (fname, mode.c_str (), perms);
       if (!fp)
       {
 	lasterr = errno;
@@ -168,22 +146,12 @@ io_stream_cygfile::~io_stream_cygfile ()
 {
   if (fp)
     fclose (fp);
-  if (wname)
-    delete [] wname;
 }
 
 /* Static members */
 int io_stream_cygfile::exists(const std::string& path) 
 {
-  get_root_dir_now();
-  if (!get_root_dir().size()) return 0;
-
-  size_t len = cygpath(normalise(path)).size() + 7;
-  WCHAR wname[len];
-  mklongpath(wname, cygpath(normalise(path)).c_str(), len);
-  DWORD attr = GetFileAttributesW(wname);
-  if (attr != INVALID_FILE_ATTRIBUTES) return 1;
-  return 0;
+  return cygfile_fs::get ()->exists (normalise(path));
 }
 
 int
@@ -191,33 +159,7 @@ io_stream_cygfile::remove (const std::string& path)
 {
   if (!path.size())
     return 1;
-  get_root_dir_now ();
-  if (!get_root_dir ().size())
-    /* TODO: assign a errno for "no mount table :} " */
-    return 1;
-
-  size_t len = cygpath (normalise(path)).size () + 7;
-  WCHAR wpath[len];
-  mklongpath (wpath, cygpath (normalise(path)).c_str (), len);
-
-  unsigned long w = GetFileAttributesW (wpath);
-  if (w != INVALID_FILE_ATTRIBUTES && w & FILE_ATTRIBUTE_DIRECTORY)
-    {
-      len = wcslen (wpath);
-      WCHAR tmp[len + 10];
-      wcscpy (tmp, wpath);
-      int i = 0;
-      do
-        {
-	  ++i;
-	  swprintf (tmp + len, L"old-%d", i);
-	}
-      while (GetFileAttributesW (tmp) != INVALID_FILE_ATTRIBUTES);
-      Log (LOG_TIMESTAMP) << "warning: moving directory \"" << normalise(path).c_str()
-                          << "\" out of the way." << endLog;
-      MoveFileW (wpath, tmp);
-    }
-  return io_stream::remove (std::string ("file://") + cygpath (normalise(path)).c_str());
+  return cygfile_fs::get ()->remove (normalise(path));
 }
 
 /* Returns 0 for success */
@@ -234,11 +176,11 @@ io_stream_cygfile::mklink (const std::string& _from, const std::string& _to,
     case IO_STREAM_SYMLINK:
       // symlinks are arbitrary targets, can be anything, and are
       // not subject to translation
-      return mkcygsymlink (cygpath (from).c_str(), _to.c_str());
+      return cygfile_fs::get ()->symlink (from, _to);
     case IO_STREAM_HARDLINK:
       {
 	/* First try to create a real hardlink. */
-	if (!mkcyghardlink (cygpath (from).c_str(), cygpath (to).c_str ()))
+	if (!cygfile_fs::get ()->hardlink (from, to))
 	  return 0;
 
 	/* If creating a hardlink failed, we're probably on a filesystem
@@ -334,6 +276,34 @@ io_stream_cygfile::seek (long where, io_stream_seek_t whence)
   return -1;
 }
 
+ssize_t
+io_stream_cygfile::skip (size_t len)
+{
+  /* below this, seeking costs more than reading through stdio's buffer */
+  if (!fp || len < 65536)
+    return io_stream::skip (len);
+  /* but go no further than the end, as reading would */
+  long here = ftell (fp);
+  if (here < 0 || fseek (fp, 0, SEEK_END))
+    return -1;
+  long end = ftell (fp);
+  if (end < here)
+    return -1;
+  if ((size_t) (end - here) < len)
+    len = end - here;
+  if (fseek (fp, here + (long) len, SEEK_SET))
+    return -1;
+  return len;
+}
+
+int
+io_stream_cygfile::preallocate (size_t len)
+{
+  if (!fp)
+    return 1;
+  return cygfile_fs::get ()->preallocate (fp, len);
+}
+
 int
 io_stream_cygfile::error ()
 {
@@ -348,11 +318,7 @@ cygmkdir_p (path_type_t isadir, const std::string& _name, mode_t mode)
   if (!_name.size())
     return 1;
   std::string name(io_stream_cygfile::normalise(_name));
-  get_root_dir_now ();
-  if (!get_root_dir ().size())
-    /* TODO: assign a errno for "no mount table :} " */
-    return 1;
-  return mkdir_p (isadir == PATH_TO_DIR ? 1 : 0, cygpath (name).c_str(), mode);
+  return cygfile_fs::get ()->mkdir_p (isadir, name, mode);
 }
 
 int
@@ -362,19 +328,8 @@ io_stream_cygfile::set_mtime (time_t mtime)
     return 1;
   if (fp)
     fclose (fp);
-  long long ftimev = mtime * NSPERSEC + FACTOR;
-  FILETIME ftime;
-  ftime.dwHighDateTime = ftimev >> 32;
-  ftime.dwLowDateTime = ftimev;
-  HANDLE h;
-  h = CreateFileW (w_str (), GENERIC_WRITE,
-		   FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING,
-		   FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS, 0);
-  if (h == INVALID_HANDLE_VALUE)
-    return 1;
-  SetFileTime (h, 0, 0, &ftime);
-  CloseHandle (h);
-  return 0;
+  fp = NULL;
+  return cygfile_fs::get ()->set_mtime (fname, mtime);
 }
 
 int
@@ -384,11 +339,7 @@ io_stream_cygfile::move (const std::string& _from, const std::string& _to)
     return 1;
   std::string from (normalise(_from));
   std::string to(normalise(_to));
-  get_root_dir_now ();
-  if (!get_root_dir ().size())
-    /* TODO: assign a errno for "no mount table :} " */
-    return 1;
-  return rename (cygpath (from).c_str(), cygpath (to).c_str());
+  return cygfile_fs::get ()->move (from, to);
 }
 
 size_t
@@ -396,15 +347,5 @@ io_stream_cygfile::get_size ()
 {
   if (!fname.size() )
     return 0;
-  HANDLE h;
-  DWORD ret = 0;
-  h = CreateFileW (w_str (), GENERIC_READ,
-		   FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING,
-		   FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS, 0);
-  if (h != INVALID_HANDLE_VALUE)
-    {
-      ret = GetFileSize (h, NULL);
-      CloseHandle (h);
-    }
-  return ret;
+  return cygfile_fs::get ()->get_size (fname);
 }
@@ -20,7 +20,8 @@
 
 
 /* io_stream on disk files using cygwin paths
- * and potentially understanding links in the future
+ * and potentially understanding links in the future.
+ * The disk is whichever cygfile_fs is in use.
  */
 
 extern int cygmkdir_p (path_type_t isadir, const std::string& path, mode_t mode);
@@ -41,6 +42,8 @@ public:
   virtual ssize_t peek (void *buffer, size_t len);
   virtual long tell ();
   virtual int seek (long where, io_stream_seek_t whence);
+  virtual ssize_t skip (size_t len);
+  virtual int preallocate (size_t len);
   /* can't guess, oh well */
   virtual int error ();
   virtual int set_mtime (time_t);
@@ -59,8 +62,6 @@ private:
   FILE *fp;
   int lasterr;
   std::string fname;
-  wchar_t *wname;
-  wchar_t *w_str ();
   static std::string cwd;
 };
 
@@ -204,6 +204,26 @@ io_stream_file::seek (long where, io_stream_seek_t whence)
   return -1;
 }
 
+ssize_t
+io_stream_file::skip (size_t len)
+{
+  /* below this, seeking costs more than reading through stdio's buffer */
+  if (!fp || len < 65536)
+    return io_stream::skip (len);
+  /* but go no further than the end, as reading would */
+  long here = ftell (fp);
+  if (here < 0 || fseek (fp, 0, SEEK_END))
+    return -1;
+  long end = ftell (fp);
+  if (end < here)
+    return -1;
+  if ((size_t) (end - here) < len)
+    len = end - here;
+  if (fseek (fp, here + (long) len, SEEK_SET))
+    return -1;
+  return len;
+}
+
 int
 io_stream_file::error ()
 {
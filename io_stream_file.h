@@ -38,6 +38,7 @@ public:
   virtual ssize_t peek (void *buffer, size_t len);
   virtual long tell ();
   virtual int seek (long where, io_stream_seek_t whence);
+  virtual ssize_t skip (size_t len);
   /* can't guess, oh well */
   virtual int error ();
   virtual int set_mtime (time_t);
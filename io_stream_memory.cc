@@ -22,18 +22,39 @@
 #include "io_stream.h"
 #include "io_stream_memory.h"
 
-/* memblock helper class */
-memblock::~memblock ()
+io_stream_memory::~io_stream_memory ()
 {
-  if (data)
-    delete[] data;
-  if (next)
-    delete next;
+  if (!borrowed)
+    free (buf);
 }
 
-io_stream_memory::~io_stream_memory ()
+bool
+io_stream_memory::reserve (size_t need)
 {
-  /* memblocks are self deleting. Nice of 'em eh what */
+  if (need <= cap && !borrowed)
+    return true;
+  size_t newcap = cap > 4096 ? cap : 4096;
+  while (newcap < need)
+    newcap *= 2;
+  char *p;
+  if (borrowed)
+    {
+      /* copy on write */
+      p = (char *) malloc (newcap);
+      if (p && length)
+	memcpy (p, buf, length);
+    }
+  else
+    p = (char *) realloc (buf, newcap);
+  if (!p)
+    {
+      lasterr = ENOMEM;
+      return false;
+    }
+  buf = p;
+  cap = newcap;
+  borrowed = false;
+  return true;
 }
 
 /* virtuals */
@@ -42,23 +63,9 @@ io_stream_memory::~io_stream_memory ()
 ssize_t
 io_stream_memory::read (void *buffer, size_t len)
 {
-  if (len == 0)
-    return 0;
-  unsigned char *to = (unsigned char *) buffer;
-  unsigned char *end = to + len;
-  ssize_t count = 0;
-  while (to < end && pos < length)
-    {
-      *to++ = pos_block->data[pos_block_offset++];
-      count++;
-      if (pos_block_offset == pos_block->len)
-	{
-	  pos_block = pos_block->next;
-	  pos_block_offset = 0;
-	}
-      pos++;
-    }
-  return count;
+  ssize_t got = peek (buffer, len);
+  pos += got;
+  return got;
 }
 
 ssize_t
@@ -66,35 +73,75 @@ io_stream_memory::write (const void *buffer, size_t len)
 {
   if (len == 0)
     return 0;
-  /* talk about primitive :} */
-  tail->next = new memblock (len);
-  if (!tail->next->data)
+  if (pos + len < pos || !reserve (pos + len))
     {
-      delete tail->next;
-      tail->next = 0;
       lasterr = ENOMEM;
       return -1;
     }
-  tail = tail->next;
-  memcpy (tail->data, buffer, len);
+  memcpy (buf + pos, buffer, len);
   pos += len;
-  pos_block = tail;
-  pos_block_offset = len;
-  length += len;
+  if (pos > length)
+    length = pos;
   return len;
 }
 
 ssize_t
 io_stream_memory::peek (void *buffer, size_t len)
 {
-  size_t tpos = pos;
-  size_t toff = pos_block_offset;
-  memblock *tblock = pos_block;
-  ssize_t tmp = read (buffer, len);
-  pos = tpos;
-  pos_block_offset = toff;
-  pos_block = tblock;
-  return tmp;
+  if (len > length - pos)
+    len = length - pos;
+  if (len)
+    memcpy (buffer, buf + pos, len);
+  return len;
+}
+
+int
+io_stream_memory::seek (long where, io_stream_seek_t whence)
+{
+  long base = whence == IO_SEEK_SET ? 0
+	      : whence == IO_SEEK_CUR ? (long) pos : (long) length;
+  if (base + where < 0 || (size_t) (base + where) > length)
+    {
+      lasterr = EINVAL;
+      return -1;
+    }
+  pos = base + where;
+  return 0;
+}
+
+ssize_t
+io_stream_memory::skip (size_t len)
+{
+  if (len > length - pos)
+    len = length - pos;
+  pos += len;
+  return len;
+}
+
+ssize_t
+io_stream_memory::read_view (const void **data, size_t len)
+{
+  if (len > length - pos)
+    len = length - pos;
+  *data = len ? buf + pos : NULL;
+  return len;
+}
+
+char *
+io_stream_memory::release_buffer (size_t &size, size_t spare)
+{
+  /* something to hand over, even if empty */
+  size_t need = length + spare ? length + spare : 1;
+  if (!reserve (need))
+    return NULL;
+  /* hand back the slack */
+  char *p = cap > need ? (char *) realloc (buf, need) : NULL;
+  if (!p)
+    p = buf;
+  size = length;
+  buf = NULL;
+  length = cap = pos = 0;
+  return p;
 }
 
 int
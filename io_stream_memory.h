@@ -20,26 +20,19 @@
 #include <errno.h>
 
 /* this is a stream class that simply abstracts the issue of maintaining
- * amemory buffer.
- * It's not as efficient as if can be, but that can be fixed without affecting 
- * the API. 
+ * a memory buffer.
+ * The contents are kept in one contiguous, malloc ()ed buffer, which
+ * grows geometrically, so seeking is immediate and they can be lent out
+ * whole.  A stream can also be made over a buffer belonging to someone
+ * else, which is not copied unless the stream is written to.
  */
 
-class memblock
-{
-public:
-  memblock () : next (0), len (0), data (0) {};
-  memblock (size_t size) : next (0), len (size) {data = new unsigned char[size]; if (!data) len = 0;};
-  ~memblock ();
-  memblock *next;
-  size_t len;
-  unsigned char *data;
-};
-
 class io_stream_memory :public io_stream
 {
 public:
-  io_stream_memory () : lasterr (0), mtime(0),length (0), head(), tail (&head), pos_block (head.next), pos_block_offset (0), pos (0) {};
+  io_stream_memory () : lasterr (0), mtime (0), buf (NULL), length (0), cap (0), pos (0), borrowed (false) {};
+  /* a stream over the len bytes at data, which must outlive it */
+  io_stream_memory (const void *data, size_t len) : lasterr (0), mtime (0), buf ((char *) data), length (len), cap (len), pos (0), borrowed (true) {};
   /* set the modification time of a file - returns 1 on failure
    * may distrupt internal state - use after all important io is complete
    */
@@ -58,22 +51,37 @@ public:
   virtual ssize_t peek (void *buffer, size_t len);
   /* ever read the f* functions from libc ? */
   virtual long tell () {return pos;};
-  virtual int seek (long where, io_stream_seek_t whence) { if (whence != IO_SEEK_SET) { lasterr = EINVAL; return -1;} ssize_t count=0; pos = 0; pos_block = head.next; pos_block_offset = 0; while (count < where && pos < length) {pos_block_offset++; if (pos_block_offset == pos_block->len) {pos_block = pos_block->next; pos_block_offset = 0;}pos++;count++;}return 0;};
-    
+  virtual int seek (long where, io_stream_seek_t whence);
+  virtual ssize_t skip (size_t len);
+  virtual int preallocate (size_t len) {return !reserve (pos + len);};
+  /* lends the whole of the rest */
+  virtual bool lends () {return true;};
+  virtual ssize_t read_view (const void **data, size_t len);
+  virtual void consume (size_t len) {skip (len);};
+
   /* try guessing this one */
   virtual int error ();
+  /* the contents, all get_size () bytes of them */
+  const char *data () const {return buf;};
+  /* Hand the contents over to the caller, to be free ()d, leaving the
+   * stream empty; size is set to their length, and there are spare more
+   * bytes allocated after them.  NULL on failure.
+   */
+  char *release_buffer (size_t &size, size_t spare = 0);
 //  virtual const char* next_file_name() = NULL;
   /* if you are still needing these hints... give up now! */
   virtual ~ io_stream_memory ();
 private:
   int lasterr;
   time_t mtime;
+  char *buf;
   size_t length;
-  memblock head;
-  memblock *tail;
-  memblock *pos_block;
-  size_t pos_block_offset;
+  size_t cap;
   size_t pos;
+  /* buf belongs to someone else */
+  bool borrowed;
+  /* make room for at least need bytes, in a buffer of our own */
+  bool reserve (size_t need);
 };
 
 #endif /* SETUP_IO_STREAM_MEMORY_H */
@@ -0,0 +1,267 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+#include "io_stream_readahead.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+size_t io_stream_readahead::default_buffer_size = 1024 * 1024;
+unsigned int io_stream_readahead::default_buffers = 4;
+
+io_stream_readahead::io_stream_readahead (io_stream *parent,
+					  size_t buffer_size,
+					  unsigned int buffers,
+					  io_stream *source)
+  : parent (parent), source (source), mtime (parent->get_mtime ()), mode (parent->get_mode ()),
+    buffer_size (buffer_size ? buffer_size : default_buffer_size),
+    ring (buffers ? buffers : default_buffers), thread (NULL), head (0),
+    filled (0), finished (false), reader_err (0), stopping (false),
+    have_head (false), pos (0), position (0),
+    source_done (source ? source->tell () : 0), lasterr (0)
+{
+  InitializeCriticalSection (&lock);
+  InitializeConditionVariable (&filled_one);
+  InitializeConditionVariable (&emptied_one);
+
+  for (std::vector<chunk>::iterator i = ring.begin (); i != ring.end (); ++i)
+    {
+      i->len = 0;
+      i->source_pos = source_done;
+      i->data = (char *) malloc (this->buffer_size);
+      if (!i->data)
+	{
+	  finished = true;
+	  reader_err = ENOMEM;
+	}
+    }
+  if (finished)
+    return;
+
+  /* If no thread can be started, the buffers are filled as they are
+     needed instead. */
+  DWORD threadID;
+  thread = CreateThread (NULL, 0, reader_reflector, this, 0, &threadID);
+}
+
+io_stream_readahead::~io_stream_readahead ()
+{
+  EnterCriticalSection (&lock);
+  stopping = true;
+  WakeConditionVariable (&emptied_one);
+  LeaveCriticalSection (&lock);
+  if (thread)
+    {
+      WaitForSingleObject (thread, INFINITE);
+      CloseHandle (thread);
+    }
+
+  for (std::vector<chunk>::iterator i = ring.begin (); i != ring.end (); ++i)
+    free (i->data);
+  delete parent;
+  DeleteCriticalSection (&lock);
+}
+
+DWORD WINAPI
+io_stream_readahead::reader_reflector (void *p)
+{
+  ((io_stream_readahead *) p)->reader ();
+  return 0;
+}
+
+void
+io_stream_readahead::reader ()
+{
+  while (fill ())
+    ;
+}
+
+/* Fill the next free buffer from parent, waiting for one if need be;
+   false once parent is used up, or the stream is going away. */
+bool
+io_stream_readahead::fill ()
+{
+  EnterCriticalSection (&lock);
+  while (filled == ring.size () && !stopping)
+    SleepConditionVariableCS (&emptied_one, &lock, INFINITE);
+  chunk &c = ring[(head + filled) % ring.size ()];
+  bool stop = stopping;
+  LeaveCriticalSection (&lock);
+  if (stop)
+    return false;
+
+  size_t len = 0;
+  ssize_t got = 1;
+  while (len < buffer_size
+	 && (got = parent->read (c.data + len, buffer_size - len)) > 0)
+    len += got;
+
+  long source_pos = source ? source->tell () : 0;
+
+  EnterCriticalSection (&lock);
+  c.len = len;
+  c.source_pos = source_pos;
+  filled++;
+  if (got < 0)
+    reader_err = parent->error () ? parent->error () : EIO;
+  if (got <= 0)
+    finished = true;
+  WakeConditionVariable (&filled_one);
+  LeaveCriticalSection (&lock);
+  return got > 0;
+}
+
+/* Wait until more than n buffers are full; false if they never will be */
+bool
+io_stream_readahead::wait_for (size_t n)
+{
+  if (!thread)
+    while (filled <= n && !finished)
+      fill ();
+
+  EnterCriticalSection (&lock);
+  while (filled <= n && !finished)
+    SleepConditionVariableCS (&filled_one, &lock, INFINITE);
+  bool ready = filled > n;
+  LeaveCriticalSection (&lock);
+  return ready;
+}
+
+/* The buffer being read, with something left in it, after handing back
+   any used up; NULL at the end, or on an error. */
+io_stream_readahead::chunk *
+io_stream_readahead::current ()
+{
+  while (1)
+    {
+      if (have_head)
+	{
+	  chunk &c = ring[head];
+	  if (pos < c.len)
+	    return &c;
+
+	  source_done = c.source_pos;
+	  EnterCriticalSection (&lock);
+	  head = (head + 1) % ring.size ();
+	  filled--;
+	  WakeConditionVariable (&emptied_one);
+	  LeaveCriticalSection (&lock);
+	  have_head = false;
+	  pos = 0;
+	}
+      if (!wait_for (0))
+	{
+	  lasterr = reader_err;
+	  return NULL;
+	}
+      have_head = true;
+    }
+}
+
+ssize_t
+io_stream_readahead::read (void *buffer, size_t len)
+{
+  size_t done = 0;
+  chunk *c;
+  while (done < len && (c = current ()))
+    {
+      size_t n = std::min (len - done, c->len - pos);
+      memcpy ((char *) buffer + done, c->data + pos, n);
+      done += n;
+      pos += n;
+    }
+  position += done;
+  if (!done && lasterr)
+    return -1;
+  return done;
+}
+
+ssize_t
+io_stream_readahead::write (const void *buffer, size_t len)
+{
+  throw new std::logic_error ("io_stream_readahead::write is not implemented");
+}
+
+ssize_t
+io_stream_readahead::peek (void *buffer, size_t len)
+{
+  if (!current ())
+    return lasterr ? -1 : 0;
+  size_t done = 0;
+  size_t from = pos;
+  for (size_t k = 0; done < len && k < ring.size (); k++)
+    {
+      if (k && !wait_for (k))
+	break;
+      chunk &c = ring[(head + k) % ring.size ()];
+      size_t n = std::min (len - done, c.len - from);
+      memcpy ((char *) buffer + done, c.data + from, n);
+      done += n;
+      from = 0;
+    }
+  return done;
+}
+
+int
+io_stream_readahead::seek (long where, io_stream_seek_t whence)
+{
+  throw new std::logic_error ("io_stream_readahead::seek is not implemented");
+}
+
+ssize_t
+io_stream_readahead::skip (size_t len)
+{
+  size_t done = 0;
+  chunk *c;
+  while (done < len && (c = current ()))
+    {
+      size_t n = std::min (len - done, c->len - pos);
+      done += n;
+      pos += n;
+    }
+  position += done;
+  if (done < len && lasterr)
+    return -1;
+  return done;
+}
+
+ssize_t
+io_stream_readahead::read_view (const void **data, size_t len)
+{
+  chunk *c = current ();
+  if (!c)
+    return lasterr ? -1 : 0;
+  *data = c->data + pos;
+  return std::min (len, c->len - pos);
+}
+
+void
+io_stream_readahead::consume (size_t len)
+{
+  pos += len;
+  position += len;
+}
+
+long
+io_stream_readahead::source_tell ()
+{
+  if (!have_head || !ring[head].len)
+    return source_done;
+  chunk &c = ring[head];
+  return source_done
+    + (long) ((long long) (c.source_pos - source_done) * pos / c.len);
+}
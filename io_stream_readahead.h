@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+#ifndef SETUP_IO_STREAM_READAHEAD_H
+#define SETUP_IO_STREAM_READAHEAD_H
+
+/* A stream which reads another ahead on a thread of its own, into a ring
+ * of buffers, so that whatever produces the data (a decompressor, say)
+ * runs while whatever reads it (extracting files, say) waits on the disk.
+ * When every buffer is full the thread waits for one to be read, so no
+ * more than buffers * buffer_size bytes are ever held.
+ * The stream read from belongs to the read-ahead stream, and must not be
+ * used by anyone else while it lives.
+ */
+
+#include "io_stream.h"
+#include "win32.h"
+#include <vector>
+
+class io_stream_readahead :public io_stream
+{
+public:
+  /* 0 for either means the default below.  source, if given, is what
+     parent reads from in turn (a compressed file, say), whose position is
+     noted by the reader thread as each buffer is filled, for source_tell */
+  io_stream_readahead (io_stream *parent, size_t buffer_size = 0,
+		       unsigned int buffers = 0, io_stream *source = NULL);
+  virtual ~io_stream_readahead ();
+  /* The size and number of buffers a stream has unless told otherwise */
+  static size_t default_buffer_size;
+  static unsigned int default_buffers;
+
+  /* as the stream read from was when this one was made */
+  virtual int set_mtime (time_t) {return 1;};
+  virtual time_t get_mtime () {return mtime;};
+  virtual mode_t get_mode () {return mode;};
+  virtual size_t get_size () {return 0;};
+  virtual ssize_t read (void *buffer, size_t len);
+  virtual ssize_t write (const void *buffer, size_t len); /* not implemented */
+  /* may return less than len if it spans every buffer */
+  virtual ssize_t peek (void *buffer, size_t len);
+  virtual long tell () {return position;};
+  virtual int seek (long where, io_stream_seek_t whence); /* not implemented */
+  virtual ssize_t skip (size_t len);
+  /* lends a buffer at a time */
+  virtual bool lends () {return true;};
+  virtual ssize_t read_view (const void **data, size_t len);
+  virtual void consume (size_t len);
+  virtual int error () {return lasterr;};
+  /* About where in source what has been read so far came from: between
+     its positions after the buffer being read and the one before it were
+     filled, as far as that buffer has been read.  0 without a source. */
+  long source_tell ();
+
+private:
+  struct chunk
+  {
+    char *data;
+    size_t len;
+    /* source's position once it was filled */
+    long source_pos;
+  };
+  static DWORD WINAPI reader_reflector (void *);
+  void reader ();
+  bool fill ();
+  bool wait_for (size_t n);
+  chunk *current ();
+
+  io_stream *parent;
+  io_stream *source;
+  time_t mtime;
+  mode_t mode;
+  size_t buffer_size;
+  std::vector<chunk> ring;
+  HANDLE thread;
+
+  /* shared with the reader thread */
+  CRITICAL_SECTION lock;
+  CONDITION_VARIABLE filled_one;
+  CONDITION_VARIABLE emptied_one;
+  size_t head; /* the buffer being read from */
+  size_t filled; /* buffers full, from head on */
+  bool finished; /* the reader has filled its last buffer */
+  int reader_err;
+  bool stopping;
+
+  /* the reading side's alone */
+  bool have_head;
+  size_t pos; /* in ring[head] */
+  long position;
+  long source_done; /* source's position after the last buffer read */
+  int lasterr;
+
+  io_stream_readahead (const io_stream_readahead &); // no copy cons
+  io_stream_readahead &operator= (const io_stream_readahead &); // no assignment
+};
+
+#endif /* SETUP_IO_STREAM_READAHEAD_H */
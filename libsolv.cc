@@ -467,6 +467,12 @@ SolverPool::makedeps(Repo *repo, PackageDepends *requires)
   return deps;
 }
 
+Id
+SolverPool::intern(const std::string &name, bool create) const
+{
+  return pool_str2id(pool, name.c_str(), create);
+}
+
 SolvableVersion
 SolverPool::addPackage(const std::string& pkgname, const addPackageData &pkgdata)
 {
@@ -165,6 +165,8 @@ public:
 
   void internalize(void);
   void use_test_packages(bool use_test_packages);
+  // the pool's handle for a name, interning it if create; 0 if unknown
+  Id intern(const std::string &name, bool create = true) const;
   bool is_test_package(SolvableVersion id);
 
 private:
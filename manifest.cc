@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+#include "manifest.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <zstd.h>
+#include <set>
+
+#include "io_stream.h"
+#include "compress_gz.h"
+#include "cygfile_fs.h"
+#include "path_max.h"
+#include "LogSingleton.h"
+
+#include "getopt++/StringOption.h"
+
+static StringOption ManifestCompressionOption ("", '\0', "manifest-compression",
+					       "Compression of package file "
+					       "lists: gzip[:LEVEL] or "
+					       "zstd[:LEVEL] (default: gzip:1)",
+					       false);
+
+void
+ManifestWriter::configured (method &how, int &level)
+{
+  static bool warned;
+  std::string s = ManifestCompressionOption;
+  how = gzip;
+  level = 1;
+  if (s.empty ())
+    return;
+
+  /* the level, if given, or -1; -2 if it is not a number */
+  std::string name = s.substr (0, s.find (':'));
+  int given = -1;
+  if (name.size () < s.size ())
+    {
+      const char *l = s.c_str () + name.size () + 1;
+      char *e;
+      given = strtol (l, &e, 10);
+      if (e == l || *e || given < 0)
+	given = -2;
+    }
+
+  if (name == "gzip" && given >= -1 && given <= 9)
+    level = given >= 0 ? given : 1;
+  else if (name == "zstd" && given >= -1 && given <= ZSTD_maxCLevel ())
+    {
+      how = zstd;
+      level = given >= 1 ? given : 3;
+    }
+  else if (!warned)
+    {
+      Log (LOG_PLAIN) << "Unknown --manifest-compression " << s
+		      << ", using gzip:1" << endLog;
+      warned = true;
+    }
+}
+
+ManifestWriter::ManifestWriter (io_stream *out, method how, int level)
+  : out (out), owns_original (true), how (how), level (level)
+{
+}
+
+ManifestWriter::~ManifestWriter ()
+{
+  if (out)
+    close ();
+}
+
+void
+ManifestWriter::add (const std::string &filename)
+{
+  lines += filename;
+  lines += '\n';
+}
+
+bool
+ManifestWriter::close ()
+{
+  if (!out)
+    return false;
+  bool ok;
+  if (how == zstd)
+    {
+      std::string packed (ZSTD_compressBound (lines.size ()), '\0');
+      size_t n = ZSTD_compress (&packed[0], packed.size (), lines.data (),
+				lines.size (), level);
+      ok = !ZSTD_isError (n) && out->write (packed.data (), n) == (ssize_t) n;
+      if (owns_original)
+	delete out;
+    }
+  else
+    {
+      char mode[4] = { 'w', (char) ('0' + level), '\0' };
+      compress_gz *gz = new compress_gz (out, mode);
+      if (!owns_original)
+	gz->release_original ();
+      ok = !gz->error ()
+	&& gz->write (lines.data (), lines.size ()) == (ssize_t) lines.size ();
+      /* the trailer is written as it is deleted */
+      delete gz;
+    }
+  out = NULL;
+  lines.clear ();
+  return ok;
+}
+
+void
+ManifestWriter::release_original ()
+{
+  owns_original = false;
+}
+
+void
+remove_listed_files (io_stream *list, cygfile_fs *fs,
+		     const std::function<bool (const std::string &)> &keep)
+{
+  std::set<std::string> dirs;
+  char buf[CYG_PATH_MAX];
+  const char *sz;
+  while (list && (sz = list->gets (buf, sizeof buf)))
+    {
+      std::string line (sz);
+
+      /* Insert the paths of all parent directories of line into dirs.  If
+	 one was already there, all its parents must be too, so stop. */
+      size_t idx = line.length ();
+      while ((idx = line.find_last_of ('/', idx - 1)) != std::string::npos)
+	if (!dirs.insert (line.substr (0, idx)).second)
+	  break;
+
+      if (keep (line))
+	continue;
+
+      std::string d = "/" + line;
+      if (!fs->unlink (d))
+	Log (LOG_BABBLE) << "unlink " << fs->native (d) << endLog;
+      /* Check for Windows shortcut of same name. */
+      d += ".lnk";
+      if (!fs->unlink (d))
+	Log (LOG_BABBLE) << "unlink " << fs->native (d) << endLog;
+    }
+
+  /* An STL set maintains itself in sorted order, so going through it in
+     reverse removes directories depth-first. */
+  for (std::set<std::string>::reverse_iterator i = dirs.rbegin ();
+       i != dirs.rend (); ++i)
+    {
+      std::string d = "/" + *i;
+      if (!fs->rmdir (d))
+	Log (LOG_BABBLE) << "rmdir " << fs->native (d) << endLog;
+    }
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+#ifndef SETUP_MANIFEST_H
+#define SETUP_MANIFEST_H
+
+#include <functional>
+#include <string>
+
+class io_stream;
+class cygfile_fs;
+
+/* Writes the list of files in a package, /etc/setup/<package>.lst.gz.
+   The lines are kept in memory, and compressed and written in one go by
+   close (), as set by --manifest-compression.
+
+   Whatever the compression, the file is read back with
+   compress::decompress (), which recognises it by its magic.  Other
+   tools (cygcheck) only read gzip, which is the default. */
+class ManifestWriter
+{
+public:
+  enum method
+  {
+    gzip,
+    zstd
+  };
+
+  /* the manifest will be written to out, which is deleted by close () */
+  ManifestWriter (io_stream *out, method how = gzip, int level = 1);
+  /* closes, if close () has not been called */
+  ~ManifestWriter ();
+
+  void add (const std::string &filename);
+  /* Compress the list, write it out and close the stream; false on any
+     error, in which case the manifest is incomplete. */
+  bool close ();
+  void release_original (); /* give up ownership of the io_stream */
+
+  /* the method and level given by --manifest-compression */
+  static void configured (method &how, int &level);
+
+private:
+  io_stream *out;
+  bool owns_original;
+  method how;
+  int level;
+  std::string lines;
+
+  ManifestWriter (const ManifestWriter &); // no copy cons
+  ManifestWriter &operator= (const ManifestWriter &); // no assignment
+};
+
+/* Remove from fs the files a package's manifest lists, read from list,
+   which may be NULL, except those keep () is true of.  Then remove each
+   directory they are in, deepest first, which that has left empty.
+   This is all of uninstalling a package that touches the Cygwin tree. */
+void remove_listed_files (io_stream *list, cygfile_fs *fs,
+			  const std::function<bool (const std::string &)>
+			  &keep);
+
+#endif /* SETUP_MANIFEST_H */
@@ -57,7 +57,8 @@ NetIO::read (char *buf, int nbytes)
 }
 
 NetIO *
-NetIO::open (char const *url, bool cachable)
+NetIO::open (char const *url, bool cachable, long long range_offset,
+	     long long range_length)
 {
   NetIO *rv = 0;
   std::string file_url;
@@ -96,7 +97,11 @@ NetIO::open (char const *url, bool cachable)
       url = file_url.c_str();
     }
 
-  rv = new NetIO_IE5 (url, proto == file ? false : cachable);
+  if (proto == file)
+    range_offset = range_length = 0;
+
+  rv = new NetIO_IE5 (url, proto == file ? false : cachable,
+		      range_offset, range_length);
 
   if (rv && !rv->ok ())
     {
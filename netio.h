@@ -35,15 +35,24 @@ protected:
 public:
   /* if nonzero, this is the estimated total file size */
   int file_size;
+  /* the position in the file of the first byte read() returns.  This is
+     only nonzero if a range was asked for and the server honoured it. */
+  long long offset;
 
-  NetIO () : file_size(0) {};
+  NetIO () : file_size(0), offset(0) {};
   virtual ~ NetIO () {};
 
   /* The user calls this function to create a suitable accessor for
      the given URL.  It uses the network setup state in state.h.  If
      anything fails, either the return values is NULL or the returned
-     object is !ok() */
-  static NetIO *open (char const *url, bool cachable);
+     object is !ok().
+
+     If range_offset is nonzero, only ask for the file from that byte on,
+     and if range_length is nonzero, only for that many bytes.  Ranges are
+     only supported over HTTP(S), and servers may ignore them, so check
+     offset in the result. */
+  static NetIO *open (char const *url, bool cachable,
+		      long long range_offset = 0, long long range_length = 0);
 
   /* If !ok() that means the transfer isn't happening. */
   virtual int ok ();
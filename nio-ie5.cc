@@ -28,6 +28,7 @@
 #include "nio-ie5.h"
 #include "LogSingleton.h"
 #include "setup_version.h"
+#include "threadpool.h"
 #include "getopt++/StringOption.h"
 #include <sstream>
 
@@ -128,11 +129,23 @@ DWORD Proxy::type (void) const
 
 static HINTERNET internet = 0;
 static Proxy last_proxy = Proxy(-1, "", -1);
-
-NetIO_IE5::NetIO_IE5 (char const *url, bool cachable)
+/* Guards the above, and the credential prompts, since downloads may be
+   started from several threads at once. */
+static CriticalSection session_lock;
+/* Bumped whenever the user is asked for credentials, so a worker turned
+   away with ones which another has since replaced just tries again with
+   the new ones, rather than asking once more.  Guarded by session_lock. */
+static int auth_generation = 0;
+static int proxy_auth_generation = 0;
+
+NetIO_IE5::NetIO_IE5 (char const *url, bool cachable, long long range_offset,
+		      long long range_length)
 {
   int resend = 0;
+  /* the generation of the credentials last sent, or -1 for none */
+  int auth_sent = -1, proxy_auth_sent = -1;
 
+  session_lock.enter ();
   Proxy proxy = Proxy(net_method, net_proxy_host, net_proxy_port);
   if (proxy != last_proxy)
     {
@@ -164,6 +177,7 @@ NetIO_IE5::NetIO_IE5 (char const *url, bool cachable)
 
       internet = InternetOpen (lpszAgent, proxy.type(), proxy.string(), NULL, 0);
     }
+  session_lock.leave ();
 
   DWORD flags =
     INTERNET_FLAG_KEEP_CONNECTION |
@@ -175,16 +189,34 @@ NetIO_IE5::NetIO_IE5 (char const *url, bool cachable)
     flags |= INTERNET_FLAG_RESYNCHRONIZE;
   }
 
-  connection = InternetOpenUrl (internet, url, NULL, 0, flags, 0);
+  /* Ranges are never cached, and only make sense for HTTP. */
+  std::string headers;
+  if ((range_offset || range_length) && strncmp (url, "http", 4) == 0)
+    {
+      std::ostringstream range;
+      range << "Range: bytes=" << range_offset << "-";
+      if (range_length)
+	range << range_offset + range_length - 1;
+      range << "\r\n";
+      headers = range.str ();
+      flags |= INTERNET_FLAG_NO_CACHE_WRITE | INTERNET_FLAG_RELOAD;
+    }
+
+  connection = InternetOpenUrl (internet, url,
+				headers.empty () ? NULL : headers.c_str (),
+				headers.empty () ? 0 : (DWORD) -1L, flags, 0);
 
 try_again:
 
+  session_lock.enter ();
   if (net_user && net_passwd)
     {
       InternetSetOption (connection, INTERNET_OPTION_USERNAME,
 			 net_user, strlen (net_user));
       InternetSetOption (connection, INTERNET_OPTION_PASSWORD,
 			 net_passwd, strlen (net_passwd));
+      if (resend)
+	auth_sent = auth_generation;
     }
 
   if (net_proxy_user && net_proxy_passwd)
@@ -193,7 +225,10 @@ try_again:
 			 net_proxy_user, strlen (net_proxy_user));
       InternetSetOption (connection, INTERNET_OPTION_PROXY_PASSWORD,
 			 net_proxy_passwd, strlen (net_proxy_passwd));
+      if (resend)
+	proxy_auth_sent = proxy_auth_generation;
     }
+  session_lock.leave ();
 
   if (resend)
     if (!HttpSendRequest (connection, 0, 0, 0, 0))
@@ -238,20 +273,37 @@ try_again:
 			 HTTP_QUERY_STATUS_CODE | HTTP_QUERY_FLAG_NUMBER,
 			 &type, &type_s, NULL))
 	{
-	  if (type != 200)
+	  if (type != 200 && !(type == 206 && !headers.empty ()))
 	    Log (LOG_PLAIN) << "HTTP status " << type << " fetching " << url << endLog;
 
+	  if (type == 206 && !headers.empty ())	/* partial content */
+	    offset = range_offset;
+
 	  if (type == 401)	/* authorization required */
 	    {
 	      flush_io ();
-	      get_auth (NULL);
+	      /* only ask if nobody has since the credentials were sent */
+	      session_lock.enter ();
+	      if (auth_sent == auth_generation || !net_user || !net_passwd)
+		{
+		  get_auth (NULL);
+		  auth_generation++;
+		}
+	      session_lock.leave ();
 	      resend = 1;
 	      goto try_again;
 	    }
 	  else if (type == 407)	/* proxy authorization required */
 	    {
 	      flush_io ();
-	      get_proxy_auth (NULL);
+	      session_lock.enter ();
+	      if (proxy_auth_sent == proxy_auth_generation
+		  || !net_proxy_user || !net_proxy_passwd)
+		{
+		  get_proxy_auth (NULL);
+		  proxy_auth_generation++;
+		}
+	      session_lock.leave ();
 	      resend = 1;
 	      goto try_again;
 	    }
@@ -22,7 +22,8 @@ class NetIO_IE5:public NetIO
 {
   HINTERNET connection;
 public:
-  NetIO_IE5 (char const *url, bool cacheable);
+  NetIO_IE5 (char const *url, bool cacheable, long long range_offset = 0,
+	     long long range_length = 0);
   ~NetIO_IE5 ();
   virtual int ok ();
   virtual int read (char *buf, int nbytes);
@@ -32,6 +32,8 @@
 #include "compress.h"
 
 #include "filemanip.h"
+#include "installed_db.h"
+#include "mount.h"
 #include "package_version.h"
 #include "package_db.h"
 #include "package_meta.h"
@@ -58,6 +60,8 @@ packagedb::init ()
 
   packages.clear();
   sourcePackages.clear();
+  packagesById.clear();
+  sourcePackagesById.clear();
   categories.clear();
   solver.clear();
   solution.clear();
@@ -65,142 +69,176 @@ packagedb::init ()
   dependencyOrderedPackages.clear();
 }
 
+#define INSTALLED_DB "cygfile:///etc/setup/installed.db"
+#define INSTALLED_DB_NEW "cygfile:///etc/setup/installed.db.new"
+#define INSTALLED_DB_JOURNAL "cygfile:///etc/setup/installed.db.journal"
+
+/* The journal is written out in full into installed.db after this many
+   records. */
+#define JOURNAL_COMPACT_RECORDS 256
+
 void
 packagedb::read ()
 {
   if (!installeddbread)
     {
-      /* Read in the local installation database. */
-      io_stream *db = 0;
-      db = io_stream::open ("cygfile:///etc/setup/installed.db", "rt", 0);
+      /* Read in the local installation database, and then the journal of
+	 changes made since it was last written out, which supersede it. */
       installeddbread = 1;
-      if (!db)
-	return;
-      char line[1000], pkgname[1000];
-
-      if (db->gets (line, 1000))
+      journal_type journal;
+      readJournal (journal);
+      InstalledDbReader db;
+      if (!db.map (cygpath ("/etc/setup/installed.db")))
 	{
-	  /* Look for header line (absent in version 1) */
-	  int instsz;
-	  int dbver;
-	  sscanf (line, "%s %d", pkgname, &instsz);
-	  if (!strcasecmp (pkgname, "INSTALLED.DB"))
-	    dbver = instsz;
-	  else
-	    dbver = 1;
-	  delete db;
-	  db = 0;
+	  io_stream *f = io_stream::open (INSTALLED_DB, "rb", 0);
+	  if (!f && journal.empty ())
+	    return;
+	  if (f)
+	    db.read (f);
+	  delete f;
+	}
 
+      int dbver = db.version ();
+      if (dbver)
+	{
 	  Log (LOG_BABBLE) << "INSTALLED.DB version " << dbver << endLog;
 
-	  if (dbver <= 3)
-	    {
-	      char inst[1000];
-
-	      db =
-		io_stream::open ("cygfile:///etc/setup/installed.db", "rt", 0);
-
-	      // skip over already-parsed header line
-	      if (dbver >= 2)
-		db->gets (line, 1000);
-
-	      while (db->gets (line, 1000))
-		{
-		  int parseable;
-		  int user_picked = 0;
-		  pkgname[0] = '\0';
-		  inst[0] = '\0';
-
-		  int res = sscanf (line, "%s %s %d", pkgname, inst, &user_picked);
-
-		  if (res < 3 || pkgname[0] == '\0' || inst[0] == '\0')
-			continue;
-
-		  fileparse f;
-		  parseable = parse_filename (inst, f);
-		  if (!parseable)
-		    continue;
-
-                  SolverPool::addPackageData data;
-                  data.reponame = "_installed";
-                  data.version = f.ver;
-                  data.type = package_binary;
-
-                  // very limited information is available from installed.db, so
-                  // we put our best guesses here...
-                  data.vendor = "cygwin";
-                  data.requires = NULL;
-                  data.obsoletes = NULL;
-                  data.provides = NULL;
-                  data.conflicts = NULL;
-                  data.sdesc = "";
-                  data.ldesc = "";
-                  data.stability = TRUST_UNKNOWN;
-                  data.spkg = PackageSpecification(std::string(pkgname) + "-src", f.ver);
-
-                  // supplement this with sdesc, source, and stability
-                  // information from setup.ini, if possible...
-                  packageversion pv = findBinaryVersion(PackageSpecification(pkgname, f.ver));
-                  PackageDepends dep;
-                  PackageDepends obs;
-                  PackageDepends prov;
-                  PackageDepends conf;
-                  if (pv)
-                    {
-                      data.sdesc = pv.SDesc();
-                      data.ldesc = pv.LDesc();
-                      data.archive = *pv.source();
-                      data.stability = pv.Stability();
-                      data.spkg_id = pv.sourcePackage();
-                      data.spkg = pv.sourcePackageName();
-                      dep = pv.depends();
-                      data.requires = &dep;
-                      obs = pv.obsoletes();
-                      data.obsoletes = &obs;
-                      prov = pv.provides();
-                      data.provides = &prov;
-                      conf = pv.conflicts();
-                      data.conflicts = &conf;
-                    }
-                  else
-                    // This version is no longer available.  It could
-                    // be old, or it could be a previous test release
-                    // that has been replaced by a new test release.
-                    // Try to get some info from the packagemeta.
-                    {
-                      packagemeta *pkgm = findBinary(PackageSpecification(pkgname));
-                      if (pkgm)
-                        {
-                          data.sdesc = pkgm->curr.SDesc();
-                          data.ldesc = pkgm->curr.LDesc();
-                          if (pkgm->curr
-                              && version_compare (f.ver, pkgm->curr.Canonical_version()) > 0)
-                            data.stability = TRUST_TEST;
-                        }
-                    }
-
-                  packagemeta *pkg = packagedb::addBinary (pkgname, data);
-
-                  pkg->set_installed_version (f.ver);
-
-		  if (dbver == 3)
-		    pkg->user_picked = (user_picked & 1);
-
-		}
-	      delete db;
-	      db = 0;
-	    }
-	  else
+	  if (dbver > 3)
+	    fatal(NULL, IDS_INSTALLEDB_VERSION);
+
+	  char *pkgname, *inst;
+	  int user_picked;
+	  while (db.next (pkgname, inst, user_picked))
 	    {
-              fatal(NULL, IDS_INSTALLEDB_VERSION);
+	      const char *ver = db.version (inst);
+	      if (ver && (journal.empty ()
+			  || journal.find (pkgname) == journal.end ()))
+		addInstalled (pkgname, ver, user_picked, dbver);
 	    }
 
 	  installeddbver = dbver;
 	}
+
+      for (journal_type::iterator i = journal.begin (); i != journal.end (); ++i)
+	if (i->second.first != "-")
+	  if (const char *ver = db.version (&i->second.first[0]))
+	    addInstalled (i->first.c_str (), ver, i->second.second, 3);
+      if (!journal.empty ())
+	{
+	  Log (LOG_BABBLE) << "Applied " << journal.size ()
+			   << " journalled changes to INSTALLED.DB" << endLog;
+	  if (!installeddbver)
+	    installeddbver = 3;
+	}
     }
   solver.internalize();
 }
 
+/* Read the journal into journal, the last record for each package
+   winning.  A record is an INSTALLED.DB 3 line, with "-" for the
+   package file of one which has been removed, on a line of its own, so
+   one cut short by a crash is missing a field and is ignored. */
+void
+packagedb::readJournal (journal_type &journal)
+{
+  io_stream *f = io_stream::open (INSTALLED_DB_JOURNAL, "rb", 0);
+  if (!f)
+    return;
+  InstalledDbReader j;
+  j.read (f);
+  delete f;
+  char *pkgname, *inst;
+  int user_picked;
+  while (j.next (pkgname, inst, user_picked))
+    journal[pkgname] = std::make_pair (std::string (inst), user_picked);
+}
+
+/* Add an installed package, from a line of installed.db */
+void
+packagedb::addInstalled (const char *pkgname, const char *ver,
+			 int user_picked, int dbver)
+{
+  const std::string name (pkgname);
+  packagemeta *pkgm = lookup (packagesById, name);
+
+  SolverPool::addPackageData data;
+  data.reponame = "_installed";
+  data.version = ver;
+  data.type = package_binary;
+
+  // very limited information is available from installed.db, so
+  // we put our best guesses here...
+  data.vendor = "cygwin";
+  data.requires = NULL;
+  data.obsoletes = NULL;
+  data.provides = NULL;
+  data.conflicts = NULL;
+  data.sdesc = "";
+  data.ldesc = "";
+  data.stability = TRUST_UNKNOWN;
+  data.spkg = PackageSpecification(name + "-src", ver);
+
+  // supplement this with sdesc, source, and stability
+  // information from setup.ini, if possible, matched as
+  // findBinaryVersion () would, without looking pkgm up again...
+  PackageSpecification spec (name, ver);
+  packageversion pv;
+  if (pkgm)
+    for (std::set<packageversion>::iterator i = pkgm->versions.begin();
+         i != pkgm->versions.end(); ++i)
+      if (spec.satisfies (*i))
+        {
+          pv = *i;
+          break;
+        }
+  PackageDepends dep;
+  PackageDepends obs;
+  PackageDepends prov;
+  PackageDepends conf;
+  if (pv)
+    {
+      data.sdesc = pv.SDesc();
+      data.ldesc = pv.LDesc();
+      data.archive = *pv.source();
+      data.stability = pv.Stability();
+      data.spkg_id = pv.sourcePackage();
+      data.spkg = pv.sourcePackageName();
+      dep = pv.depends();
+      data.requires = &dep;
+      obs = pv.obsoletes();
+      data.obsoletes = &obs;
+      prov = pv.provides();
+      data.provides = &prov;
+      conf = pv.conflicts();
+      data.conflicts = &conf;
+    }
+  else
+    // This version is no longer available.  It could
+    // be old, or it could be a previous test release
+    // that has been replaced by a new test release.
+    // Try to get some info from the packagemeta.
+    {
+      if (pkgm)
+        {
+          data.sdesc = pkgm->curr.SDesc();
+          data.ldesc = pkgm->curr.LDesc();
+          if (pkgm->curr
+              && version_compare (ver, pkgm->curr.Canonical_version()) > 0)
+            data.stability = TRUST_TEST;
+        }
+    }
+
+  /* as addBinary () */
+  if (!pkgm)
+    pkgm = insert (packages, packagesById, name);
+  pkgm->add_version (data);
+
+  pkgm->set_installed_version (ver);
+
+  if (dbver == 3)
+    pkgm->user_picked = (user_picked & 1);
+}
+
 /* Create the fictitious basepkg */
 void
 packagedb::makeBase()
@@ -265,10 +303,7 @@ packagedb::addBinary (const std::string &pkgname,
   /* If pkgname isn't already in packagedb, add a packagemeta */
   packagemeta *pkg = findBinary (PackageSpecification(pkgname));
   if (!pkg)
-    {
-      pkg = new packagemeta (pkgname);
-      packages.insert (packagedb::packagecollection::value_type(pkgname, pkg));
-    }
+    pkg = insert (packages, packagesById, pkgname);
 
   /* Create the SolvableVersion and register it in packagemeta */
   pkg->add_version (pkgdata);
@@ -283,10 +318,7 @@ packagedb::addSource (const std::string &pkgname,
   /* If pkgname isn't already in packagedb, add a packagemeta */
   packagemeta *pkg = findSource (PackageSpecification(pkgname));
   if (!pkg)
-    {
-      pkg = new packagemeta (pkgname);
-      sourcePackages.insert (packagedb::packagecollection::value_type(pkgname, pkg));
-    }
+    pkg = insert (sourcePackages, sourcePackagesById, pkgname);
 
   /* Create the SolvableVersion and register it in packagemeta */
   SolvableVersion sv = pkg->add_version (pkgdata);
@@ -294,12 +326,29 @@ packagedb::addSource (const std::string &pkgname,
   return sv;
 }
 
+/*
+  In INSTALLED.DB 3, lines are: 'packagename version flags', where
+  version is encoded in a notional filename for backwards
+  compatibility, and the only currently defined flag is user-picked
+  (bit 0).  The journal also uses "-" for the version of a package
+  which is not installed.
+*/
+static std::string
+installed_line (packagemeta const &pkgm)
+{
+  if (!pkgm.installed)
+    return pkgm.name + " - 0\n";
+  return pkgm.name + " " +
+    pkgm.name + "-" + std::string(pkgm.installed.Canonical_version()) + ".tar.bz2 " +
+    (pkgm.user_picked ? "1" : "0") + "\n";
+}
+
 int
 packagedb::flush ()
 {
   /* naive approach - just dump the lot */
-  char const *odbn = "cygfile:///etc/setup/installed.db";
-  char const *ndbn = "cygfile:///etc/setup/installed.db.new";
+  char const *odbn = INSTALLED_DB;
+  char const *ndbn = INSTALLED_DB_NEW;
 
   io_stream::mkpath_p (PATH_TO_FILE, ndbn, 0755);
 
@@ -316,16 +365,7 @@ packagedb::flush ()
       packagemeta & pkgm = *(i->second);
       if (pkgm.installed)
 	{
-	  /*
-	    In INSTALLED.DB 3, lines are: 'packagename version flags', where
-	    version is encoded in a notional filename for backwards
-	    compatibility, and the only currently defined flag is user-picked
-	    (bit 0).
-	  */
-	  std::string line;
-	  line = pkgm.name + " " +
-	    pkgm.name + "-" + std::string(pkgm.installed.Canonical_version()) + ".tar.bz2 " +
-	    (pkgm.user_picked ? "1" : "0") + "\n";
+	  std::string line = installed_line (pkgm);
 	  ndb->write (line.c_str(), line.size());
 	}
     }
@@ -336,9 +376,37 @@ packagedb::flush ()
 
   if (io_stream::move (ndbn, odbn))
     return errno ? errno : 1;
+
+  /* everything in the journal is in installed.db now */
+  io_stream::remove (INSTALLED_DB_JOURNAL);
+  journalled = 0;
   return 0;
 }
 
+/* Record the installed state of pkgm, which has just changed, by
+   appending to the journal rather than rewriting installed.db, so that
+   it survives whatever happens before the next flush ().  Every so
+   often the journal is compacted into installed.db by a flush (). */
+void
+packagedb::journal (packagemeta const &pkgm)
+{
+  io_stream::mkpath_p (PATH_TO_FILE, INSTALLED_DB_JOURNAL, 0755);
+  io_stream *j = io_stream::open (INSTALLED_DB_JOURNAL, "ab", 0644);
+  if (!j)
+    {
+      Log (LOG_PLAIN) << "Unable to write to INSTALLED.DB journal" << endLog;
+      return;
+    }
+  std::string line = journal_record (installed_line (pkgm));
+  ssize_t written = j->write (line.c_str (), line.size ());
+  delete j;
+  if (written != (ssize_t) line.size ())
+    Log (LOG_PLAIN) << "Unable to write to INSTALLED.DB journal" << endLog;
+
+  if (++journalled >= JOURNAL_COMPACT_RECORDS && flush ())
+    Log (LOG_PLAIN) << "Unable to compact INSTALLED.DB journal" << endLog;
+}
+
 void
 packagedb::upgrade()
 {
@@ -351,17 +419,52 @@ packagedb::upgrade()
     }
 }
 
+packagemeta *
+packagedb::lookup (packageindex const &index, const std::string &name)
+{
+  /* a name the pool has never seen cannot be a package */
+  Id id = solver.intern (name, false);
+  if (!id)
+    return NULL;
+  packageindex::const_iterator n = index.find (id);
+  return n != index.end () ? n->second : NULL;
+}
+
+/* Add a new packagemeta for name */
+packagemeta *
+packagedb::insert (packagecollection &collection, packageindex &index,
+		   const std::string &name)
+{
+  packagecollection::iterator n = collection.lower_bound (name);
+  /* known, but without the versions for findBinary () to match */
+  if (n != collection.end () && n->first == name)
+    return n->second;
+  packagemeta *pkgm = new packagemeta (name);
+  collection.insert (n, packagecollection::value_type (name, pkgm));
+  index[solver.intern (name)] = pkgm;
+  return pkgm;
+}
+
+/* Remove and delete the package at i, and advance i */
+void
+packagedb::erase (packagecollection &collection, packageindex &index,
+		  packagecollection::iterator &i)
+{
+  index.erase (solver.intern (i->first));
+  delete i->second;
+  collection.erase (i++);
+}
+
 packagemeta *
 packagedb::findBinary (PackageSpecification const &spec) const
 {
-  packagedb::packagecollection::iterator n = packages.find(spec.packageName());
-  if (n != packages.end())
+  packagemeta *pkgm = lookup (packagesById, spec.packageName());
+  if (pkgm)
     {
-      packagemeta & pkgm = *(n->second);
-      for (std::set<packageversion>::iterator i=pkgm.versions.begin();
-	  i != pkgm.versions.end(); ++i)
+      for (std::set<packageversion>::iterator i=pkgm->versions.begin();
+	  i != pkgm->versions.end(); ++i)
 	if (spec.satisfies (*i))
-	  return &pkgm;
+	  return pkgm;
     }
   return NULL;
 }
@@ -369,12 +472,11 @@ packagedb::findBinary (PackageSpecification const &spec) const
 packageversion
 packagedb::findBinaryVersion (PackageSpecification const &spec) const
 {
-  packagedb::packagecollection::iterator n = packages.find(spec.packageName());
-  if (n != packages.end())
+  packagemeta *pkgm = lookup (packagesById, spec.packageName());
+  if (pkgm)
     {
-      packagemeta & pkgm = *(n->second);
-      for (std::set<packageversion>::iterator i=pkgm.versions.begin();
-          i != pkgm.versions.end(); ++i)
+      for (std::set<packageversion>::iterator i=pkgm->versions.begin();
+          i != pkgm->versions.end(); ++i)
         if (spec.satisfies (*i))
           return *i;
     }
@@ -384,14 +486,13 @@ packagedb::findBinaryVersion (PackageSpecification const &spec) const
 packagemeta *
 packagedb::findSource (PackageSpecification const &spec) const
 {
-  packagedb::packagecollection::iterator n = sourcePackages.find(spec.packageName());
-  if (n != sourcePackages.end())
+  packagemeta *pkgm = lookup (sourcePackagesById, spec.packageName());
+  if (pkgm)
     {
-      packagemeta & pkgm = *(n->second);
-      for (std::set<packageversion>::iterator i = pkgm.versions.begin();
-	   i != pkgm.versions.end(); ++i)
+      for (std::set<packageversion>::iterator i = pkgm->versions.begin();
+	   i != pkgm->versions.end(); ++i)
 	if (spec.satisfies (*i))
-	  return &pkgm;
+	  return pkgm;
     }
   return NULL;
 }
@@ -399,12 +500,11 @@ packagedb::findSource (PackageSpecification const &spec) const
 packageversion
 packagedb::findSourceVersion (PackageSpecification const &spec) const
 {
-  packagedb::packagecollection::iterator n = sourcePackages.find(spec.packageName());
-  if (n != sourcePackages.end())
+  packagemeta *pkgm = lookup (sourcePackagesById, spec.packageName());
+  if (pkgm)
     {
-      packagemeta & pkgm = *(n->second);
-      for (std::set<packageversion>::iterator i = pkgm.versions.begin();
-           i != pkgm.versions.end(); ++i)
+      for (std::set<packageversion>::iterator i = pkgm->versions.begin();
+           i != pkgm->versions.end(); ++i)
         if (spec.satisfies (*i))
           return *i;
     }
@@ -416,7 +516,10 @@ packagedb::findSourceVersion (PackageSpecification const &spec) const
 int packagedb::installeddbread = 0;
 int packagedb::installeddbver = 0;
 bool packagedb::prepped = false;
+int packagedb::journalled = 0;
 packagedb::packagecollection packagedb::packages;
+packagedb::packageindex packagedb::packagesById;
+packagedb::packageindex packagedb::sourcePackagesById;
 packagedb::categoriesType packagedb::categories;
 packagedb::packagecollection packagedb::sourcePackages;
 PackageDBActions packagedb::task = PackageDB_Install;
@@ -523,15 +626,13 @@ ConnectedLoopFinder::visit(packagemeta *nodeToVisit)
 	  /* UGLY. Need to refactor. iterators in the outer would help as we could simply
 	   * vist the iterator
 	   */
-	  const packagedb::packagecollection::iterator n = db.packages.find((*dp)->packageName());
+	  packagemeta *nodeJustVisited =
+	    packagedb::lookup (packagedb::packagesById, (*dp)->packageName());
 
-	  if (n == db.packages.end())
+	  if (!nodeJustVisited)
 	     Log (LOG_PLAIN) << "Search for package '" << (*dp)->packageName() << "' failed." << endLog;
 	   else
-	   {
-	       packagemeta *nodeJustVisited = n->second;
 	       minimumVisitId = std::min (minimumVisitId, visit (nodeJustVisited));
-	   }
 	}
 	/* not installed or not available we ignore */
       ++dp;
@@ -588,11 +689,7 @@ packagedb::setExistence ()
       packagemeta & pkg = *(i->second);
       if (!pkg.installed && !pkg.accessible() && 
           !pkg.sourceAccessible() )
-        {
-          packagemeta *pkgm = (*i).second;
-          delete pkgm;
-          packages.erase (i++);
-        }
+        erase (packages, packagesById, i);
       else
         ++i;
     }
@@ -698,12 +795,9 @@ packagedb::guessUserPicked()
 	  /* check for an installed match */
           if (checkForInstalled(*dp))
 	    {
-	      const packagedb::packagecollection::iterator n = packages.find((*dp)->packageName());
-	      if (n != packages.end())
-		{
-		  packagemeta *pkgm2 = n->second;
-		  pkgm2->user_picked = FALSE;
-		}
+	      packagemeta *pkgm2 = lookup (packagesById, (*dp)->packageName());
+	      if (pkgm2)
+		pkgm2->user_picked = FALSE;
 	      /* skip to next and clause */
 	      ++dp;
 	      continue;
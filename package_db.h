@@ -19,6 +19,7 @@
 /* required to parse this file */
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include "String++.h"
 class packagemeta;
 class io_stream;
@@ -67,6 +68,8 @@ public:
   void init();
   /* 0 on success */
   int flush ();
+  /* record a change to a package's installed state */
+  void journal (packagemeta const &);
   void prep();
   /* Set the database to a "no changes requested" state.  */
   void noChanges ();
@@ -83,6 +86,9 @@ public:
 
   void defaultTrust (SolverTasks &q, SolverSolution::updateMode mode, bool test);
 
+  /* Kept in name order, for display and for installed.db.  To add or
+     remove a package, use addBinary ()/addSource () or erase (), which
+     keep the index by name in step. */
   typedef std::map <std::string, packagemeta *> packagecollection;
   /* all seen binary packages */
   static packagecollection packages;
@@ -102,6 +108,22 @@ private:
   void makeBase();
   void makeWindows();
   void read();
+  typedef std::map <std::string, std::pair <std::string, int> > journal_type;
+  void readJournal (journal_type &);
+  void addInstalled (const char *pkgname, const char *ver, int user_picked,
+		     int dbver);
+
+  /* packages and sourcePackages again, by the solver's Id for the name,
+     so that finding a package is a hash lookup rather than a walk down
+     the map comparing strings */
+  typedef std::unordered_map <Id, packagemeta *> packageindex;
+  static packageindex packagesById;
+  static packageindex sourcePackagesById;
+  static packagemeta *lookup (packageindex const &, const std::string &name);
+  static packagemeta *insert (packagecollection &, packageindex &,
+			      const std::string &name);
+  static void erase (packagecollection &, packageindex &,
+		     packagecollection::iterator &);
   void upgrade ();
   void fixup_source_package_ids();
   void removeEmptyCategories();
@@ -111,6 +133,7 @@ private:
 
   static int installeddbread;	/* do we have to reread this */
   static int installeddbver;
+  static int journalled;	/* records since the last flush */
   static bool prepped;
 
   friend class ConnectedLoopFinder;
@@ -20,24 +20,47 @@
 #include "package_source.h"
 #include "sha2.h"
 #include "csu_util/MD5Sum.h"
+#include "csu_util/SHA512Sum.h"
 #include "LogFile.h"
-#include "threebar.h"
 #include "Exception.h"
 #include "filemanip.h"
 #include "io_stream.h"
 
-extern ThreeBarProgressPage g_Progress;
-
 site::site (const std::string& newkey) : key(newkey)
 {
 }
 
+packagedigest::packagedigest (const packagesource &source)
+  : sha512 (NULL), md5 (NULL)
+{
+  if (source.sha512_isSet)
+    sha512 = new SHA512Sum;
+  else if (source.md5.isSet ())
+    {
+      md5 = new MD5Sum;
+      md5->begin ();
+    }
+}
+
+packagedigest::~packagedigest ()
+{
+  delete sha512;
+  delete md5;
+}
+
+void
+packagedigest::append (const unsigned char *data, size_t len)
+{
+  if (sha512)
+    sha512->append (data, len);
+  else if (md5)
+    md5->append (data, len);
+}
+
 void
 packagesource::set_canonical (char const *fn)
 {
   canonical = fn;
-  size_t found = canonical.find_last_of ("/");
-  shortname = canonical.substr (found + 1);
 }
 
 void
@@ -65,18 +88,24 @@ packagesource::check_size_and_cache (const std::string fullname)
 
 void
 packagesource::check_hash ()
+{
+  check_hash (NULL);
+}
+
+void
+packagesource::check_hash (volatile long long *hashed)
 {
   if (validated || cached.empty ())
     return;
 
   if (sha512_isSet)
     {
-      check_sha512 (cached);
+      check_sha512 (cached, hashed);
       validated = true;
     }
   else if (md5.isSet())
     {
-      check_md5 (cached);
+      check_md5 (cached, hashed);
       validated = true;
     }
   else
@@ -85,6 +114,29 @@ packagesource::check_hash ()
 		     << endLog;
 }
 
+void
+packagesource::check_hash (packagedigest &digest)
+{
+  if (validated || cached.empty ())
+    return;
+
+  if (digest.sha512)
+    {
+      unsigned char sha512result[SHA512_DIGEST_LENGTH];
+      digest.sha512->finish (sha512result);
+      compare_sha512 (cached, sha512result);
+      validated = true;
+    }
+  else if (digest.md5)
+    {
+      digest.md5->finish ();
+      compare_md5 (cached, *digest.md5);
+      validated = true;
+    }
+  else
+    check_hash ();
+}
+
 static char *
 sha512_str (const unsigned char *in, char *buf)
 {
@@ -96,32 +148,26 @@ sha512_str (const unsigned char *in, char *buf)
 }
 
 void
-packagesource::check_sha512 (const std::string fullname) const
+packagesource::check_sha512 (const std::string fullname,
+			     volatile long long *hashed) const
 {
   io_stream *thefile = io_stream::open (fullname, "rb", 0);
   if (!thefile)
     throw new Exception (TOSTRING (__LINE__) " " __FILE__,
 			 std::string ("IO Error opening ") + fullname,
 			 APPERR_IO_ERROR);
-  SHA2_CTX ctx;
+  SHA512Sum tempSHA512;
   unsigned char sha512result[SHA512_DIGEST_LENGTH];
-  char ini_sum[SHA512_DIGEST_STRING_LENGTH],
-       disk_sum[SHA512_DIGEST_STRING_LENGTH];
-
-  SHA512Init (&ctx);
 
   Log (LOG_BABBLE) << "Checking SHA512 for " << fullname << endLog;
 
-  g_Progress.SetText1 (("Checking SHA512 for " + shortname).c_str ());
-  g_Progress.SetText4 ("Progress:");
-  g_Progress.SetBar1 (0);
-
   unsigned char buffer[64 * 1024];
   ssize_t count;
   while ((count = thefile->read (buffer, sizeof (buffer))) > 0)
   {
-    SHA512Update (&ctx, buffer, count);
-    g_Progress.SetBar1 (thefile->tell (), thefile->get_size ());
+    tempSHA512.append (buffer, count);
+    if (hashed)
+      InterlockedExchangeAdd64 (hashed, count);
   }
   delete thefile;
   if (count < 0)
@@ -129,9 +175,18 @@ packagesource::check_sha512 (const std::string fullname) const
 			 "IO Error reading " + fullname,
 			 APPERR_IO_ERROR);
 
-  SHA512Final (sha512result, &ctx);
+  tempSHA512.finish (sha512result);
+  compare_sha512 (fullname, sha512result);
+}
 
-  if (memcmp (sha512sum, sha512result, sizeof sha512result))
+void
+packagesource::compare_sha512 (const std::string fullname,
+			       const unsigned char sha512result[]) const
+{
+  char ini_sum[SHA512_DIGEST_STRING_LENGTH],
+       disk_sum[SHA512_DIGEST_STRING_LENGTH];
+
+  if (memcmp (sha512sum, sha512result, SHA512_DIGEST_LENGTH))
     {
       Log (LOG_BABBLE) << "INVALID PACKAGE: " << fullname
 		       << " - SHA512 mismatch: Ini-file: "
@@ -149,7 +204,8 @@ packagesource::check_sha512 (const std::string fullname) const
 }
 
 void
-packagesource::check_md5 (const std::string fullname) const
+packagesource::check_md5 (const std::string fullname,
+			  volatile long long *hashed) const
 {
   io_stream *thefile = io_stream::open(fullname, "rb", 0);
   if (!thefile)
@@ -161,15 +217,12 @@ packagesource::check_md5 (const std::string fullname) const
 
   Log(LOG_BABBLE) << "Checking MD5 for " << fullname << endLog;
 
-  g_Progress.SetText1(("Checking MD5 for " + shortname).c_str());
-  g_Progress.SetText4("Progress:");
-  g_Progress.SetBar1(0);
-
   unsigned char buffer[64 * 1024];
   ssize_t count;
   while ((count = thefile->read(buffer, sizeof(buffer))) > 0) {
     tempMD5.append(buffer, count);
-    g_Progress.SetBar1(thefile->tell(), thefile->get_size());
+    if (hashed)
+      InterlockedExchangeAdd64(hashed, count);
   }
   delete thefile;
   if (count < 0)
@@ -177,7 +230,13 @@ packagesource::check_md5 (const std::string fullname) const
                         "IO Error reading " + fullname, APPERR_IO_ERROR);
 
   tempMD5.finish();
+  compare_md5(fullname, tempMD5);
+}
 
+void
+packagesource::compare_md5 (const std::string fullname,
+                            const MD5Sum &tempMD5) const
+{
   if (md5 != tempMD5) {
     Log(LOG_BABBLE) << "INVALID PACKAGE: " << fullname
                     << " - MD5 mismatch: Ini-file: " << md5.str()
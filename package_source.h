@@ -26,6 +26,26 @@
 #include "csu_util/MD5Sum.h"
 #include <vector>
 
+class SHA512Sum;
+class packagesource;
+
+/* Computes whichever checksum a packagesource has, incrementally, so that a
+   download can be checked as it arrives instead of being read back from
+   disk afterwards.  See packagesource::check_hash (packagedigest &).  */
+class packagedigest
+{
+public:
+  packagedigest (const packagesource &source);
+  ~packagedigest ();
+  void append (const unsigned char *data, size_t len);
+private:
+  friend class packagesource;
+  SHA512Sum *sha512;
+  MD5Sum *md5;
+  packagedigest (const packagedigest &); // no copy cons
+  packagedigest &operator= (const packagedigest &); // no assignment
+};
+
 class site
 {
 public:
@@ -41,7 +61,7 @@ public:
 class packagesource
 {
 public:
-  packagesource ():size (0), canonical (), shortname (), cached (), validated (false)
+  packagesource ():size (0), canonical (), cached (), validated (false)
   {
     memset (sha512sum, 0, sizeof sha512sum);
     sha512_isSet = false;
@@ -71,26 +91,41 @@ public:
       return NULL;
     return cached.c_str();
   };
+  /* whether the cached file's hash has been checked */
+  bool Validated () const
+  {
+    return validated;
+  };
   /* sets the canonical path */
   void set_canonical (char const *);
   void set_cached (const std::string& );
   unsigned char sha512sum[SHA512_DIGEST_LENGTH];
   bool sha512_isSet;
   MD5Sum md5;
-  /* The next two functions throw exceptions on failure.  */
+  /* The next functions throw exceptions on failure.  None of them touch
+     the GUI, so they may run on a worker thread.  */
   void check_size_and_cache (const std::string fullname);
   void check_hash ();
+  /* As check_hash (), adding the number of bytes hashed to *hashed as it
+     goes, for whoever is showing the progress.  */
+  void check_hash (volatile long long *hashed);
+  /* As check_hash (), but using a digest of the cached file computed while
+     it was written, rather than reading it again.  */
+  void check_hash (packagedigest &digest);
   typedef std::vector <site> sitestype;
   sitestype sites;
 
 private:
   std::string canonical;
-  /* For progress reporting.  */
-  std::string shortname;
   std::string cached;
   bool validated;
-  void check_sha512 (const std::string fullname) const;
-  void check_md5 (const std::string fullname) const;
+  void check_sha512 (const std::string fullname,
+		     volatile long long *hashed) const;
+  void check_md5 (const std::string fullname,
+		  volatile long long *hashed) const;
+  void compare_sha512 (const std::string fullname,
+		       const unsigned char sha512result[]) const;
+  void compare_md5 (const std::string fullname, const MD5Sum &tempMD5) const;
 };
 
 #endif /* SETUP_PACKAGE_SOURCE_H */
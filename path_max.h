@@ -0,0 +1,22 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+#ifndef SETUP_PATH_MAX_H
+#define SETUP_PATH_MAX_H
+
+/* Needed for some buffers etc., to have a useful replacement for MAX_PATH.
+ * Kept apart from win32.h so that code which doesn't otherwise need
+ * <windows.h>, such as the tar reader, needn't include it. */
+#define CYG_PATH_MAX	4096
+
+#endif /* SETUP_PATH_MAX_H */
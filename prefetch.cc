@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+#include "prefetch.h"
+
+#include "io_stream.h"
+#include "io_stream_memory.h"
+#include "io_stream_readahead.h"
+#include "compress.h"
+#include "package_source.h"
+
+/* Decompress a cached package into memory.  Returns NULL if the file can't
+   be read, isn't compressed, fails to decompress, or decompresses to more
+   than limit bytes, in which case installOne will reopen it and report
+   any problem itself.  Runs on a worker thread, and decodes with that
+   thread alone, as every worker may be decoding a package at once. */
+static io_stream *
+decompress_to_memory (const std::string &cached, size_t limit)
+{
+  io_stream *pkgfile = io_stream::open (cached, "rb", 0);
+  if (!pkgfile)
+    return NULL;
+
+  io_stream *decompressed = compress::decompress (pkgfile);
+  if (!decompressed)
+    {
+      delete pkgfile;
+      return NULL;
+    }
+
+  /* as io_stream::copy (), giving up at limit */
+  io_stream *mem = new io_stream_memory ();
+  char buffer[65536];
+  const void *view = buffer;
+  bool lends = decompressed->lends ();
+  ssize_t got;
+  while ((got = lends ? decompressed->read_view (&view, sizeof (buffer))
+		      : decompressed->read (buffer, sizeof (buffer))) > 0)
+    {
+      if ((size_t) got > limit - mem->get_size ()
+	  || mem->write (view, got) != got)
+	{
+	  got = -1;
+	  break;
+	}
+      if (lends)
+	decompressed->consume (got);
+    }
+  if (got < 0 || mem->seek (0, IO_SEEK_SET))
+    {
+      delete mem;
+      mem = NULL;
+    }
+  delete decompressed;
+  return mem;
+}
+
+InstallPrefetcher::InstallPrefetcher (const std::vector<packagesource *> &q,
+				      size_t max_package, long long window)
+  : queue (q), max_package (max_package), window (window),
+    slots (q.size ()), taken (0), next (0), staged (0)
+{
+  fill ();
+}
+
+InstallPrefetcher::~InstallPrefetcher ()
+{
+  pool.wait ();
+  for (std::vector<slot>::iterator i = slots.begin (); i != slots.end (); ++i)
+    {
+      if (i->done)
+	CloseHandle (i->done);
+      delete i->data;
+    }
+}
+
+/* Count the packages decompressed since last time for what they hold */
+void
+InstallPrefetcher::settle ()
+{
+  for (size_t n = taken; n < next; ++n)
+    {
+      slot &s = slots[n];
+      if (!s.done || s.settled
+	  || WaitForSingleObject (s.done, 0) != WAIT_OBJECT_0)
+	continue;
+      staged -= s.size;
+      s.size = s.data ? s.data->get_size () : 0;
+      staged += s.size;
+      s.settled = true;
+    }
+}
+
+void
+InstallPrefetcher::fill ()
+{
+  settle ();
+  for (; next < queue.size (); ++next)
+    {
+      packagesource *source = queue[next];
+      /* one as large as this compressed is larger still decompressed */
+      if (!source->Canonical () || !source->Cached ()
+	  || source->size > max_package)
+	continue;
+      if (staged + (long long) max_package > window)
+	break;
+
+      slot *s = &slots[next];
+      s->done = CreateEvent (NULL, TRUE, FALSE, NULL);
+      if (!s->done)
+	break;
+      s->size = max_package;
+      staged += s->size;
+
+      std::string cached = source->Cached ();
+      size_t limit = max_package;
+      pool.submit ([s, cached, limit] () {
+	s->data = decompress_to_memory (cached, limit);
+	SetEvent (s->done);
+      });
+    }
+}
+
+io_stream *
+InstallPrefetcher::take (size_t n)
+{
+  slot &s = slots[n];
+  taken = n + 1;
+  if (!s.done)
+    {
+      fill ();
+      return NULL;
+    }
+
+  WaitForSingleObject (s.done, INFINITE);
+  CloseHandle (s.done);
+  s.done = NULL;
+  io_stream *data = s.data;
+  s.data = NULL;
+
+  staged -= s.size;
+  fill ();
+  return data;
+}
+
+io_stream *
+decompress_package (io_stream *pkgfile, io_stream_readahead **ahead)
+{
+  unsigned int threads = ThreadPool::default_size ();
+  io_stream *decompressed = compress::decompress (pkgfile, threads);
+  io_stream_readahead *readahead = NULL;
+  /* decompress ahead on another thread while this one writes files out */
+  if (decompressed && threads > 1)
+    decompressed = readahead =
+      new io_stream_readahead (decompressed, 0, 0, pkgfile);
+  if (ahead)
+    *ahead = readahead;
+  return decompressed;
+}
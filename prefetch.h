@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+#ifndef SETUP_PREFETCH_H
+#define SETUP_PREFETCH_H
+
+/* Decompressing packages for installing: small ones ahead of the install
+ * thread, a few at once with a thread each, and big ones on the install
+ * thread as they are extracted, with every thread there is.  Nothing here
+ * touches the GUI.
+ */
+
+#include "win32.h"
+#include "threadpool.h"
+#include <vector>
+
+class io_stream;
+class io_stream_readahead;
+class packagesource;
+
+/* Packages are only staged in memory if they decompress to at most this
+   many bytes, and no more than PREFETCH_WINDOW decompressed bytes are
+   staged at once; anything else is decompressed by installOne as before.
+   Until a package has been decompressed, it counts against the window as
+   PREFETCH_MAX_PACKAGE. */
+#define PREFETCH_MAX_PACKAGE (32 * 1024 * 1024)
+#define PREFETCH_WINDOW (128 * 1024 * 1024)
+
+/* Decompresses packages from the install queue ahead of the install thread,
+   using a pool of worker threads.
+
+   Extraction proper (writing files and the .lst.gz manifest, and updating
+   pkgm.installed) still happens on the install thread in queue order, so
+   packages which ship the same path overwrite each other exactly as they
+   did when everything was serial. */
+class InstallPrefetcher
+{
+public:
+  /* q is the source of each package to be installed, in order */
+  InstallPrefetcher (const std::vector<packagesource *> &q,
+		     size_t max_package = PREFETCH_MAX_PACKAGE,
+		     long long window = PREFETCH_WINDOW);
+  ~InstallPrefetcher ();
+  /* the decompressed tarball for q[n], or NULL if it wasn't staged.  The
+     caller owns the returned stream.  Must be called in ascending order. */
+  io_stream *take (size_t n);
+private:
+  struct slot
+  {
+    slot () : done (NULL), data (NULL), size (0), settled (false) {}
+    HANDLE done;
+    io_stream *data;
+    /* what it counts against the window */
+    size_t size;
+    /* size is what data holds, not the most it might */
+    bool settled;
+  };
+  void settle ();
+  void fill ();
+
+  const std::vector<packagesource *> &queue;
+  const size_t max_package;
+  const long long window;
+  std::vector<slot> slots;
+  size_t taken;
+  size_t next;
+  long long int staged;
+  ThreadPool pool;
+};
+
+/* The decompressed contents of pkgfile, a package which wasn't prefetched,
+   for installOne to extract.  Only one such package is decompressed at
+   once, so it is decoded with ThreadPool::default_size () threads, where
+   the format allows, and read ahead on a thread of its own while files are
+   written out.  NULL if pkgfile isn't compressed, in which case it is
+   still the caller's.  If ahead is given, it is set to the stream reading
+   ahead, which notes how far through pkgfile it has got, or NULL if there
+   is none; pkgfile must then only be asked that through *ahead. */
+io_stream *decompress_package (io_stream *pkgfile,
+			       io_stream_readahead **ahead = NULL);
+
+#endif /* SETUP_PREFETCH_H */
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+/* Compress some data with bzip2, as one stream and as several
+   concatenated as pbzip2 writes them, and check compress_bz decodes each
+   the same as it is read and a block to a thread, timing them.  Then
+   check small and highly repetitive data decode the same, and that a
+   damaged or truncated stream is an error with several threads.
+
+   Usage: BzThreadsTest [MiB [threads]]  (default: 16, 4) */
+
+#include "compress_bz.h"
+#include "io_stream.h"
+#include "io_stream_memory.h"
+#include "testutil.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+/* text-like data, which compresses about as well as a package does */
+static std::string
+generate (size_t size)
+{
+  static const char *words[] = { "usr", "share", "doc", "lib", "include",
+				 "the", "of", "and", "int", "return",
+				 "static", "const", "char", "void", "size" };
+  std::string s;
+  s.reserve (size + 16);
+  unsigned int r = 1;
+  while (s.size () < size)
+    {
+      r = r * 1103515245 + 12345;
+      s += words[(r >> 16) % 15];
+      s += (r >> 8) % 7 ? ' ' : '\n';
+      if ((r >> 4) % 31 == 0)
+	s += (char) ('A' + (r >> 20) % 26);
+    }
+  s.resize (size);
+  return s;
+}
+
+/* in streams of stream_size, or in one if 0 */
+static std::string
+bzip2 (const std::string &in, size_t stream_size)
+{
+  if (!stream_size)
+    stream_size = in.size ();
+  std::string out;
+  for (size_t done = 0; done < in.size (); done += stream_size)
+    {
+      size_t len = std::min (stream_size, in.size () - done);
+      unsigned int outlen = len + len / 100 + 600;
+      std::string part (outlen, '\0');
+      int ret = BZ2_bzBuffToBuffCompress (&part[0], &outlen,
+					  (char *) in.data () + done, len,
+					  9, 0, 0);
+      assert (ret == BZ_OK);
+      out.append (part, 0, outlen);
+    }
+  return out;
+}
+
+/* decode compressed with compress_bz; false on error */
+static bool
+decode (const std::string &compressed, std::string &out, unsigned int threads)
+{
+  io_stream_memory *mem = new io_stream_memory;
+  mem->write (compressed.data (), compressed.size ());
+  mem->seek (0, IO_SEEK_SET);
+  compress_bz bz (mem, threads);
+  out.clear ();
+  char buf[65536];
+  if (bz.peek (buf, 100) < 0)
+    return false;
+  ssize_t got;
+  while ((got = bz.read (buf, sizeof buf)) > 0)
+    out.append (buf, got);
+  return got == 0 && !bz.error ();
+}
+
+int
+main (int argc, char **argv)
+{
+  size_t mib = argc > 1 ? atoi (argv[1]) : 16;
+  unsigned int threads = argc > 2 ? atoi (argv[2]) : 4;
+
+  std::string data = generate (mib << 20);
+  struct
+  {
+    const char *name;
+    size_t stream_size;
+  } layouts[] = {
+    { "one stream", 0 },
+    { "3 MiB streams", 3 << 20 },
+  };
+  std::string out, one;
+  for (size_t l = 0; l < sizeof layouts / sizeof *layouts; l++)
+    {
+      std::string compressed = bzip2 (data, layouts[l].stream_size);
+      if (!layouts[l].stream_size)
+	one = compressed;
+      double start = now ();
+      assert (decode (compressed, out, 1) && out == data);
+      double single = now () - start;
+      start = now ();
+      assert (decode (compressed, out, threads) && out == data);
+      double multi = now () - start;
+      printf ("%lu MiB, %s, %lu bytes: as read %.3f s, %u threads %.3f s\n",
+	      (unsigned long) mib, layouts[l].name,
+	      (unsigned long) compressed.size (), single, threads, multi);
+    }
+
+  /* too small to be worth the threads */
+  std::string small = data.substr (0, 100000);
+  assert (decode (bzip2 (small, 0), out, threads) && out == small);
+
+  /* runs, which a block holds many times over */
+  std::string runs;
+  for (int i = 0; runs.size () < (64 << 20); i++)
+    runs.append (200 + i % 50, (char) ('a' + i % 26));
+  std::string compressed = bzip2 (runs, 0);
+  assert (decode (compressed, out, threads) && out == runs);
+  printf ("%lu MiB of runs, %lu bytes: decoded\n",
+	  (unsigned long) (runs.size () >> 20),
+	  (unsigned long) compressed.size ());
+
+  /* damage in a block, and cut short */
+  std::string damaged = one;
+  damaged[damaged.size () / 3] ^= 0x55;
+  assert (!decode (damaged, out, threads));
+  damaged = one.substr (0, one.size () * 2 / 3);
+  assert (!decode (damaged, out, threads));
+  damaged = one.substr (0, one.size () - 1);
+  assert (!decode (damaged, out, threads));
+  return 0;
+}
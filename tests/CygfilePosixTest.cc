@@ -0,0 +1,280 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+/* Install a synthetic package through cygfile:// into a scratch directory
+   with cygfile_fs_posix, extracting it with archive::extract_file () as
+   install.cc does, over a directory in the way of one of its files, and
+   writing its manifest with ManifestWriter.  Check every file, link and
+   mtime is as the package has it.  Then uninstall it from the manifest
+   with remove_listed_files () as Installer::uninstallOne does, keeping
+   one file as if another package owned it, which must leave only that
+   file and what was there before.  Times extracting and removing.
+
+   Only the MinGW build makes it.  Nothing here configures a host build,
+   and the decompressors it reads the manifest back with use Win32
+   threads, so on a POSIX host it can only be compiled by hand, with
+   stand-ins for those.
+
+   Usage: CygfilePosixTest [directories [files]]  (default: 50, 100) */
+
+#include "io_stream.h"
+#include "archive.h"
+#include "archive_tar.h"
+#include "cygfile_fs_posix.h"
+#include "compress.h"
+#include "io_stream_memory.h"
+#include "manifest.h"
+#include "testutil.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+static std::string
+contents (const std::string &name, size_t size)
+{
+  std::string data;
+  while (data.size () < size)
+    data += name + "\n";
+  data.resize (size);
+  return data;
+}
+
+static void
+header (std::string &out, const std::string &name, char type,
+	const std::string &data = "", const std::string &linkname = "")
+{
+  tar_header_type h;
+  memset (&h, 0, sizeof h);
+  strcpy (h.name, name.c_str ());
+  strcpy (h.linkname, linkname.c_str ());
+  strcpy (h.mode, type == '5' ? "0000755" : "0000644");
+  sprintf (h.size, "%011lo", (unsigned long) data.size ());
+  sprintf (h.mtime, "%011lo", 1700000000UL);
+  h.typeflag = type;
+  memcpy (h.magic, "ustar ", 6);
+  memcpy (h.version, " ", 2);
+  memset (h.chksum, ' ', sizeof h.chksum);
+  unsigned int sum = 0;
+  for (size_t i = 0; i < sizeof h; i++)
+    sum += ((unsigned char *) &h)[i];
+  sprintf (h.chksum, "%06o", sum);
+  out.append ((const char *) &h, sizeof h);
+  out += data;
+  out.append ((512 - data.size () % 512) % 512, '\0');
+}
+
+struct entry
+{
+  std::string name;
+  char type;
+  std::string data;
+  std::string link;
+};
+
+/* usr/share/inway, and in each of dirs directories its own entry, files
+   files, every tenth of them big, and a link of each kind */
+static std::vector<entry>
+package (size_t dirs, size_t files)
+{
+  std::vector<entry> entries;
+  entry e = { "usr/", '5', "", "" };
+  entries.push_back (e);
+  e.name = "usr/share/";
+  entries.push_back (e);
+  e.name = "usr/share/inway";
+  e.type = '0';
+  e.data = contents (e.name, 100);
+  entries.push_back (e);
+  char dir[40], name[80];
+  for (size_t d = 0; d < dirs; d++)
+    {
+      sprintf (dir, "usr/share/pkg%03lu/", (unsigned long) d);
+      e.name = dir;
+      e.type = '5';
+      e.data = "";
+      entries.push_back (e);
+      e.type = '0';
+      for (size_t f = 0; f < files; f++)
+	{
+	  sprintf (name, "%sfile%03lu", dir, (unsigned long) f);
+	  e.name = name;
+	  e.data = contents (name, f % 10 ? 1000 + f : 100000 + f);
+	  entries.push_back (e);
+	}
+      e.name = std::string (dir) + "symlink";
+      e.type = '2';
+      e.data = "";
+      e.link = "file000";
+#ifndef _WIN32
+      entries.push_back (e);
+#endif
+      e.name = std::string (dir) + "hardlink";
+      e.type = '1';
+      e.link = name;
+      entries.push_back (e);
+      e.link = "";
+    }
+  return entries;
+}
+
+static std::string
+tarball (const std::vector<entry> &entries)
+{
+  std::string out;
+  for (size_t i = 0; i < entries.size (); i++)
+    header (out, entries[i].name, entries[i].type, entries[i].data,
+	    entries[i].link);
+  out.append (1024, '\0');
+  return out;
+}
+
+static std::string
+read_all (const std::string &url)
+{
+  io_stream *in = io_stream::open (url, "rb", 0);
+  assert (in);
+  std::string data;
+  char buf[65536];
+  ssize_t got;
+  while ((got = in->read (buf, sizeof buf)) > 0)
+    data.append (buf, got);
+  assert (got == 0);
+  delete in;
+  return data;
+}
+
+int
+main (int argc, char **argv)
+{
+  size_t dirs = argc > 1 ? atoi (argv[1]) : 50;
+  size_t files = argc > 2 ? atoi (argv[2]) : 100;
+
+  NullLog log;
+  LogSingleton::SetInstance (log);
+
+  char root[64];
+  sprintf (root, "CygfilePosixTest.%d", (int) getpid ());
+#ifdef _WIN32
+  assert (!mkdir (root));
+#else
+  assert (!mkdir (root, 0755));
+#endif
+  cygfile_fs_posix fs (root);
+  cygfile_fs::use (&fs);
+
+  /* a directory where a file is to go */
+  assert (!io_stream::mkpath_p (PATH_TO_DIR, "cygfile:///usr/share/inway/sub",
+				0755));
+
+  std::vector<entry> entries = package (dirs, files);
+  std::string tar = tarball (entries);
+  io_stream_memory *mem = new io_stream_memory (tar.data (), tar.size ());
+  archive *in = archive::extract (mem);
+  assert (in);
+  const std::string lstfn = "cygfile:///etc/setup/test.lst.gz";
+  assert (!io_stream::mkpath_p (PATH_TO_FILE, lstfn, 0755));
+  io_stream *out = io_stream::open (lstfn, "wb", 0644);
+  assert (out);
+  ManifestWriter lst (out, ManifestWriter::gzip, 1);
+  extract_context ctx;
+  double start = now ();
+  size_t extracted = 0;
+  std::string fn;
+  while ((fn = in->next_file_name ()).size ())
+    {
+      assert (archive::extract_file (in, "cygfile://", "/", std::string (),
+				     &ctx) == archive::extract_ok);
+      lst.add (fn);
+      extracted++;
+    }
+  assert (lst.close ());
+  double extracting = now () - start;
+  assert (!in->error () && extracted == entries.size ());
+  delete in;
+
+  /* as it should be, with the directory moved out of the way */
+  assert (fs.exists ("/usr/share/inwayold-1/sub"));
+  struct stat st;
+  for (size_t i = 0; i < entries.size (); i++)
+    {
+      const entry &e = entries[i];
+      std::string path = "/" + e.name;
+      std::string url = "cygfile://" + path;
+      std::string where = fs.native (path);
+      assert (io_stream::exists (url));
+      switch (e.type)
+	{
+	case '0':
+	  assert (read_all (url) == e.data);
+	  assert (fs.get_size (path) == e.data.size ());
+	  assert (!stat (where.c_str (), &st) && st.st_mtime == 1700000000);
+	  break;
+	case '1':
+	  assert (read_all (url) == read_all ("cygfile:///" + e.link));
+	  break;
+#ifndef _WIN32
+	case '2':
+	  {
+	    char target[100];
+	    ssize_t len = readlink (where.c_str (), target, sizeof target);
+	    assert (len > 0 && std::string (target, len) == e.link);
+	  }
+	  break;
+#endif
+	case '5':
+	  assert (!stat (where.c_str (), &st) && S_ISDIR (st.st_mode));
+	  break;
+	}
+    }
+
+  /* moved and back */
+  assert (!io_stream::move ("cygfile:///usr/share/inway",
+			    "cygfile:///usr/share/moved"));
+  assert (!io_stream::exists ("cygfile:///usr/share/inway"));
+  assert (read_all ("cygfile:///usr/share/moved") == entries[2].data);
+  assert (!io_stream::move ("cygfile:///usr/share/moved",
+			    "cygfile:///usr/share/inway"));
+
+  /* uninstalled, but for one file, which keeps its directory too */
+  const std::string kept = "usr/share/pkg000/file001";
+  start = now ();
+  io_stream *list = compress::decompress (io_stream::open (lstfn, "rb", 0));
+  remove_listed_files (list, &fs, [&] (const std::string &line)
+		       { return line == kept; });
+  delete list;
+  double removing = now () - start;
+  for (size_t i = 0; i < entries.size (); i++)
+    if (entries[i].type != '5')
+      assert (fs.exists ("/" + entries[i].name) == (entries[i].name == kept));
+  assert (fs.exists ("/usr/share/pkg000"));
+  if (dirs > 1)
+    assert (!fs.exists ("/usr/share/pkg001"));
+
+  assert (!fs.unlink ("/" + kept) && !fs.rmdir ("/usr/share/pkg000"));
+  assert (!fs.rmdir ("/usr/share/inwayold-1/sub"));
+  assert (!fs.rmdir ("/usr/share/inwayold-1"));
+  assert (!fs.rmdir ("/usr/share") && !fs.rmdir ("/usr"));
+  assert (!io_stream::remove (lstfn));
+  assert (!fs.rmdir ("/etc/setup") && !fs.rmdir ("/etc"));
+  assert (!rmdir (root));
+
+  printf ("%lu entries: extracted %.3f s, removed %.3f s\n",
+	  (unsigned long) entries.size (), extracting, removing);
+  return 0;
+}
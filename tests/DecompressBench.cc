@@ -0,0 +1,527 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+/* Compress a synthetic tarball with each codec setup reads, and time
+   compress::decompress () reading it back from an io_stream_memory, in
+   reads of several sizes and, where the codec lends its buffer, in views.
+   Then time extracting it with archive::extract_file () to a null://
+   provider, which keeps nothing, so no time is spent on the filesystem.
+   Any packages named are timed the same way.  xz, lzma and zstd are timed
+   again with each size of buffer given to -b for compress_xz and
+   compress_zstd to read into and decode into; 0 is the size setup uses.
+
+   Each line gives the throughput in MB/s of decompressed data, the
+   operator new calls and bytes made while reading (the codec libraries'
+   own mallocs are not seen), and the process's peak RSS so far.  Peak RSS
+   only grows, so for one codec's give -c.
+
+   Usage: DecompressBench [-m MiB] [-c codec] [-b KiB,...] [package...]
+	  (default: 8 MiB, all of gz bz2 xz lzma zstd, 0,16,256,1024) */
+
+#include "io_stream.h"
+#include "archive.h"
+#include "archive_tar.h"
+#include "compress.h"
+#include "compress_xz.h"
+#include "compress_zstd.h"
+#include "io_stream_memory.h"
+#include "IOStreamProvider.h"
+#include "testutil.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+#include <bzlib.h>
+#include <lzma.h>
+#include <zstd.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+/* operator new, counted */
+static size_t allocations, allocated;
+
+static void *
+counted (size_t size)
+{
+  allocations++;
+  allocated += size;
+  void *p = malloc (size ? size : 1);
+  if (!p)
+    throw std::bad_alloc ();
+  return p;
+}
+
+void *
+operator new (size_t size)
+{
+  return counted (size);
+}
+
+void *
+operator new[] (size_t size)
+{
+  return counted (size);
+}
+
+void
+operator delete (void *p) throw ()
+{
+  free (p);
+}
+
+void
+operator delete[] (void *p) throw ()
+{
+  free (p);
+}
+
+/* a file extracted to null://, which counts what is written to it */
+static size_t extracted;
+
+class null_file : public io_stream
+{
+public:
+  virtual ssize_t read (void *, size_t) { return -1; }
+  virtual ssize_t write (const void *, size_t len)
+  {
+    extracted += len;
+    return len;
+  }
+  virtual ssize_t peek (void *, size_t) { return -1; }
+  virtual long tell () { return 0; }
+  virtual int seek (long, io_stream_seek_t) { return -1; }
+  virtual int error () { return 0; }
+  virtual int set_mtime (time_t) { return 0; }
+  virtual time_t get_mtime () { return 0; }
+  virtual mode_t get_mode () { return 0; }
+  virtual size_t get_size () { return 0; }
+};
+
+class NullProvider : public IOStreamProvider
+{
+public:
+  virtual int exists (const std::string &) const { return 0; }
+  virtual int remove (const std::string &) const { return 0; }
+  virtual int mklink (const std::string &, const std::string &,
+		      io_stream_link_t) const { return 0; }
+  virtual io_stream *open (const std::string &, const std::string &,
+			   mode_t) const { return new null_file; }
+  virtual int move (const std::string &, const std::string &) const
+  {
+    return 0;
+  }
+  virtual int mkdir_p (path_type_t, const std::string &, mode_t) const
+  {
+    return 0;
+  }
+};
+
+static NullProvider null_provider;
+
+/* in KiB */
+static unsigned long
+peak_rss ()
+{
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS pmc;
+  if (GetProcessMemoryInfo (GetCurrentProcess (), &pmc, sizeof pmc))
+    return pmc.PeakWorkingSetSize / 1024;
+  return 0;
+#else
+  struct rusage ru;
+  getrusage (RUSAGE_SELF, &ru);
+  return ru.ru_maxrss;
+#endif
+}
+
+/* Codecs, as the package would be compressed; false if this one cannot
+   be had here */
+
+static bool
+gz (const std::string &in, std::string &out)
+{
+  z_stream strm;
+  memset (&strm, 0, sizeof strm);
+  /* 31: a gzip header */
+  if (deflateInit2 (&strm, 9, Z_DEFLATED, 31, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    return false;
+  out.resize (deflateBound (&strm, in.size ()) + 32);
+  strm.next_in = (Bytef *) in.data ();
+  strm.avail_in = in.size ();
+  strm.next_out = (Bytef *) &out[0];
+  strm.avail_out = out.size ();
+  int ret = deflate (&strm, Z_FINISH);
+  out.resize (strm.total_out);
+  deflateEnd (&strm);
+  return ret == Z_STREAM_END;
+}
+
+static bool
+bz2 (const std::string &in, std::string &out)
+{
+  unsigned int len = in.size () + in.size () / 100 + 600;
+  out.resize (len);
+  if (BZ2_bzBuffToBuffCompress (&out[0], &len, (char *) in.data (),
+				in.size (), 9, 0, 0) != BZ_OK)
+    return false;
+  out.resize (len);
+  return true;
+}
+
+static bool
+lzma_code_all (lzma_stream *strm, const std::string &in, std::string &out)
+{
+  out.resize (lzma_stream_buffer_bound (in.size ()));
+  strm->next_in = (const uint8_t *) in.data ();
+  strm->avail_in = in.size ();
+  strm->next_out = (uint8_t *) &out[0];
+  strm->avail_out = out.size ();
+  lzma_ret ret = lzma_code (strm, LZMA_FINISH);
+  out.resize (out.size () - strm->avail_out);
+  lzma_end (strm);
+  return ret == LZMA_STREAM_END;
+}
+
+static bool
+xz (const std::string &in, std::string &out)
+{
+  lzma_stream strm = LZMA_STREAM_INIT;
+  if (lzma_easy_encoder (&strm, 6, LZMA_CHECK_CRC64) != LZMA_OK)
+    return false;
+  return lzma_code_all (&strm, in, out);
+}
+
+static bool
+lzma (const std::string &in, std::string &out)
+{
+  lzma_stream strm = LZMA_STREAM_INIT;
+  lzma_options_lzma options;
+  if (lzma_lzma_preset (&options, 6)
+      || lzma_alone_encoder (&strm, &options) != LZMA_OK)
+    return false;
+  return lzma_code_all (&strm, in, out);
+}
+
+static bool
+zstd (const std::string &in, std::string &out)
+{
+  out.resize (ZSTD_compressBound (in.size ()));
+  size_t len = ZSTD_compress (&out[0], out.size (), in.data (), in.size (),
+			      19);
+  if (ZSTD_isError (len))
+    return false;
+  out.resize (len);
+  return true;
+}
+
+static const struct
+{
+  const char *name;
+  bool (*compress) (const std::string &, std::string &);
+} codecs[] = {
+  { "gz", gz },
+  { "bz2", bz2 },
+  { "xz", xz },
+  { "lzma", lzma },
+  { "zstd", zstd },
+};
+
+/* text-like files, which compress about as well as a package's do */
+static std::string
+tarball (size_t size)
+{
+  static const char *words[] = { "usr", "share", "doc", "lib", "include",
+				 "the", "of", "and", "int", "return",
+				 "static", "const", "char", "void", "size" };
+  std::string out;
+  unsigned int r = 1;
+  char name[100];
+  for (int n = 0; out.size () < size; n++)
+    {
+      std::string data;
+      size_t len = 200 + (n * 7919) % (n % 20 ? 8000 : 200000);
+      while (data.size () < len)
+	{
+	  r = r * 1103515245 + 12345;
+	  data += words[(r >> 16) % 15];
+	  data += (r >> 8) % 7 ? ' ' : '\n';
+	}
+      sprintf (name, "usr/share/doc/pkg%03d/file%05d", n / 100, n);
+
+      tar_header_type h;
+      memset (&h, 0, sizeof h);
+      strcpy (h.name, name);
+      strcpy (h.mode, "0000644");
+      sprintf (h.size, "%011lo", (unsigned long) data.size ());
+      sprintf (h.mtime, "%011lo", 1700000000UL);
+      h.typeflag = '0';
+      memcpy (h.magic, "ustar ", 6);
+      memcpy (h.version, " ", 2);
+      memset (h.chksum, ' ', sizeof h.chksum);
+      unsigned int sum = 0;
+      for (size_t i = 0; i < sizeof h; i++)
+	sum += ((unsigned char *) &h)[i];
+      sprintf (h.chksum, "%06o", sum);
+      out.append ((const char *) &h, sizeof h);
+      out += data;
+      out.append ((512 - data.size () % 512) % 512, '\0');
+    }
+  out.append (1024, '\0');
+  return out;
+}
+
+/* the buffer sizes setup uses */
+static const size_t xz_in_default = compress_xz::in_block_size;
+static const size_t xz_out_default = compress_xz::out_block_size;
+
+/* buffers of kib KiB for the codecs which take a size, or the defaults
+   if 0 */
+static void
+set_buffers (size_t kib)
+{
+  compress_xz::in_block_size = kib ? kib << 10 : xz_in_default;
+  compress_xz::out_block_size = kib ? kib << 10 : xz_out_default;
+  compress_zstd::in_block_size = kib << 10;
+  compress_zstd::out_block_size = kib << 10;
+}
+
+/* whether name is of a codec set_buffers () makes a difference to */
+static bool
+has_buffers (const char *name)
+{
+  return strstr (name, "xz") || strstr (name, "lzma") || strstr (name, "zst");
+}
+
+static io_stream *
+memory (const std::string &s)
+{
+  io_stream_memory *mem = new io_stream_memory;
+  mem->write (s.data (), s.size ());
+  mem->seek (0, IO_SEEK_SET);
+  return mem;
+}
+
+static void
+report (const char *name, const char *how, size_t bytes, double secs,
+	size_t news, size_t newbytes)
+{
+  printf ("%-24s %-14s %8.1f MB/s %8lu news %10lu bytes %8lu KiB peak RSS\n",
+	  name, how, bytes / 1e6 / (secs > 0 ? secs : 1e-9),
+	  (unsigned long) news, (unsigned long) newbytes,
+	  peak_rss ());
+}
+
+/* decompress compressed, which is deleted, in reads of size, or in views
+   if size is 0; the number of bytes, or -1 on error */
+static ssize_t
+decompress (io_stream *compressed, size_t size, char *buffer)
+{
+  io_stream *in = compress::decompress (compressed);
+  if (!in)
+    {
+      delete compressed;
+      return -1;
+    }
+  if (!size && !in->lends ())
+    {
+      delete in;
+      return 0;
+    }
+  ssize_t total = 0, got;
+  const void *view;
+  while ((got = size ? in->read (buffer, size)
+		     : in->read_view (&view, 1 << 20)) > 0)
+    {
+      if (!size)
+	in->consume (got);
+      total += got;
+    }
+  delete in;
+  return got < 0 ? -1 : total;
+}
+
+/* time every way of reading compressed, which holds a tarball; false on
+   any error */
+static bool
+bench (const char *name, const std::string &compressed)
+{
+  static const struct
+  {
+    const char *how;
+    size_t size;
+  } reads[] = {
+    { "4 KiB reads", 4096 },
+    { "64 KiB reads", 65536 },
+    { "1 MiB reads", 1 << 20 },
+    { "views", 0 },
+  };
+  char *buffer = (char *) malloc (1 << 20);
+  ssize_t plain = -1;
+  for (size_t r = 0; r < sizeof reads / sizeof *reads; r++)
+    {
+      io_stream *mem = memory (compressed);
+      allocations = allocated = 0;
+      double start = now ();
+      ssize_t got = decompress (mem, reads[r].size, buffer);
+      double secs = now () - start;
+      size_t news = allocations, newbytes = allocated;
+      if (got < 0 || (plain >= 0 && got && got != plain))
+	{
+	  printf ("%-24s %-14s failed\n", name, reads[r].how);
+	  free (buffer);
+	  return false;
+	}
+      if (got)
+	report (name, reads[r].how, got, secs, news, newbytes);
+      plain = got ? got : plain;
+    }
+  free (buffer);
+
+  io_stream *mem = memory (compressed);
+  allocations = allocated = extracted = 0;
+  double start = now ();
+  io_stream *in = compress::decompress (mem);
+  if (!in)
+    delete mem;
+  archive *tar = in ? archive::extract (in) : NULL;
+  if (in && !tar)
+    delete in;
+  size_t files = 0;
+  bool ok = tar != NULL;
+  while (ok && tar->next_file_name ().size ())
+    {
+      ok = archive::extract_file (tar, "null://", "/") == archive::extract_ok;
+      files++;
+    }
+  ok = ok && !tar->error ();
+  double secs = now () - start;
+  size_t news = allocations, newbytes = allocated;
+  delete tar;
+  if (!ok)
+    {
+      printf ("%-24s %-14s failed\n", name, "extract");
+      return false;
+    }
+  char how[32];
+  sprintf (how, "extract %lu", (unsigned long) files);
+  report (name, how, extracted, secs, news, newbytes);
+  return true;
+}
+
+/* bench, once with each size of buffers if the codec takes one */
+static bool
+bench_buffers (const char *name, const std::string &compressed,
+	       const std::vector<size_t> &buffers)
+{
+  if (!has_buffers (name))
+    return bench (name, compressed);
+  bool ok = true;
+  for (size_t b = 0; b < buffers.size (); b++)
+    {
+      std::string label = name;
+      if (buffers[b])
+	{
+	  char kib[32];
+	  sprintf (kib, " %luK buf", (unsigned long) buffers[b]);
+	  label += kib;
+	}
+      set_buffers (buffers[b]);
+      ok = bench (label.c_str (), compressed) && ok;
+    }
+  set_buffers (0);
+  return ok;
+}
+
+int
+main (int argc, char **argv)
+{
+  size_t mib = 8;
+  const char *only = NULL;
+  const char *sizes = "0,16,256,1024";
+  int i = 1;
+  for (; i + 1 < argc && argv[i][0] == '-'; i += 2)
+    if (!strcmp (argv[i], "-m"))
+      mib = atoi (argv[i + 1]);
+    else if (!strcmp (argv[i], "-c"))
+      only = argv[i + 1];
+    else if (!strcmp (argv[i], "-b"))
+      sizes = argv[i + 1];
+  std::vector<size_t> buffers;
+  for (const char *p = sizes; *p; p += *p == ',')
+    {
+      char *end;
+      buffers.push_back (strtoul (p, &end, 10));
+      if (end == p)
+	{
+	  fprintf (stderr, "bad buffer sizes: %s\n", sizes);
+	  return 1;
+	}
+      p = end;
+    }
+  if (buffers.empty ())
+    buffers.push_back (0);
+
+  NullLog log;
+  LogSingleton::SetInstance (log);
+  io_stream::registerProvider (null_provider, "null://");
+
+  bool ok = true;
+  std::string plain = tarball (mib << 20);
+  for (size_t c = 0; c < sizeof codecs / sizeof *codecs; c++)
+    {
+      if (only && strcmp (only, codecs[c].name))
+	continue;
+      std::string compressed;
+      if (!codecs[c].compress (plain, compressed))
+	{
+	  printf ("%-24s cannot compress here, skipped\n", codecs[c].name);
+	  continue;
+	}
+      char name[64];
+      sprintf (name, "%s %lu MiB", codecs[c].name, (unsigned long) mib);
+      ok = bench_buffers (name, compressed, buffers) && ok;
+    }
+
+  /* packages */
+  for (; i < argc; i++)
+    {
+      FILE *f = fopen (argv[i], "rb");
+      if (!f)
+	{
+	  perror (argv[i]);
+	  ok = false;
+	  continue;
+	}
+      std::string compressed;
+      char buf[65536];
+      size_t n;
+      while ((n = fread (buf, 1, sizeof buf, f)) > 0)
+	compressed.append (buf, n);
+      fclose (f);
+      const char *base = strrchr (argv[i], '/');
+      ok = bench_buffers (base ? base + 1 : argv[i], compressed, buffers)
+	   && ok;
+    }
+  return ok ? 0 : 1;
+}
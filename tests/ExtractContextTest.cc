@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+/* Extract a synthetic package of many files in many directories with
+   archive::extract_file () to a count:// provider, which keeps a set of
+   the paths it has and counts the calls made on it, and check what is
+   extracted is the same with an extract_context as without, with fewer
+   calls: each directory made once, nothing removed from a directory just
+   made, but what was there before, or was written already, removed as it
+   always was.  Files big enough are preallocated their size.
+
+   Usage: ExtractContextTest [directories [files]]  (default: 200, 100) */
+
+#include "io_stream.h"
+#include "archive.h"
+#include "archive_tar.h"
+#include "io_stream_memory.h"
+#include "IOStreamProvider.h"
+#include "testutil.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <set>
+#include <string>
+
+/* what count:// has, and what was asked of it */
+static std::set<std::string> present;
+static struct
+{
+  size_t exists, remove, mkdir_p, open, preallocate, preallocated;
+} calls;
+
+static void
+make_dirs (std::string path)
+{
+  std::string::size_type slash;
+  while ((slash = path.rfind ('/')) != std::string::npos && slash)
+    {
+      path.erase (slash);
+      present.insert (path);
+    }
+}
+
+class count_file : public io_stream
+{
+public:
+  virtual ssize_t read (void *, size_t) { return -1; }
+  virtual ssize_t write (const void *, size_t len) { return len; }
+  virtual ssize_t peek (void *, size_t) { return -1; }
+  virtual long tell () { return 0; }
+  virtual int seek (long, io_stream_seek_t) { return -1; }
+  virtual int preallocate (size_t len)
+  {
+    calls.preallocate++;
+    calls.preallocated += len;
+    return 0;
+  }
+  virtual int error () { return 0; }
+  virtual int set_mtime (time_t) { return 0; }
+  virtual time_t get_mtime () { return 0; }
+  virtual mode_t get_mode () { return 0; }
+  virtual size_t get_size () { return 0; }
+};
+
+class CountProvider : public IOStreamProvider
+{
+public:
+  virtual int exists (const std::string &path) const
+  {
+    calls.exists++;
+    return present.count (path);
+  }
+  virtual int remove (const std::string &path) const
+  {
+    calls.remove++;
+    present.erase (path);
+    return 0;
+  }
+  virtual int mklink (const std::string &from, const std::string &,
+		      io_stream_link_t) const
+  {
+    present.insert (from);
+    return 0;
+  }
+  virtual io_stream *open (const std::string &path, const std::string &,
+			   mode_t) const
+  {
+    calls.open++;
+    present.insert (path);
+    return new count_file;
+  }
+  virtual int move (const std::string &, const std::string &) const
+  {
+    return 0;
+  }
+  virtual int mkdir_p (path_type_t isadir, const std::string &path,
+		       mode_t) const
+  {
+    calls.mkdir_p++;
+    make_dirs (isadir == PATH_TO_DIR ? path + "/" : path);
+    return 0;
+  }
+};
+
+static CountProvider count_provider;
+
+static void
+header (std::string &out, const std::string &name, char type, size_t size,
+	const std::string &linkname = "")
+{
+  tar_header_type h;
+  memset (&h, 0, sizeof h);
+  strcpy (h.name, name.c_str ());
+  strcpy (h.linkname, linkname.c_str ());
+  strcpy (h.mode, "0000644");
+  sprintf (h.size, "%011lo", (unsigned long) size);
+  sprintf (h.mtime, "%011lo", 1700000000UL);
+  h.typeflag = type;
+  memcpy (h.magic, "ustar ", 6);
+  memcpy (h.version, " ", 2);
+  memset (h.chksum, ' ', sizeof h.chksum);
+  unsigned int sum = 0;
+  for (size_t i = 0; i < sizeof h; i++)
+    sum += ((unsigned char *) &h)[i];
+  sprintf (h.chksum, "%06o", sum);
+  out.append ((const char *) &h, sizeof h);
+  out.append (size, 'x');
+  out.append ((512 - size % 512) % 512, '\0');
+}
+
+/* usr/share/README, and in each of dirs directories under usr/share its
+   own entry, files files, every tenth of them big, and a link of each
+   kind; the number of entries in *entries, and of big bytes in *big */
+static std::string
+package (size_t dirs, size_t files, size_t *entries, size_t *big)
+{
+  std::string out;
+  char dir[40], name[80];
+  header (out, "usr/", '5', 0);
+  header (out, "usr/share/", '5', 0);
+  header (out, "usr/share/README", '0', 100);
+  *entries = 3;
+  *big = 0;
+  for (size_t d = 0; d < dirs; d++)
+    {
+      sprintf (dir, "usr/share/pkg%03lu/", (unsigned long) d);
+      header (out, dir, '5', 0);
+      for (size_t f = 0; f < files; f++)
+	{
+	  sprintf (name, "%sfile%03lu", dir, (unsigned long) f);
+	  size_t size = f % 10 ? 1000 : 100000 + f;
+	  header (out, name, '0', size);
+	  if (size > 65536)
+	    *big += size;
+	}
+      header (out, std::string (dir) + "symlink", '2', 0, "file000");
+      header (out, std::string (dir) + "hardlink", '1', 0, name);
+      *entries += files + 3;
+    }
+  out.append (1024, '\0');
+  return out;
+}
+
+/* every entry extracted as it should be */
+static bool
+extract (const std::string &tarball, extract_context *ctx)
+{
+  io_stream_memory *mem = new io_stream_memory (tarball.data (),
+						tarball.size ());
+  archive *tar = archive::extract (mem);
+  assert (tar);
+  bool ok = true;
+  while (ok && tar->next_file_name ().size ())
+    ok = archive::extract_file (tar, "count://", "/", std::string (),
+				ctx) == archive::extract_ok;
+  ok = ok && !tar->error ();
+  delete tar;
+  return ok;
+}
+
+static void
+report (const char *how)
+{
+  printf ("%-28s %6lu exists %6lu remove %6lu mkdir_p %6lu open "
+	  "%4lu preallocate\n", how, (unsigned long) calls.exists,
+	  (unsigned long) calls.remove, (unsigned long) calls.mkdir_p,
+	  (unsigned long) calls.open, (unsigned long) calls.preallocate);
+}
+
+int
+main (int argc, char **argv)
+{
+  size_t dirs = argc > 1 ? atoi (argv[1]) : 200;
+  size_t files = argc > 2 ? atoi (argv[2]) : 100;
+
+  NullLog log;
+  LogSingleton::SetInstance (log);
+  io_stream::registerProvider (count_provider, "count://");
+
+  size_t entries, big;
+  std::string tarball = package (dirs, files, &entries, &big);
+  size_t written = dirs * (files + 2) + 1;
+  size_t bigfiles = dirs * ((files + 9) / 10);
+
+  /* as it was: a mkdir_p for every entry, a remove for every file */
+  std::set<std::string> before;
+  before.insert ("/usr");
+  before.insert ("/usr/share");
+  before.insert ("/usr/share/README");
+  present = before;
+  memset (&calls, 0, sizeof calls);
+  assert (extract (tarball, NULL));
+  report ("without a context");
+  assert (calls.mkdir_p == entries && calls.remove == written);
+  assert (calls.open == dirs * files + 1 && calls.preallocate == bigfiles);
+  assert (calls.preallocated == big);
+  std::set<std::string> want = present;
+
+  /* the same, with each directory made once and nothing removed from the
+     new ones; README was there before, so it still is */
+  present = before;
+  memset (&calls, 0, sizeof calls);
+  extract_context ctx;
+  assert (extract (tarball, &ctx));
+  report ("into a new directory");
+  assert (present == want);
+  assert (calls.mkdir_p == dirs + 2 && calls.remove == 1);
+  assert (calls.open == dirs * files + 1 && calls.preallocate == bigfiles);
+
+  /* again, as a second package writing the same files would: every
+     directory is known, but every file was written, so is removed */
+  memset (&calls, 0, sizeof calls);
+  assert (extract (tarball, &ctx));
+  report ("over what it wrote");
+  assert (present == want);
+  assert (calls.mkdir_p == 0 && calls.exists == 0 && calls.remove == written);
+
+  /* and as if the directories were there already */
+  present = want;
+  memset (&calls, 0, sizeof calls);
+  extract_context old;
+  assert (extract (tarball, &old));
+  report ("into an existing directory");
+  assert (present == want);
+  assert (calls.mkdir_p == dirs + 2 && calls.remove == written);
+  return 0;
+}
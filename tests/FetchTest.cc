@@ -0,0 +1,383 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+/* Fetch packages into a scratch cache as download.cc does, several at
+   once on a ThreadPool, each job handing back its fetch_result.  The
+   mirrors are served from a scratch directory by a stand-in for
+   NetIO_IE5: one of them lacks some packages, another has a corrupt copy
+   of one, and no mirror has a good copy of the last.  Check every good
+   package is cached and validated, the bad one left nowhere, and a cache
+   which can't be written is reported as such rather than as a failure.
+
+   Then fetch a file in ranges from several mirrors, some of which ignore
+   range requests or drop the connection, and resume an interrupted
+   download from what it left behind.  A package is resumed the same way,
+   from its .tmp file in the cache, unless what was left there doesn't
+   match the package's hash. */
+
+#include "fetch.h"
+#include "netio.h"
+#include "package_source.h"
+#include "threadpool.h"
+#include "io_stream.h"
+#include "csu_util/rfc1738.h"
+#include "csu_util/SHA512Sum.h"
+#include "testutil.h"
+
+#include <assert.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+/* http://host/path is served from here + "/host/path" */
+static std::string served_from;
+/* hosts which answer a range request with the whole file, as a server
+   answering 200 rather than 206 does */
+static std::set<std::string> ignores_ranges;
+/* hosts whose connection drops after sending this many bytes */
+static std::map<std::string, long long> drops_after;
+
+/* As a server would: the file from range_offset on, if asked for, and
+   only range_length bytes of it, if that is given. */
+class NetIO_Local : public NetIO
+{
+public:
+  NetIO_Local (FILE *f, long long range_offset, long long range_length,
+	       long long drop)
+    : f (f), left (range_length), drop (drop)
+  {
+    if (range_offset && _fseeki64 (f, range_offset, SEEK_SET))
+      left = 0;
+    else
+      offset = range_offset;
+  }
+  virtual ~NetIO_Local () { fclose (f); }
+  virtual int ok () { return 1; }
+  virtual int read (char *buf, int nbytes)
+  {
+    if (left && nbytes > left)
+      nbytes = left;
+    if (drop >= 0 && nbytes > drop)
+      nbytes = drop;
+    int got = nbytes ? fread (buf, 1, nbytes, f) : 0;
+    if (left)
+      left -= got;
+    if (drop >= 0)
+      drop -= got;
+    return got;
+  }
+private:
+  FILE *f;
+  long long left;
+  long long drop;
+};
+
+NetIO *
+NetIO::open (char const *url, bool cachable, long long range_offset,
+	     long long range_length)
+{
+  if (strncmp (url, "http://", 7))
+    return NULL;
+  std::string host (url + 7, strcspn (url + 7, "/"));
+  FILE *f = fopen ((served_from + "/" + (url + 7)).c_str (), "rb");
+  if (!f)
+    return NULL;
+  if (ignores_ranges.count (host))
+    range_offset = range_length = 0;
+  std::map<std::string, long long>::const_iterator d = drops_after.find (host);
+  return new NetIO_Local (f, range_offset, range_length,
+			  d == drops_after.end () ? -1 : d->second);
+}
+
+int
+NetIO::ok ()
+{
+  return 0;
+}
+
+int
+NetIO::read (char *buf, int nbytes)
+{
+  return 0;
+}
+
+static std::string
+mirror (int m)
+{
+  char key[40];
+  sprintf (key, "http://mirror%d/", m);
+  return key;
+}
+
+static std::string
+contents (size_t n, size_t size)
+{
+  std::string data (size, '\0');
+  unsigned int x = n * 2654435761U + 1;
+  for (size_t i = 0; i < size; i++)
+    {
+      x = x * 1103515245 + 12345;
+      data[i] = x >> 16;
+    }
+  return data;
+}
+
+static void
+write_file (const std::string &path, const std::string &data)
+{
+  assert (!io_stream::mkpath_p (PATH_TO_FILE, "file://" + path, 0));
+  FILE *f = fopen (path.c_str (), "wb");
+  assert (f);
+  assert (fwrite (data.data (), 1, data.size (), f) == data.size ());
+  fclose (f);
+}
+
+static std::string
+read_file (const std::string &path)
+{
+  std::string data;
+  FILE *f = fopen (path.c_str (), "rb");
+  if (!f)
+    return data;
+  char buf[65536];
+  size_t got;
+  while ((got = fread (buf, 1, sizeof buf, f)) > 0)
+    data.append (buf, got);
+  fclose (f);
+  return data;
+}
+
+static void
+remove_tree (const std::string &path)
+{
+  DIR *d = opendir (path.c_str ());
+  if (!d)
+    {
+      unlink (path.c_str ());
+      return;
+    }
+  struct dirent *e;
+  while ((e = readdir (d)))
+    if (strcmp (e->d_name, ".") && strcmp (e->d_name, ".."))
+      remove_tree (path + "/" + e->d_name);
+  closedir (d);
+  rmdir (path.c_str ());
+}
+
+/* where fetch_package () puts pkgsource from mirror m */
+static std::string
+cached_at (const std::string &cache, const packagesource &pkgsource, int m)
+{
+  return cache + "/" + rfc1738_escape_part (mirror (m)) + "/"
+	 + pkgsource.Canonical ();
+}
+
+static void
+describe (packagesource &pkgsource, const std::string &name,
+	  const std::string &data, int mirrors)
+{
+  pkgsource.set_canonical (name.c_str ());
+  pkgsource.size = data.size ();
+  SHA512Sum sum;
+  sum.append ((const unsigned char *) data.data (), data.size ());
+  sum.finish (pkgsource.sha512sum);
+  pkgsource.sha512_isSet = true;
+  for (int m = 0; m < mirrors; m++)
+    pkgsource.sites.push_back (site (mirror (m)));
+}
+
+int
+main ()
+{
+  NullLog log;
+  LogSingleton::SetInstance (log);
+
+  char cwd[1024];
+  assert (getcwd (cwd, sizeof cwd));
+  char root[1100];
+  sprintf (root, "%s/FetchTest.%d", cwd, (int) getpid ());
+  served_from = std::string (root) + "/srv";
+  const std::string cache = std::string (root) + "/cache";
+
+  /* mirror0 lacks every third package, mirror1 has a corrupt copy of
+     package 2, and the last package is corrupt everywhere */
+  const size_t npackages = 9;
+  std::vector<std::string> data (npackages);
+  std::vector<packagesource> sources (npackages);
+  long long total = 0;
+  for (size_t i = 0; i < npackages; i++)
+    {
+      char name[80];
+      sprintf (name, "x86_64/release/pkg%lu/pkg%lu-1.tar.xz",
+	       (unsigned long) i, (unsigned long) i);
+      data[i] = contents (i, 100000 + i * 7919);
+      describe (sources[i], name, data[i], 3);
+      total += data[i].size ();
+      for (int m = 0; m < 3; m++)
+	{
+	  std::string copy = data[i];
+	  if ((m == 1 && i == 2) || i == npackages - 1)
+	    copy[copy.size () / 2] ^= 1;
+	  if (m != 0 || i % 3 != 1)
+	    write_file (served_from + "/mirror" + (char) ('0' + m) + "/" + name,
+			copy);
+	}
+    }
+
+  /* as download_packages (): each job starts at its own mirror */
+  std::vector<fetch_result> results (npackages);
+  std::vector<std::string> failed_files (npackages);
+  volatile long long fetched = 0;
+  {
+    ThreadPool pool (4);
+    for (size_t i = 0; i < npackages; i++)
+      pool.submit ([&sources, &results, &failed_files, &cache, &fetched, i] () {
+	results[i] = fetch_package (sources[i], cache, i, false, &fetched,
+				    failed_files[i]);
+      });
+  }
+
+  for (size_t i = 0; i < npackages - 1; i++)
+    {
+      assert (results[i] == fetch_ok);
+      assert (sources[i].Cached () && sources[i].Validated ());
+      std::string cached = sources[i].Cached ();
+      assert (cached.substr (0, 7) == "file://");
+      assert (read_file (cached.substr (7)) == data[i]);
+    }
+  packagesource &bad = sources[npackages - 1];
+  assert (results[npackages - 1] == fetch_failed);
+  assert (!bad.Cached ());
+  for (int m = 0; m < 3; m++)
+    {
+      assert (!io_stream::exists ("file://" + cached_at (cache, bad, m)));
+      assert (!io_stream::exists ("file://" + cached_at (cache, bad, m)
+				  + ".tmp"));
+    }
+  /* every copy fetched counts, the corrupt ones too */
+  assert (fetched >= total);
+  const long long fetched_packages = fetched;
+
+  /* nowhere to put it */
+  const std::string blocked = std::string (root) + "/blocked";
+  write_file (blocked, "not a directory");
+  packagesource unwritable;
+  describe (unwritable, sources[0].Canonical (), data[0], 3);
+  std::string failed_file;
+  assert (fetch_package (unwritable, blocked, 0, false, &fetched, failed_file)
+	  == fetch_cant_write);
+  assert (failed_file == cached_at (blocked, unwritable, 0) + ".tmp");
+  assert (!unwritable.Cached ());
+
+  /* in a range from each of three mirrors */
+  const std::string &file = data[0];
+  const std::string name = sources[0].Canonical ();
+  std::vector<std::string> urls;
+  for (int m = 0; m < 3; m++)
+    urls.push_back (mirror (m) + name);
+  const std::string split = std::string (root) + "/split";
+  fetched = 0;
+  assert (fetch_ranges_to_file (urls, split, file.size (), NULL, &fetched)
+	  == fetch_ok);
+  assert (read_file (split) == file && fetched == (long long) file.size ());
+
+  /* one mirror answering 200, another dropping the connection: their
+     ranges come from the others, and are only counted once */
+  ignores_ranges.insert ("mirror1");
+  drops_after["mirror2"] = 5000;
+  fetched = 0;
+  assert (fetch_ranges_to_file (urls, split, file.size (), NULL, &fetched)
+	  == fetch_ok);
+  assert (read_file (split) == file && fetched == (long long) file.size ());
+
+  /* and no mirror able to: nothing left behind */
+  drops_after["mirror0"] = 5000;
+  assert (fetch_ranges_to_file (urls, split, file.size (), NULL, &fetched)
+	  == fetch_failed);
+  assert (!io_stream::exists ("file://" + split));
+
+  /* interrupted, leaving part of the file behind, then resumed from
+     there with a range request */
+  const std::string tmp = std::string (root) + "/resumed.tmp";
+  fetched = 0;
+  drops_after["mirror0"] = 30000;
+  assert (fetch_to_file (urls[0], tmp, file.size (), NULL, &fetched)
+	  == fetch_failed);
+  assert (read_file (tmp) == file.substr (0, 30000) && fetched == 30000);
+  drops_after.erase ("mirror0");
+  fetched = 0;
+  assert (fetch_to_file (urls[0], tmp, file.size (), NULL, &fetched)
+	  == fetch_ok);
+  assert (read_file (tmp) == file && fetched == (long long) file.size ());
+
+  /* resumed from a mirror which ignores the range: from the start */
+  write_file (tmp, file.substr (0, 30000));
+  assert (fetch_to_file (urls[1], tmp, file.size (), NULL, &fetched)
+	  == fetch_ok);
+  assert (read_file (tmp) == file);
+
+  /* a package left part fetched: only the rest of it comes from mirror0,
+     which drops the connection after that much, and the whole is checked */
+  const std::string resumed = std::string (root) + "/resume";
+  const std::string &pkg = data[3];
+  packagesource partial;
+  describe (partial, sources[3].Canonical (), pkg, 3);
+  write_file (cached_at (resumed, partial, 0) + ".tmp", pkg.substr (0, 40000));
+  drops_after["mirror0"] = pkg.size () - 40000;
+  fetched = 0;
+  assert (fetch_package (partial, resumed, 0, false, &fetched, failed_file)
+	  == fetch_ok);
+  assert (partial.Cached () && partial.Validated ());
+  assert (read_file (cached_at (resumed, partial, 0)) == pkg);
+  assert (fetched == (long long) pkg.size ());
+
+  /* left corrupt: resumed all the same, but rejected and deleted, and
+     fetched whole from the next mirror */
+  packagesource corrupt;
+  describe (corrupt, sources[3].Canonical (), pkg, 3);
+  remove_tree (resumed);
+  std::string bad_start = pkg.substr (0, 40000);
+  bad_start[1000] ^= 1;
+  write_file (cached_at (resumed, corrupt, 0) + ".tmp", bad_start);
+  assert (fetch_package (corrupt, resumed, 0, false, &fetched, failed_file)
+	  == fetch_ok);
+  assert (corrupt.Cached () == "file://" + cached_at (resumed, corrupt, 1));
+  assert (read_file (cached_at (resumed, corrupt, 1)) == pkg);
+  assert (!io_stream::exists ("file://" + cached_at (resumed, corrupt, 0)));
+  assert (!io_stream::exists ("file://" + cached_at (resumed, corrupt, 0)
+			      + ".tmp"));
+
+  /* and with no other mirror to go to, nothing is left */
+  packagesource only;
+  describe (only, sources[3].Canonical (), pkg, 1);
+  remove_tree (resumed);
+  write_file (cached_at (resumed, only, 0) + ".tmp", bad_start);
+  assert (fetch_package (only, resumed, 0, false, &fetched, failed_file)
+	  == fetch_failed);
+  assert (!only.Cached ());
+  assert (!io_stream::exists ("file://" + cached_at (resumed, only, 0)));
+  assert (!io_stream::exists ("file://" + cached_at (resumed, only, 0)
+			      + ".tmp"));
+  drops_after.erase ("mirror0");
+
+  remove_tree (root);
+  printf ("%lu packages fetched from 3 mirrors, %lld bytes\n",
+	  (unsigned long) npackages - 1, fetched_packages);
+  return 0;
+}
@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+/* Build a FileIndex of 1000 packages of 100 files each, write it out and
+   read it back, check the owners of some paths and time looking up every
+   one, then uninstall and reinstall packages on top of it and check that
+   survives being written out and read back too.  Check a table is only
+   taken for the packages and versions it was written for.
+
+   Usage: FileIndexTest [packages]  (default: 1000) */
+
+#include "file_index.h"
+#include "io_stream.h"
+#include "io_stream_memory.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+
+#define FILES_PER_PACKAGE 100
+
+static std::string
+package (int i)
+{
+  char name[32];
+  sprintf (name, "pkg%04d", i);
+  return name;
+}
+
+static std::string
+path (int i, int j)
+{
+  char p[64];
+  sprintf (p, "usr/share/pkg%04d/file%03d", i, j);
+  return p;
+}
+
+static bool
+owned_by (FileIndex const &files, const std::string &p, const char *a,
+	  const char *b = NULL)
+{
+  std::vector <std::string> o = files.owners (p);
+  if (o.size () != (size_t) (a ? 1 : 0) + (b ? 1 : 0))
+    return false;
+  if (a && std::find (o.begin (), o.end (), a) == o.end ())
+    return false;
+  if (b && std::find (o.begin (), o.end (), b) == o.end ())
+    return false;
+  return true;
+}
+
+static void
+round_trip (FileIndex &from, FileIndex &to)
+{
+  io_stream_memory mem;
+  bool written = from.write (&mem);
+  assert (written);
+  mem.seek (0, IO_SEEK_SET);
+  bool read = to.read (&mem);
+  assert (read);
+}
+
+int
+main (int argc, char **argv)
+{
+  int npackages = argc > 1 ? atoi (argv[1]) : 1000;
+  assert (npackages >= 3);
+
+  FileIndex built;
+  for (int i = 0; i < npackages; i++)
+    {
+      built.begin (package (i), "1.0-1");
+      built.add (package (i), "usr/");
+      built.add (package (i), "usr/share/");
+      for (int j = 0; j < FILES_PER_PACKAGE; j++)
+	built.add (package (i), path (i, j));
+    }
+  built.add (package (1), "usr/bin/shared.exe");
+  built.add (package (2), "usr/bin/shared.exe");
+  size_t npaths = (size_t) npackages * FILES_PER_PACKAGE + 3;
+  assert (built.size () == npaths);
+
+  FileIndex files;
+  round_trip (built, files);
+  assert (files.size () == npaths);
+  assert (owned_by (files, path (0, 0), "pkg0000"));
+  assert (owned_by (files, path (npackages - 1, FILES_PER_PACKAGE - 1),
+		    package (npackages - 1).c_str ()));
+  assert (owned_by (files, "usr/bin/shared.exe", "pkg0001", "pkg0002"));
+  assert (files.owners ("usr/").size () == (size_t) npackages);
+  assert (owned_by (files, "usr/share/pkg0000/file", NULL));
+  assert (owned_by (files, "", NULL));
+  assert (owned_by (files, "zzz", NULL));
+
+  /* every package's own files, in order */
+  std::vector <std::string> queries;
+  for (int i = 0; i < npackages; i++)
+    for (int j = 0; j < FILES_PER_PACKAGE; j++)
+      queries.push_back (path (i, j));
+  clock_t start = clock ();
+  size_t found = 0;
+  for (size_t q = 0; q < queries.size (); q++)
+    found += files.owners (queries[q]).size ();
+  double secs = (double) (clock () - start) / CLOCKS_PER_SEC;
+  double us = secs * 1e6 / queries.size ();
+  printf ("%lu paths: %.3f s to look up each, %.2f us apiece\n",
+	  (unsigned long) queries.size (), secs, us);
+  assert (found == queries.size ());
+  assert (us < 100);
+
+  /* uninstall one owner of the shared file, and reinstall the other
+     with a different set of files */
+  files.remove ("pkg0001");
+  assert (owned_by (files, path (1, 0), NULL));
+  assert (owned_by (files, "usr/bin/shared.exe", "pkg0002"));
+  files.begin ("pkg0002", "1.1-1");
+  assert (owned_by (files, "usr/bin/shared.exe", NULL));
+  assert (owned_by (files, path (2, 0), NULL));
+  files.add ("pkg0002", "usr/bin/shared.exe");
+  files.add ("pkg0002", "usr/bin/pkg0002.exe");
+  files.begin ("newpkg", "1.0-1");
+  files.add ("newpkg", "usr/bin/shared.exe");
+  assert (owned_by (files, "usr/bin/shared.exe", "pkg0002", "newpkg"));
+
+  FileIndex again;
+  round_trip (files, again);
+  size_t expect = npaths - 2 * FILES_PER_PACKAGE + 1;
+  assert (files.size () == expect);
+  assert (again.size () == expect);
+  assert (owned_by (again, path (0, 0), "pkg0000"));
+  assert (owned_by (again, path (1, 0), NULL));
+  assert (owned_by (again, path (2, 0), NULL));
+  assert (owned_by (again, "usr/bin/pkg0002.exe", "pkg0002"));
+  assert (owned_by (again, "usr/bin/shared.exe", "pkg0002", "newpkg"));
+  assert (again.owners ("usr/").size () == (size_t) npackages - 2);
+
+  /* only for what was installed when it was written */
+  FileIndex::package_versions installed;
+  for (int i = 0; i < npackages; i++)
+    if (i != 1)
+      installed[package (i)] = i == 2 ? "1.1-1" : "1.0-1";
+  installed["newpkg"] = "1.0-1";
+  assert (again.matches (installed));
+  installed[package (0)] = "1.0-2";
+  assert (!again.matches (installed));
+  installed[package (0)] = "1.0-1";
+  installed.erase ("newpkg");
+  assert (!again.matches (installed));
+  installed["newpkg"] = "1.0-1";
+  installed[package (1)] = "1.0-1";
+  assert (!again.matches (installed));
+
+  /* a truncated table is refused */
+  io_stream_memory mem;
+  again.write (&mem);
+  io_stream_memory truncated;
+  char *copy = new char[mem.get_size ()];
+  mem.seek (0, IO_SEEK_SET);
+  mem.read (copy, mem.get_size ());
+  truncated.write (copy, mem.get_size () - 1);
+  delete[] copy;
+  truncated.seek (0, IO_SEEK_SET);
+  FileIndex damaged;
+  assert (!damaged.read (&truncated));
+  assert (damaged.size () == 0);
+  return 0;
+}
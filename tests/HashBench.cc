@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+/* Check that SHA512Sum agrees with the reference code in sha2.c, then
+   compare their throughput, and that of MD5Sum.
+
+   Usage: HashBench [megabytes]  (default 64) */
+
+#include "csu_util/SHA512Sum.h"
+#include "csu_util/MD5Sum.h"
+#include "sha2.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static void
+reference (const unsigned char *data, size_t len,
+	   unsigned char digest[SHA512_DIGEST_LENGTH])
+{
+  SHA2_CTX ctx;
+  SHA512Init (&ctx);
+  SHA512Update (&ctx, data, len);
+  SHA512Final (digest, &ctx);
+}
+
+/* hash data in pieces of at most step bytes */
+static void
+accelerated (const unsigned char *data, size_t len, size_t step,
+	     unsigned char digest[SHA512_DIGEST_LENGTH])
+{
+  SHA512Sum sha;
+  for (size_t done = 0; done < len; done += step)
+    sha.append (data + done, len - done < step ? len - done : step);
+  sha.finish (digest);
+}
+
+static void
+check (const unsigned char *data, size_t len)
+{
+  unsigned char want[SHA512_DIGEST_LENGTH], got[SHA512_DIGEST_LENGTH];
+  reference (data, len, want);
+
+  static const size_t steps[] = { 1, 7, 64, 127, 128, 129, 65536 };
+  for (size_t i = 0; i < sizeof (steps) / sizeof (steps[0]); i++)
+    {
+      accelerated (data, len, steps[i], got);
+      if (memcmp (want, got, sizeof want))
+	{
+	  fprintf (stderr, "SHA512 mismatch: length %u, step %u\n",
+		   (unsigned int) len, (unsigned int) steps[i]);
+	  exit (1);
+	}
+    }
+}
+
+static double
+seconds_since (clock_t start)
+{
+  double s = (double) (clock () - start) / CLOCKS_PER_SEC;
+  return s > 0 ? s : 1e-6;
+}
+
+static void
+report (const char *what, size_t bytes, double secs)
+{
+  printf ("%-24s %8.3f GB/s\n", what, bytes / secs / 1e9);
+}
+
+int
+main (int argc, char **argv)
+{
+  size_t megabytes = argc > 1 ? atoi (argv[1]) : 64;
+  size_t size = megabytes * 1024 * 1024;
+  if (size < 4096)
+    size = 4096;
+
+  unsigned char *data = new unsigned char[size];
+  unsigned int seed = 12345;
+  for (size_t i = 0; i < size; i++)
+    {
+      seed = seed * 1103515245 + 12345;
+      data[i] = seed >> 16;
+    }
+
+  /* FIPS 180-2 example */
+  static const char abc_sum[] =
+    "ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a"
+    "2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f";
+  unsigned char abc[SHA512_DIGEST_LENGTH];
+  char abc_str[SHA512_DIGEST_STRING_LENGTH];
+  accelerated ((const unsigned char *) "abc", 3, 3, abc);
+  for (int i = 0; i < SHA512_DIGEST_LENGTH; i++)
+    sprintf (abc_str + 2 * i, "%02x", abc[i]);
+  assert (strcmp (abc_str, abc_sum) == 0);
+
+  for (size_t len = 0; len <= 300; len++)
+    check (data, len);
+  check (data, 4096);
+
+  SHA512Sum probe;
+  printf ("SHA512Sum backend: %s\n",
+	  probe.accelerated () ? "libgcrypt" : "sha2.c");
+
+  unsigned char digest[SHA512_DIGEST_LENGTH];
+  clock_t start = clock ();
+  reference (data, size, digest);
+  report ("SHA512 (sha2.c)", size, seconds_since (start));
+
+  start = clock ();
+  accelerated (data, size, 64 * 1024, digest);
+  report ("SHA512 (SHA512Sum)", size, seconds_since (start));
+
+  start = clock ();
+  MD5Sum md5;
+  md5.begin ();
+  for (size_t done = 0; done < size; done += 64 * 1024)
+    md5.append (data + done, size - done < 64 * 1024 ? size - done : 64 * 1024);
+  md5.finish ();
+  report ("MD5 (MD5Sum)", size, seconds_since (start));
+
+  delete[] data;
+  return 0;
+}
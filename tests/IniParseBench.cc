@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+/* Parse a setup.ini and count the heap allocations made while doing so,
+   which should be no more than the blocks of the token arena.  Then time
+   the warm start: a recording of the parse saved as the package index
+   cache, loaded back and replayed.  Check that a recording keeps the
+   setup-minimum-version verdict from its target until replay ().
+
+   Usage: IniParseBench [setup.ini]  (default: a generated one) */
+
+#include "ini.h"
+#include "IniBuffer.h"
+#include "IniDBBuilderLint.h"
+#include "IniDBBuilderRecorder.h"
+#include "IniParseFeedback.h"
+#include "io_stream.h"
+#include "io_stream_memory.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <new>
+
+static unsigned long allocations;
+
+void *
+operator new (size_t size)
+{
+  allocations++;
+  void *p = malloc (size ? size : 1);
+  if (!p)
+    throw std::bad_alloc ();
+  return p;
+}
+
+void
+operator delete (void *p) noexcept
+{
+  free (p);
+}
+
+class QuietFeedback : public IniParseFeedback
+{
+public:
+  QuietFeedback () : quiet (false), errors (0), line (0) {}
+  virtual void progress (unsigned long const, unsigned long const) {}
+  virtual void iniName (const std::string& ) {}
+  virtual void babble (const std::string& ) const {}
+  virtual void warning (const std::string& ) const {}
+  virtual void show_errors () const {}
+  virtual void note_error (int lineno, const std::string &s)
+    {
+      if (!quiet)
+	fprintf (stderr, "line %d: %s\n", lineno, s.c_str ());
+      errors++;
+      line = lineno;
+    }
+  virtual bool has_errors () const { return errors > 0; }
+  bool quiet;
+  int errors;
+  int line;
+};
+
+class CountingBuilder : public IniDBBuilderLint
+{
+public:
+  CountingBuilder () : packages (0), nodes (0), minimums (0) {}
+  virtual void buildPackage (const char *) { packages++; }
+  virtual void buildPackageListNode (const char *) { nodes++; }
+  /* as IniDBBuilderPackage, for a setup of version 3 */
+  virtual const std::string buildMinimumVersion (const char *s)
+    {
+      minimums++;
+      return strcmp (s, "3") > 0 ? std::string ("needs setup ") + s : "";
+    }
+  unsigned long packages;
+  unsigned long nodes;
+  unsigned long minimums;
+};
+
+/* a parse into a recording, as ini.cc's IniJob has it */
+struct RecordedParse
+{
+  RecordedParse () : recorder (builder, &parser), parser (&recorder, feedback)
+    {}
+  CountingBuilder builder;
+  QuietFeedback feedback;
+  IniDBBuilderRecorder recorder;
+  IniParser parser;
+};
+
+static void
+generate (io_stream *out, int npackages)
+{
+  char line[512];
+  int n = sprintf (line, "release: cygwin\narch: x86_64\n"
+		   "setup-timestamp: 1700000000\nsetup-version: 2.926\n"
+		   "setup-minimum-version: 2.900\n\n");
+  out->write (line, n);
+  for (int i = 0; i < npackages; i++)
+    {
+      n = sprintf (line, "@ package-number-%d\n"
+		   "sdesc: \"Package %d, which is a generated test package\"\n"
+		   "ldesc: \"Package %d exists to give the setup.ini parser "
+		   "something of a realistic size to chew on, with a long "
+		   "description which wraps onto more than one line\"\n"
+		   "category: Base Libs Devel\n"
+		   "requires: cygwin libgcc1 package-number-%d\n"
+		   "depends2: cygwin, libgcc1 (>= 7.4.0), package-number-%d\n",
+		   i, i, i, i / 2, i / 3);
+      out->write (line, n);
+      for (int v = 0; v < 2; v++)
+	{
+	  n = sprintf (line, "%sversion: %d.%d-1\n"
+		       "install: x86_64/release/package-number-%d/"
+		       "package-number-%d-%d.%d-1.tar.xz %d ",
+		       v ? "[prev]\n" : "", i, v, i, i, i, v, 1000 + i);
+	  out->write (line, n);
+	  for (int h = 0; h < 128; h++)
+	    line[h] = "0123456789abcdef"[(i * 31 + h * 7 + v) & 15];
+	  line[128] = '\n';
+	  out->write (line, 129);
+	}
+      out->write ("\n", 1);
+    }
+}
+
+static void
+text (IniBuffer &ini, const std::string &s)
+{
+  io_stream_memory source (s.data (), s.size ());
+  bool read = ini.read (&source);
+  assert (read);
+}
+
+int
+main (int argc, char **argv)
+{
+  io_stream_memory source;
+  if (argc > 1)
+    {
+      FILE *f = fopen (argv[1], "rb");
+      if (!f)
+	{
+	  perror (argv[1]);
+	  return 1;
+	}
+      char buf[65536];
+      size_t got;
+      while ((got = fread (buf, 1, sizeof buf, f)) > 0)
+	source.write (buf, got);
+      fclose (f);
+    }
+  else
+    generate (&source, 5000);
+  source.seek (0, IO_SEEK_SET);
+
+  IniBuffer ini;
+  bool read = ini.read (&source);
+  assert (read);
+
+  QuietFeedback feedback;
+  CountingBuilder builder;
+  IniParser parser (&builder, feedback);
+
+  unsigned long before = allocations;
+  clock_t start = clock ();
+  int failed = parser.parse (ini);
+  double secs = (double) (clock () - start) / CLOCKS_PER_SEC;
+  unsigned long made = allocations - before;
+
+  printf ("%lu bytes, %lu packages, %lu dependencies in %.3f s\n",
+	  (unsigned long) ini.size (), builder.packages, builder.nodes, secs);
+  printf ("%lu heap allocations, %lu of them arena blocks\n",
+	  made, (unsigned long) parser.tokens.blocks ());
+
+  assert (!failed && !feedback.has_errors ());
+  assert (builder.packages > 0);
+  /* Everything the scanner hands out comes from the arena; allow a
+     little for the library's own bookkeeping. */
+  assert (made <= parser.tokens.blocks () + 16);
+
+  CountingBuilder replayed;
+  IniDBBuilderRecorder recorder (replayed);
+  IniParser recording (&recorder, feedback);
+  failed = recording.parse (ini);
+  assert (!failed);
+  io_stream_memory saved;
+  bool written = recorder.save (&saved, "key");
+  assert (written);
+  saved.seek (0, IO_SEEK_SET);
+
+  IniBuffer index;
+  read = index.read (&saved);
+  assert (read);
+  IniDBBuilderRecorder stale (replayed);
+  assert (!stale.load (index.data (), index.size (), "other key"));
+  assert (!stale.load (index.data (), index.size () - 1, "key"));
+
+  start = clock ();
+  IniDBBuilderRecorder loaded (replayed);
+  bool ok = loaded.load (index.data (), index.size (), "key");
+  loaded.replay ();
+  secs = (double) (clock () - start) / CLOCKS_PER_SEC;
+  printf ("%lu byte index loaded and replayed in %.3f s\n",
+	  (unsigned long) index.size (), secs);
+
+  assert (ok);
+  assert (replayed.packages == builder.packages);
+  assert (replayed.nodes == builder.nodes);
+  assert (builder.minimums == 1 && replayed.minimums == 1);
+
+  /* too new for this setup: the parse is clean, and replay () says so,
+     where parsing straight into the builder would have */
+  const std::string too_new = "release: cygwin\narch: x86_64\n"
+    "setup-minimum-version: 3.1\n\n@ one\nversion: 1-1\n";
+  IniBuffer too_new_ini, too_new_copy;
+  text (too_new_ini, too_new);
+  text (too_new_copy, too_new);
+  QuietFeedback direct_feedback, replay_feedback;
+  direct_feedback.quiet = replay_feedback.quiet = true;
+  CountingBuilder direct;
+  IniParser direct_parse (&direct, direct_feedback);
+  direct_parse.parse (too_new_copy);
+  assert (direct_feedback.has_errors ());
+
+  RecordedParse later;
+  failed = later.parser.parse (too_new_ini);
+  assert (!failed && !later.feedback.has_errors ());
+  assert (later.builder.minimums == 0 && later.builder.packages == 0);
+  later.recorder.replay (&replay_feedback);
+  assert (later.builder.minimums == 1 && later.builder.packages == 1);
+  assert (replay_feedback.has_errors ()
+	  && replay_feedback.line == direct_feedback.line);
+  return 0;
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+/* Read a synthetic installed.db of 10000 packages, line by line with
+   sscanf () and parse_filename () as packagedb::read () used to, and
+   with InstalledDbReader, check that both find the same packages and
+   versions, and time them.
+
+   Usage: InstalledDbBench [packages]  (default: 10000) */
+
+#include "installed_db.h"
+#include "filemanip.h"
+#include "io_stream.h"
+#include "io_stream_memory.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+struct entry
+{
+  std::string name;
+  std::string ver;
+  int user_picked;
+};
+
+static void
+generate (io_stream *out, int npackages)
+{
+  char line[512];
+  int n = sprintf (line, "INSTALLED.DB 3\n");
+  out->write (line, n);
+  /* in name order, as flush () writes them: some with a hyphen and digit
+     of their own, one a source package */
+  for (int pass = 0; pass < 2; pass++)
+    for (int i = 0; i < npackages; i++)
+      {
+	bool lib = i % 10 == 0 && i != npackages / 2;
+	if (lib != (pass == 0))
+	  continue;
+	if (lib)
+	  n = sprintf (line, "lib-%05d lib-%05d-%d.%d.%d-1.tar.bz2 %d\n", i, i,
+		       i % 5, i % 11, i % 3, i % 2);
+	else if (i == npackages / 2)
+	  n = sprintf (line, "pkg%05d pkg%05d-%d.%d-1-src.tar.xz 0\n", i, i,
+		       i % 7, i % 13);
+	else
+	  n = sprintf (line, "pkg%05d pkg%05d-%d.%d-1.tar.bz2 %d\n", i, i,
+		       i % 7, i % 13, i % 2);
+	out->write (line, n);
+      }
+}
+
+static double
+since (clock_t start)
+{
+  return (double) (clock () - start) / CLOCKS_PER_SEC;
+}
+
+int
+main (int argc, char **argv)
+{
+  int npackages = argc > 1 ? atoi (argv[1]) : 10000;
+  io_stream_memory source;
+  generate (&source, npackages);
+
+  /* as before */
+  std::vector <entry> old_way;
+  source.seek (0, IO_SEEK_SET);
+  clock_t start = clock ();
+  {
+    char line[1000], pkgname[1000], inst[1000];
+    source.gets (line, 1000);
+    while (source.gets (line, 1000))
+      {
+	int user_picked = 0;
+	pkgname[0] = '\0';
+	inst[0] = '\0';
+	int res = sscanf (line, "%s %s %d", pkgname, inst, &user_picked);
+	if (res < 3 || pkgname[0] == '\0' || inst[0] == '\0')
+	  continue;
+	fileparse f;
+	if (!parse_filename (inst, f))
+	  continue;
+	entry e = { pkgname, f.ver, user_picked };
+	old_way.push_back (e);
+      }
+  }
+  double old_secs = since (start);
+
+  std::vector <entry> new_way;
+  source.seek (0, IO_SEEK_SET);
+  start = clock ();
+  {
+    InstalledDbReader db;
+    bool read = db.read (&source);
+    assert (read);
+    assert (db.version () == 3);
+    char *pkgname, *inst;
+    int user_picked;
+    while (db.next (pkgname, inst, user_picked))
+      if (const char *ver = db.version (inst))
+	{
+	  entry e = { pkgname, ver, user_picked };
+	  new_way.push_back (e);
+	}
+  }
+  double new_secs = since (start);
+
+  printf ("%d packages: sscanf %.3f s, InstalledDbReader %.3f s\n",
+	  npackages, old_secs, new_secs);
+  assert (old_way.size () == (size_t) npackages);
+  assert (new_way.size () == old_way.size ());
+  for (size_t i = 0; i < old_way.size (); i++)
+    {
+      if (new_way[i].name != old_way[i].name
+	  || new_way[i].ver != old_way[i].ver
+	  || new_way[i].user_picked != old_way[i].user_picked)
+	{
+	  fprintf (stderr, "line %lu: %s %s %d, expected %s %s %d\n",
+		   (unsigned long) i + 2, new_way[i].name.c_str (),
+		   new_way[i].ver.c_str (), new_way[i].user_picked,
+		   old_way[i].name.c_str (), old_way[i].ver.c_str (),
+		   old_way[i].user_picked);
+	  return 1;
+	}
+    }
+  return 0;
+}
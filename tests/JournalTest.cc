@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+/* Append installed.db journal records as packagedb::journal () does,
+   cutting one short at every length as a crash might, and check that
+   reading the journal back ignores the torn record and finds every whole
+   one, including the one appended after it. */
+
+#include "installed_db.h"
+#include "io_stream.h"
+#include "io_stream_memory.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <map>
+
+typedef std::map <std::string, std::pair <std::string, int> > journal_type;
+
+/* as packagedb::readJournal () */
+static journal_type
+read_journal (const std::string &text)
+{
+  io_stream_memory in (text.data (), text.size ());
+  InstalledDbReader j;
+  bool read = j.read (&in);
+  assert (read);
+  journal_type journal;
+  char *pkgname, *inst;
+  int user_picked;
+  while (j.next (pkgname, inst, user_picked))
+    journal[pkgname] = std::make_pair (std::string (inst), user_picked);
+  return journal;
+}
+
+int
+main ()
+{
+  const std::string before =
+    journal_record ("cygwin cygwin-3.5.0-1.tar.bz2 1\n")
+    + journal_record ("bash - 0\n");
+  const std::string torn = journal_record ("zlib zlib-1.3-1.tar.bz2 0\n");
+  const std::string after = journal_record ("bash bash-5.2-1.tar.bz2 1\n");
+
+  journal_type whole = read_journal (before + torn + after);
+  assert (whole.size () == 3);
+  assert (whole["zlib"].first == "zlib-1.3-1.tar.bz2");
+
+  /* cut anywhere short of its newline, without which it is whole */
+  for (size_t len = 0; len < torn.size () - 1; len++)
+    {
+      journal_type j = read_journal (before + torn.substr (0, len) + after);
+      assert (j.size () == 2);
+      assert (j["cygwin"].first == "cygwin-3.5.0-1.tar.bz2"
+	      && j["cygwin"].second == 1);
+      assert (j["bash"].first == "bash-5.2-1.tar.bz2"
+	      && j["bash"].second == 1);
+      assert (j.find ("zlib") == j.end ());
+    }
+
+  printf ("%lu torn records ignored\n", (unsigned long) torn.size () - 1);
+  return 0;
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+/* Write a manifest of 50000 files as installOne () used to, a line at a
+   time through compress_gz at level 9, and with ManifestWriter at each
+   method, check that compress::decompress () reads back the same lines
+   from all of them, and time them.
+
+   Usage: ManifestBench [files]  (default: 50000) */
+
+#include "manifest.h"
+#include "compress.h"
+#include "compress_gz.h"
+#include "io_stream.h"
+#include "io_stream_memory.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+static double
+since (clock_t start)
+{
+  return (double) (clock () - start) / CLOCKS_PER_SEC;
+}
+
+/* read back the manifest in mem, which is deleted */
+static bool
+same (io_stream_memory *mem, const std::vector <std::string> &files)
+{
+  mem->seek (0, IO_SEEK_SET);
+  io_stream *in = compress::decompress (mem);
+  if (!in)
+    {
+      delete mem;
+      return false;
+    }
+  char line[1024];
+  size_t n = 0;
+  bool ok = true;
+  while (ok && in->gets (line, sizeof line))
+    ok = n < files.size () && files[n++] == line;
+  delete in;
+  return ok && n == files.size ();
+}
+
+int
+main (int argc, char **argv)
+{
+  int nfiles = argc > 1 ? atoi (argv[1]) : 50000;
+  std::vector <std::string> files;
+  char name[256];
+  for (int i = 0; i < nfiles; i++)
+    {
+      sprintf (name, "usr/share/texmf-dist/tex/latex/package%04d/file%05d.sty",
+	       i / 37, i);
+      files.push_back (name);
+    }
+
+  /* as before */
+  io_stream_memory *mem = new io_stream_memory;
+  clock_t start = clock ();
+  {
+    compress_gz lst (mem, "w9");
+    lst.release_original ();
+    for (size_t i = 0; i < files.size (); i++)
+      {
+	std::string tmp = files[i] + "\n";
+	lst.write (tmp.c_str (), tmp.size ());
+      }
+  }
+  printf ("%d files: compress_gz w9 per line %.3f s, %lu bytes\n", nfiles,
+	  since (start), (unsigned long) mem->get_size ());
+  assert (same (mem, files));
+
+  struct
+  {
+    const char *name;
+    ManifestWriter::method how;
+    int level;
+  } methods[] = {
+    { "gzip:1", ManifestWriter::gzip, 1 },
+    { "gzip:9", ManifestWriter::gzip, 9 },
+    { "zstd:3", ManifestWriter::zstd, 3 },
+  };
+  for (size_t m = 0; m < sizeof methods / sizeof *methods; m++)
+    {
+      mem = new io_stream_memory;
+      start = clock ();
+      ManifestWriter lst (mem, methods[m].how, methods[m].level);
+      lst.release_original ();
+      for (size_t i = 0; i < files.size (); i++)
+	lst.add (files[i]);
+      bool closed = lst.close ();
+      assert (closed);
+      printf ("%d files: ManifestWriter %s %.3f s, %lu bytes\n", nfiles,
+	      methods[m].name, since (start), (unsigned long) mem->get_size ());
+      assert (same (mem, files));
+    }
+  return 0;
+}
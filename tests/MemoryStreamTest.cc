@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+/* Write a setup.ini sized io_stream_memory in small pieces, as
+   get_url_to_membuf does, and check it reads, seeks, overwrites and lends
+   its contents as a file would; then that a stream over a borrowed
+   buffer copies it only when written, and that release_buffer () hands
+   the contents over.  Time seeks to random places in it.
+
+   Usage: MemoryStreamTest [MiB]  (default: 5) */
+
+#include "io_stream.h"
+#include "io_stream_memory.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+
+int
+main (int argc, char **argv)
+{
+  size_t size = (argc > 1 ? atoi (argv[1]) : 5) << 20;
+  std::string want (size, '\0');
+  for (size_t i = 0; i < size; i++)
+    want[i] = (char) ('a' + (i * 7 + i / 4096) % 26);
+
+  io_stream_memory mem;
+  for (size_t done = 0; done < size; done += 2048)
+    {
+      size_t n = size - done < 2048 ? size - done : 2048;
+      assert (mem.write (want.data () + done, n) == (ssize_t) n);
+    }
+  assert (mem.get_size () == size && mem.tell () == (long) size);
+  assert (!memcmp (mem.data (), want.data (), size));
+
+  /* seeking, from each end and from here */
+  char buf[100];
+  assert (mem.seek (0, IO_SEEK_SET) == 0 && mem.tell () == 0);
+  assert (mem.read (buf, 10) == 10 && !memcmp (buf, want.data (), 10));
+  assert (mem.seek (-10, IO_SEEK_END) == 0);
+  assert (mem.read (buf, 100) == 10 && !memcmp (buf, want.data () + size - 10, 10));
+  assert (mem.read (buf, 100) == 0);
+  assert (mem.seek (-1000, IO_SEEK_CUR) == 0 && mem.tell () == (long) size - 1000);
+  assert (mem.seek (1, IO_SEEK_END) == -1 && mem.error () == EINVAL);
+  assert (mem.seek (-1, IO_SEEK_SET) == -1);
+  assert (mem.tell () == (long) size - 1000);
+
+  /* overwriting, and writing on past the end */
+  assert (mem.seek (-5, IO_SEEK_END) == 0 && mem.write ("0123456789", 10) == 10);
+  assert (mem.get_size () == size + 5);
+  want.replace (size - 5, 5, "0123456789");
+
+  /* views, skips and peeks */
+  const void *view;
+  assert (mem.seek (100, IO_SEEK_SET) == 0);
+  assert (mem.skip (100) == 100);
+  assert (mem.peek (buf, 10) == 10 && !memcmp (buf, want.data () + 200, 10));
+  ssize_t got = mem.read_view (&view, size * 2);
+  assert (got == (ssize_t) (size + 5 - 200));
+  assert (!memcmp (view, want.data () + 200, got));
+  mem.consume (got);
+  assert (mem.read_view (&view, 10) == 0 && mem.skip (10) == 0);
+
+  /* borrowed, and copied on write */
+  const char text[] = "borrowed text";
+  io_stream_memory borrowed (text, sizeof text - 1);
+  assert (borrowed.data () == text && borrowed.get_size () == sizeof text - 1);
+  assert (borrowed.read_view (&view, 100) == (ssize_t) sizeof text - 1 && view == text);
+  assert (borrowed.seek (0, IO_SEEK_SET) == 0 && borrowed.write ("B", 1) == 1);
+  assert (borrowed.data () != text && !strcmp (text, "borrowed text"));
+  assert (!memcmp (borrowed.data (), "Borrowed text", sizeof text - 1));
+
+  /* handed over, with room after */
+  size_t len;
+  char *p = mem.release_buffer (len, 2);
+  assert (p && len == size + 5 && !memcmp (p, want.data (), len));
+  p[len] = p[len + 1] = '\0';
+  free (p);
+  assert (mem.get_size () == 0 && mem.tell () == 0);
+  p = borrowed.release_buffer (len);
+  assert (p && len == sizeof text - 1);
+  free (p);
+
+  /* seeks to random places, reading a little at each */
+  io_stream_memory big (want.data (), want.size ());
+  srand (1);
+  clock_t start = clock ();
+  const int seeks = 1000000;
+  for (int i = 0; i < seeks; i++)
+    {
+      long at = rand () % (want.size () - 8);
+      assert (big.seek (at, IO_SEEK_SET) == 0 && big.read (buf, 8) == 8);
+      assert (!memcmp (buf, want.data () + at, 8));
+    }
+  printf ("%lu MiB: %d seeks and reads %.3f s\n", (unsigned long) (size >> 20),
+	  seeks, (double) (clock () - start) / CLOCKS_PER_SEC);
+  return 0;
+}
@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+/* Install a queue of small packages and two big ones, a bzip2 and an xz
+   as xz -T writes them, as do_install_thread does: the small ones from
+   an InstallPrefetcher, and the big ones, which it leaves alone, through
+   decompress_package () as installOne does.  Check each decompresses to
+   what it should, and that the big ones are decoded with more threads
+   than the one reading ahead, if there are processors for them, which
+   has read all of the file by the end.
+
+   Usage: PrefetchTest [MiB]  (the size of the big ones; default: 8) */
+
+#include "prefetch.h"
+#include "io_stream.h"
+#include "io_stream_readahead.h"
+#include "package_source.h"
+#include "testutil.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <bzlib.h>
+#include <lzma.h>
+
+#ifdef _WIN32
+#include <tlhelp32.h>
+#else
+#include <dirent.h>
+#endif
+
+/* how many threads this process has */
+static unsigned int
+threads_running ()
+{
+  unsigned int n = 0;
+#ifdef _WIN32
+  HANDLE snap = CreateToolhelp32Snapshot (TH32CS_SNAPTHREAD, 0);
+  THREADENTRY32 te;
+  te.dwSize = sizeof te;
+  if (snap == INVALID_HANDLE_VALUE)
+    return 0;
+  for (BOOL more = Thread32First (snap, &te); more;
+       more = Thread32Next (snap, &te))
+    if (te.th32OwnerProcessID == GetCurrentProcessId ())
+      n++;
+  CloseHandle (snap);
+#else
+  DIR *d = opendir ("/proc/self/task");
+  if (!d)
+    return 0;
+  while (struct dirent *e = readdir (d))
+    if (e->d_name[0] != '.')
+      n++;
+  closedir (d);
+#endif
+  return n;
+}
+
+/* text-like data, which compresses about as well as a package does */
+static std::string
+generate (size_t size, unsigned int seed)
+{
+  static const char *words[] = { "usr", "share", "doc", "lib", "include",
+				 "the", "of", "and", "int", "return",
+				 "static", "const", "char", "void", "size" };
+  std::string s;
+  s.reserve (size + 16);
+  unsigned int r = seed;
+  while (s.size () < size)
+    {
+      r = r * 1103515245 + 12345;
+      s += words[(r >> 16) % 15];
+      s += (r >> 8) % 7 ? ' ' : '\n';
+      if ((r >> 4) % 31 == 0)
+	s += (char) ('A' + (r >> 20) % 26);
+    }
+  s.resize (size);
+  return s;
+}
+
+static std::string
+bzip2 (const std::string &in)
+{
+  unsigned int outlen = in.size () + in.size () / 100 + 600;
+  std::string out (outlen, '\0');
+  int ret = BZ2_bzBuffToBuffCompress (&out[0], &outlen, (char *) in.data (),
+				      in.size (), 9, 0, 0);
+  assert (ret == BZ_OK);
+  out.resize (outlen);
+  return out;
+}
+
+/* in 1 MiB blocks */
+static std::string
+xz (const std::string &in)
+{
+  lzma_stream strm = LZMA_STREAM_INIT;
+  lzma_mt mt;
+  memset (&mt, 0, sizeof mt);
+  mt.threads = lzma_cputhreads () ? lzma_cputhreads () : 1;
+  mt.block_size = 1 << 20;
+  mt.preset = 3;
+  mt.check = LZMA_CHECK_CRC64;
+  lzma_ret ret = lzma_stream_encoder_mt (&strm, &mt);
+  assert (ret == LZMA_OK);
+  std::string out (lzma_stream_buffer_bound (in.size ()), '\0');
+  strm.next_in = (const uint8_t *) in.data ();
+  strm.avail_in = in.size ();
+  strm.next_out = (uint8_t *) &out[0];
+  strm.avail_out = out.size ();
+  ret = lzma_code (&strm, LZMA_FINISH);
+  assert (ret == LZMA_STREAM_END);
+  out.resize (out.size () - strm.avail_out);
+  lzma_end (&strm);
+  return out;
+}
+
+static std::string
+read_all (io_stream *in, unsigned int *most_threads = NULL)
+{
+  std::string data;
+  char buf[65536];
+  ssize_t got;
+  while ((got = in->read (buf, sizeof buf)) > 0)
+    {
+      data.append (buf, got);
+      if (most_threads)
+	*most_threads = std::max (*most_threads, threads_running ());
+    }
+  assert (got == 0);
+  return data;
+}
+
+int
+main (int argc, char **argv)
+{
+  size_t mib = argc > 1 ? atoi (argv[1]) : 8;
+  NullLog log;
+  LogSingleton::SetInstance (log);
+
+  char cwd[1024];
+  assert (getcwd (cwd, sizeof cwd));
+  char root[1100];
+  sprintf (root, "%s/PrefetchTest.%d", cwd, (int) getpid ());
+  assert (!io_stream::mkpath_p (PATH_TO_DIR, std::string ("file://") + root,
+				0755));
+
+  /* every third a big one, alternately bzip2 and xz */
+  const size_t npackages = 9;
+  std::vector<std::string> data (npackages);
+  std::vector<packagesource> sources (npackages);
+  std::vector<packagesource *> queue;
+  size_t small_max = 0;
+  for (size_t i = 0; i < npackages; i++)
+    {
+      bool big = i % 3 == 2;
+      data[i] = generate (big ? mib << 20 : 200000 + i * 1000, i + 1);
+      std::string compressed = big && i % 2 ? xz (data[i]) : bzip2 (data[i]);
+      char name[1200];
+      sprintf (name, "%s/pkg%lu.tar.%s", root, (unsigned long) i,
+	       big && i % 2 ? "xz" : "bz2");
+      FILE *f = fopen (name, "wb");
+      assert (f);
+      assert (fwrite (compressed.data (), 1, compressed.size (), f)
+	      == compressed.size ());
+      fclose (f);
+      sources[i].set_canonical (name);
+      sources[i].set_cached (std::string ("file://") + name);
+      sources[i].size = compressed.size ();
+      queue.push_back (&sources[i]);
+      if (!big)
+	small_max = std::max (small_max, data[i].size ());
+    }
+
+  /* room for four of the small ones at once, and none of the big */
+  InstallPrefetcher *prefetcher =
+    new InstallPrefetcher (queue, small_max, 4 * (long long) small_max);
+  unsigned int threads = ThreadPool::default_size ();
+  for (size_t i = 0; i < npackages; i++)
+    {
+      io_stream *prefetched = prefetcher->take (i);
+      if (i % 3 != 2)
+	{
+	  assert (prefetched);
+	  assert (read_all (prefetched) == data[i]);
+	  delete prefetched;
+	  continue;
+	}
+
+      assert (!prefetched);
+      io_stream *pkgfile = io_stream::open (sources[i].Cached (), "rb", 0);
+      assert (pkgfile);
+      unsigned int before = threads_running ();
+      unsigned int most = before;
+      io_stream_readahead *ahead;
+      io_stream *decompressed = decompress_package (pkgfile, &ahead);
+      assert (decompressed);
+      assert (read_all (decompressed, &most) == data[i]);
+      assert (!ahead == (threads <= 1));
+      assert (!ahead || ahead->source_tell () == (long) sources[i].size);
+      delete decompressed;
+      printf ("%s, %lu MiB: %u threads at most, %u before, %u processors\n",
+	      i % 2 ? "xz" : "bzip2", (unsigned long) mib, most, before,
+	      threads);
+      /* more than the one reading ahead; liblzma only decodes in parallel
+	 from 5.4 */
+#if LZMA_VERSION < 50040002
+      if (i % 2)
+	continue;
+#endif
+      if (threads > 1 && before)
+	assert (most > before + 1);
+    }
+  delete prefetcher;
+
+  for (size_t i = 0; i < npackages; i++)
+    unlink (sources[i].Canonical ());
+  rmdir (root);
+  return 0;
+}
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+/* Read a stream through io_stream_readahead with a few small buffers, by
+   read (), peek (), skip () and views, and check it gives what the stream
+   held, an error where the stream failed, and goes away with its buffers
+   full, and that source_tell () follows what has been read.  Then time a slow stream read by a slow reader, directly and
+   through io_stream_readahead, which should take about as long as the
+   slower of the two rather than both.
+
+   Usage: ReadaheadTest [MiB]  (default: 8) */
+
+#include "io_stream.h"
+#include "io_stream_memory.h"
+#include "io_stream_readahead.h"
+#include "testutil.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+
+static char
+byte_at (size_t at)
+{
+  return (char) ('a' + (at * 7 + at / 1000) % 26);
+}
+
+/* size bytes, chunk at a time, sleeping ms before each; failing with EIO
+   at fail_at if that is short of size */
+class generator : public io_stream
+{
+public:
+  generator (size_t size, size_t chunk, DWORD ms = 0, size_t fail_at = -1)
+    : size (size), chunk (chunk), ms (ms), fail_at (fail_at), at (0),
+      lasterr (0) {}
+  virtual ssize_t read (void *buffer, size_t len)
+  {
+    if (ms)
+      Sleep (ms);
+    if (at >= fail_at)
+      {
+	lasterr = EIO;
+	return -1;
+      }
+    len = std::min (std::min (len, chunk), std::min (size, fail_at) - at);
+    for (size_t i = 0; i < len; i++)
+      ((char *) buffer)[i] = byte_at (at + i);
+    at += len;
+    return len;
+  }
+  virtual ssize_t write (const void *, size_t) { return -1; }
+  virtual ssize_t peek (void *, size_t) { return -1; }
+  virtual long tell () { return at; }
+  virtual int seek (long, io_stream_seek_t) { return -1; }
+  virtual int error () { return lasterr; }
+  virtual int set_mtime (time_t) { return 1; }
+  virtual time_t get_mtime () { return 1700000000; }
+  virtual mode_t get_mode () { return 0644; }
+  virtual size_t get_size () { return 0; }
+private:
+  size_t size, chunk;
+  DWORD ms;
+  size_t fail_at, at;
+  int lasterr;
+};
+
+static bool
+matches (const char *data, size_t at, size_t len)
+{
+  for (size_t i = 0; i < len; i++)
+    if (data[i] != byte_at (at + i))
+      return false;
+  return true;
+}
+
+/* read all of in, slowly if ms; the number of bytes */
+static size_t
+drain (io_stream *in, DWORD ms)
+{
+  char buf[65536];
+  size_t total = 0;
+  ssize_t got;
+  while ((got = in->read (buf, sizeof buf)) > 0)
+    {
+      assert (matches (buf, total, got));
+      total += got;
+      if (ms)
+	Sleep (ms);
+    }
+  assert (got == 0);
+  return total;
+}
+
+int
+main (int argc, char **argv)
+{
+  size_t mib = argc > 1 ? atoi (argv[1]) : 8;
+
+  /* everything, by every means, across buffers of 4 KiB */
+  size_t size = 1000000;
+  io_stream_readahead ra (new generator (size, 3000), 4096, 3);
+  assert (ra.get_mtime () == 1700000000 && ra.get_mode () == 0644);
+  char buf[20000];
+  size_t at = 0;
+  assert (ra.peek (buf, 10000) == 10000 && matches (buf, 0, 10000));
+  assert (ra.peek (buf, 20000) == 3 * 4096 && matches (buf, 0, 3 * 4096));
+  while (at < size)
+    {
+      ssize_t got;
+      const void *view;
+      switch (at / 4000 % 4)
+	{
+	case 0:
+	  got = ra.read (buf, 5000);
+	  assert (got > 0 && matches (buf, at, got));
+	  break;
+	case 1:
+	  got = ra.peek (buf, 7000);
+	  assert (got > 0 && matches (buf, at, got));
+	  got = ra.skip (4500);
+	  break;
+	case 2:
+	  got = ra.read_view (&view, 100000);
+	  assert (got > 0 && got <= 4096 && matches ((const char *) view, at, got));
+	  got = std::min (got, (ssize_t) 3000);
+	  ra.consume (got);
+	  break;
+	default:
+	  got = ra.read (buf, 333);
+	  assert (got > 0 && matches (buf, at, got));
+	}
+      at += got;
+      assert (ra.tell () == (long) at);
+    }
+  assert (at == size && ra.read (buf, 10) == 0 && ra.peek (buf, 10) == 0);
+  assert (!ra.error () && ra.source_tell () == 0);
+
+  /* where its source is, here the stream it reads, which fills every
+     buffer but the last, so that the reader thread's note of it is exact */
+  generator *source = new generator (size, 3000);
+  io_stream_readahead *in = new io_stream_readahead (source, 4096, 3, source);
+  assert (in->source_tell () == 0);
+  at = 0;
+  ssize_t got;
+  while ((got = in->read (buf, 5000)) > 0)
+    {
+      at += got;
+      assert (in->source_tell () == (long) at);
+    }
+  assert (at == size && in->source_tell () == (long) size);
+  delete in;
+
+  /* by io_stream::copy (), which takes views */
+  in = new io_stream_readahead (new generator (size, 70000), 65536, 2);
+  io_stream_memory out;
+  assert (in->lends () && !io_stream::copy (in, &out));
+  assert (out.get_size () == size && matches (out.data (), 0, size));
+  delete in;
+
+  /* everything up to the failure, then the failure */
+  in = new io_stream_readahead (new generator (size, 3000, 0, 100000), 4096, 3);
+  at = 0;
+  while ((got = in->read (buf, 5000)) > 0)
+    at += got;
+  assert (got == -1 && at == 100000 && in->error () == EIO);
+  delete in;
+
+  /* gone while its reader waits on full buffers, and while it reads */
+  in = new io_stream_readahead (new generator (size, 3000), 4096, 3);
+  assert (in->read (buf, 10) == 10);
+  Sleep (50);
+  delete in;
+  in = new io_stream_readahead (new generator (size, 3000, 20), 4096, 3);
+  delete in;
+
+  /* a reader as slow as what it reads */
+  size = mib << 20;
+  double start = now ();
+  in = new io_stream_readahead (new generator (size, 65536, 1), 65536, 4);
+  assert (drain (in, 1) == size);
+  delete in;
+  double ahead = now () - start;
+  start = now ();
+  generator direct (size, 65536, 1);
+  assert (drain (&direct, 1) == size);
+  double plain = now () - start;
+  printf ("%lu MiB, 1 ms per 64 KiB to produce and to use: directly %.3f s, "
+	  "read ahead %.3f s\n", (unsigned long) mib, plain, ahead);
+  return 0;
+}
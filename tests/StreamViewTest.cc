@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+/* Extract every file of an xz compressed tarball with io_stream::copy (),
+   which takes views of compress_xz's buffer through archive_tar_file, and
+   again through a stream which does not lend, so is read (); check both
+   give the files intact, interleaved with read () and peek ().  Then
+   check that skip_file () after a copy which failed partway, or a read of
+   part of a file, still finds the next, and that a truncated tarball is
+   an error, not a hang.
+
+   Usage: StreamViewTest [files]  (default: 2000) */
+
+#include "archive_tar.h"
+#include "compress_xz.h"
+#include "io_stream.h"
+#include "io_stream_memory.h"
+#include "testutil.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+static void
+header (std::string &out, const std::string &name, size_t size)
+{
+  tar_header_type h;
+  memset (&h, 0, sizeof h);
+  memcpy (h.name, name.data (), std::min (name.size (), sizeof h.name));
+  strcpy (h.mode, "0000644");
+  sprintf (h.size, "%011lo", (unsigned long) size);
+  sprintf (h.mtime, "%011lo", 1700000000UL);
+  h.typeflag = '0';
+  memcpy (h.magic, "ustar ", 6);
+  memcpy (h.version, " ", 2);
+  memset (h.chksum, ' ', sizeof h.chksum);
+  unsigned int sum = 0;
+  for (size_t i = 0; i < sizeof h; i++)
+    sum += ((unsigned char *) &h)[i];
+  sprintf (h.chksum, "%06o", sum);
+  out.append ((const char *) &h, sizeof h);
+}
+
+static std::string
+data (size_t n, size_t size)
+{
+  std::string d (size, '\0');
+  for (size_t i = 0; i < size; i++)
+    d[i] = (char) ('a' + (n * 7 + i * (n % 5 + 1)) % 26);
+  return d;
+}
+
+static std::string
+xz (const std::string &in)
+{
+  std::string out (lzma_stream_buffer_bound (in.size ()), '\0');
+  size_t len = 0;
+  lzma_ret ret = lzma_easy_buffer_encode (1, LZMA_CHECK_CRC32, NULL,
+					  (const uint8_t *) in.data (),
+					  in.size (), (uint8_t *) &out[0],
+					  &len, out.size ());
+  assert (ret == LZMA_OK);
+  out.resize (len);
+  return out;
+}
+
+/* Forwards to another stream, without lending its buffer */
+class borrower : public io_stream
+{
+public:
+  borrower (io_stream *in) : in (in) {}
+  virtual ~borrower () { delete in; }
+  virtual ssize_t read (void *buffer, size_t len) { return in->read (buffer, len); }
+  virtual ssize_t write (const void *, size_t) { return -1; }
+  virtual ssize_t peek (void *buffer, size_t len) { return in->peek (buffer, len); }
+  virtual long tell () { return in->tell (); }
+  virtual int seek (long, io_stream_seek_t) { return -1; }
+  virtual int error () { return in->error (); }
+  virtual int set_mtime (time_t) { return 1; }
+  virtual time_t get_mtime () { return 0; }
+  virtual mode_t get_mode () { return 0; }
+  virtual size_t get_size () { return 0; }
+private:
+  io_stream *in;
+};
+
+/* Takes limit bytes, then fails, as a full disk would */
+class failing_sink : public io_stream
+{
+public:
+  failing_sink (size_t limit) : limit (limit), taken (0) {}
+  virtual ssize_t read (void *, size_t) { return -1; }
+  virtual ssize_t write (const void *, size_t len)
+  {
+    if (taken >= limit)
+      return -1;
+    len = std::min (len, limit - taken);
+    taken += len;
+    return len;
+  }
+  virtual ssize_t peek (void *, size_t) { return -1; }
+  virtual long tell () { return taken; }
+  virtual int seek (long, io_stream_seek_t) { return -1; }
+  virtual int error () { return taken >= limit ? ENOSPC : 0; }
+  virtual int set_mtime (time_t) { return 1; }
+  virtual time_t get_mtime () { return 0; }
+  virtual mode_t get_mode () { return 0; }
+  virtual size_t get_size () { return 0; }
+private:
+  size_t limit, taken;
+};
+
+static io_stream *
+memory (const std::string &s)
+{
+  io_stream_memory *mem = new io_stream_memory;
+  mem->write (s.data (), s.size ());
+  mem->seek (0, IO_SEEK_SET);
+  return mem;
+}
+
+/* extract every file of compressed, checking each against sizes; the
+   number extracted.  If partial, every other file is left partway through
+   instead, by a copy which fails or a read, and skipped. */
+static size_t
+extract (const std::string &compressed, const std::vector <size_t> &sizes,
+	 bool lend, bool partial = false)
+{
+  io_stream *in = new compress_xz (memory (compressed));
+  if (!lend)
+    in = new borrower (in);
+  assert (in->lends () == lend);
+  archive_tar tar (in);
+  std::string name;
+  size_t n = 0;
+  while ((name = tar.next_file_name ()).size ())
+    {
+      assert (n < sizes.size ());
+      std::string want = data (n, sizes[n]);
+      io_stream *f = tar.extract_file ();
+      if (partial && n % 2 && sizes[n] > 1300)
+	{
+	  /* at an offset which is no multiple of 512 */
+	  if (n % 4 == 1)
+	    {
+	      failing_sink sink (1000 + n % 300);
+	      assert (io_stream::copy (f, &sink));
+	    }
+	  else
+	    {
+	      char buf[1000];
+	      assert (f->read (buf, 999) == 999
+		      && !memcmp (buf, want.data (), 999));
+	    }
+	  delete f;
+	  n++;
+	  if (tar.skip_file ())
+	    break;
+	  continue;
+	}
+      io_stream_memory out;
+      size_t done = 0;
+      /* start some files with a peek, and a read of an odd length */
+      if (n % 3 == 0 && sizes[n] > 10)
+	{
+	  char buf[10];
+	  assert (f->peek (buf, 10) == 10 && !memcmp (buf, want.data (), 10));
+	  assert (f->read (buf, 7) == 7 && !memcmp (buf, want.data (), 7));
+	  done = 7;
+	}
+      if (io_stream::copy (f, &out))
+	{
+	  delete f;
+	  break;
+	}
+      delete f;
+      assert (out.get_size () == sizes[n] - done);
+      std::string got (out.get_size (), '\0');
+      out.seek (0, IO_SEEK_SET);
+      assert (out.read (&got[0], got.size ()) == (ssize_t) got.size ());
+      assert (got == want.substr (done));
+      n++;
+      if (tar.skip_file ())
+	break;
+    }
+  return n;
+}
+
+int
+main (int argc, char **argv)
+{
+  int nfiles = argc > 1 ? atoi (argv[1]) : 2000;
+  NullLog log;
+  LogSingleton::SetInstance (log);
+
+  std::string tarball;
+  std::vector <size_t> sizes;
+  char name[100];
+  for (int i = 0; i < nfiles; i++)
+    {
+      /* mostly small, some spanning several of compress_xz's blocks */
+      size_t size = i % 50 == 0 ? 200000 + i : (i * 7919) % 3000;
+      sprintf (name, "usr/share/doc/file%05d", i);
+      header (tarball, name, size);
+      tarball += data (i, size);
+      tarball.append ((512 - size % 512) % 512, '\0');
+      sizes.push_back (size);
+    }
+  tarball.append (1024, '\0');
+  std::string compressed = xz (tarball);
+
+  assert (extract (compressed, sizes, true) == sizes.size ());
+  assert (extract (compressed, sizes, false) == sizes.size ());
+  assert (extract (compressed, sizes, true, true) == sizes.size ());
+  assert (extract (compressed, sizes, false, true) == sizes.size ());
+
+  /* an io_stream_memory lends its own buffer */
+  io_stream *mem = memory (tarball);
+  io_stream_memory copy;
+  assert (mem->lends () && !io_stream::copy (mem, &copy));
+  assert (copy.get_size () == tarball.size ());
+  delete mem;
+
+  /* cut short, the last file extracted is an error */
+  std::string truncated = compressed.substr (0, compressed.size () / 2);
+  size_t n = extract (truncated, sizes, true);
+  assert (n > 0 && n < sizes.size ());
+  printf ("%d files extracted from views and from reads; %lu before the "
+	  "truncation\n", nfiles, (unsigned long) n);
+  return 0;
+}
@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+/* Build a tarball of 20000 small files in memory, and list it with
+   archive_tar, skipping every file, as the parent stream used to be
+   skipped a block at a time, with large reads, and with seeks.  Check
+   each way finds the same files, and that files read back intact,
+   including one with a long name and one with a base-256 size.
+
+   Usage: TarBench [files]  (default: 20000) */
+
+#include "archive_tar.h"
+#include "io_stream.h"
+#include "io_stream_memory.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+struct entry
+{
+  std::string name;
+  size_t size;
+  /* of its contents, as data () makes them */
+  size_t seed;
+};
+
+static void
+header (io_stream *out, const std::string &name, char type, size_t size,
+	bool base256 = false)
+{
+  tar_header_type h;
+  memset (&h, 0, sizeof h);
+  memcpy (h.name, name.data (), std::min (name.size (), sizeof h.name));
+  strcpy (h.mode, "0000644");
+  strcpy (h.uid, "0001750");
+  strcpy (h.gid, "0001750");
+  if (base256)
+    {
+      h.size[0] = (char) 0x80;
+      for (int i = 11; i > 0; i--, size >>= 8)
+	h.size[i] = (char) (size & 0xff);
+    }
+  else
+    sprintf (h.size, "%011lo", (unsigned long) size);
+  sprintf (h.mtime, "%011lo", 1700000000UL);
+  h.typeflag = type;
+  memcpy (h.magic, "ustar ", 6);
+  memcpy (h.version, " ", 2);
+  memset (h.chksum, ' ', sizeof h.chksum);
+  unsigned int sum = 0;
+  for (size_t i = 0; i < sizeof h; i++)
+    sum += ((unsigned char *) &h)[i];
+  sprintf (h.chksum, "%06o", sum);
+  out->write (&h, sizeof h);
+}
+
+static void
+contents (io_stream *out, const std::string &data)
+{
+  static const char zeros[512] = { 0 };
+  out->write (data.data (), data.size ());
+  if (data.size () % 512)
+    out->write (zeros, 512 - data.size () % 512);
+}
+
+static std::string
+data (size_t n, size_t size)
+{
+  std::string d (size, '\0');
+  for (size_t i = 0; i < size; i++)
+    d[i] = (char) ('a' + (n * 7 + i) % 26);
+  return d;
+}
+
+static void
+generate (io_stream *out, int nfiles, std::vector <entry> &expect)
+{
+  char name[100];
+  /* the metadata installOne skips */
+  header (out, ".PKGINFO", '0', 300);
+  contents (out, data (0, 300));
+  for (int i = 0; i < nfiles; i++)
+    {
+      if (i % 100 == 0)
+	{
+	  sprintf (name, "usr/share/doc/pkg%03d/", i / 100);
+	  header (out, name, '5', 0);
+	  entry e = { name, 0, 0 };
+	  expect.push_back (e);
+	}
+      sprintf (name, "usr/share/doc/pkg%03d/file%05d.txt", i / 100, i);
+      size_t size = 100 + (i * 7919) % 3000;
+      header (out, name, '0', size);
+      contents (out, data (i, size));
+      entry e = { name, size, (size_t) i };
+      expect.push_back (e);
+    }
+
+  std::string longname = "usr/share/" + std::string (150, 'x') + "/long";
+  header (out, "././@LongLink", 'L', longname.size () + 1);
+  contents (out, longname + '\0');
+  header (out, longname.substr (0, 99), '0', 5000);
+  contents (out, data (nfiles, 5000));
+  entry l = { longname, 5000, (size_t) nfiles };
+  expect.push_back (l);
+
+  header (out, "usr/share/big", '0', 1000, true);
+  contents (out, data (nfiles + 1, 1000));
+  entry b = { "usr/share/big", 1000, (size_t) nfiles + 1 };
+  expect.push_back (b);
+
+  static const char end[1024] = { 0 };
+  out->write (end, sizeof end);
+}
+
+/* Forwards to an io_stream_memory, without its skip (), so that it is
+   skipped by reading; as before, a block at a time if blockwise. */
+class unseekable : public io_stream
+{
+public:
+  unseekable (io_stream *in, bool blockwise) : in (in), blockwise (blockwise) {}
+  virtual ssize_t read (void *buffer, size_t len) { return in->read (buffer, len); }
+  virtual ssize_t write (const void *, size_t) { return -1; }
+  virtual ssize_t peek (void *buffer, size_t len) { return in->peek (buffer, len); }
+  virtual long tell () { return in->tell (); }
+  virtual int seek (long, io_stream_seek_t) { return -1; }
+  virtual ssize_t skip (size_t len)
+  {
+    if (!blockwise)
+      return io_stream::skip (len);
+    char buf[512];
+    size_t done = 0;
+    while (done < len && in->read (buf, 512) == 512)
+      done += 512;
+    return done;
+  }
+  virtual int error () { return in->error (); }
+  virtual int set_mtime (time_t) { return 1; }
+  virtual time_t get_mtime () { return 0; }
+  virtual mode_t get_mode () { return 0; }
+  virtual size_t get_size () { return in->get_size (); }
+private:
+  io_stream *in;
+  bool blockwise;
+};
+
+/* list the archive, skipping every file, and check it against expect */
+static double
+list (io_stream *tarball, const std::vector <entry> &expect)
+{
+  clock_t start = clock ();
+  archive_tar tar (tarball);
+  std::vector <entry> found;
+  std::string name;
+  while ((name = tar.next_file_name ()).size ())
+    {
+      io_stream *f = tar.extract_file ();
+      entry e = { name, f->get_size (), 0 };
+      delete f;
+      if (name[0] != '.')
+	found.push_back (e);
+      assert (tar.skip_file () == 0);
+    }
+  double secs = (double) (clock () - start) / CLOCKS_PER_SEC;
+  assert (!tar.error ());
+  assert (found.size () == expect.size ());
+  for (size_t i = 0; i < found.size (); i++)
+    assert (found[i].name == expect[i].name
+	    && found[i].size == expect[i].size);
+  return secs;
+}
+
+int
+main (int argc, char **argv)
+{
+  int nfiles = argc > 1 ? atoi (argv[1]) : 20000;
+  io_stream_memory *mem = new io_stream_memory;
+  std::vector <entry> expect;
+  generate (mem, nfiles, expect);
+
+  mem->seek (0, IO_SEEK_SET);
+  double blockwise = list (new unseekable (mem, true), expect);
+  mem->seek (0, IO_SEEK_SET);
+  double reads = list (new unseekable (mem, false), expect);
+  mem->seek (0, IO_SEEK_SET);
+  /* archive_tar deletes its parent, so hand it a copy */
+  io_stream_memory *copy = new io_stream_memory;
+  io_stream::copy (mem, copy);
+  copy->seek (0, IO_SEEK_SET);
+  double seeks = list (copy, expect);
+  printf ("%d files: skipped a block at a time %.3f s, by reading %.3f s, "
+	  "by seeking %.3f s\n", nfiles, blockwise, reads, seeks);
+
+  /* read the first half of every file, in whole blocks, and skip the
+     rest */
+  mem->seek (0, IO_SEEK_SET);
+  archive_tar tar (mem);
+  std::string name;
+  size_t n = 0;
+  char buf[8192];
+  while ((name = tar.next_file_name ()).size ())
+    {
+      if (name[0] == '.')
+	{
+	  tar.skip_file ();
+	  continue;
+	}
+      assert (n < expect.size () && name == expect[n].name);
+      io_stream *f = tar.extract_file ();
+      if (tar.next_file_type () == ARCHIVE_FILE_REGULAR)
+	{
+	  assert (f->get_mode () == 0644 && f->get_mtime () == 1700000000);
+	  size_t half = expect[n].size / 1024 * 512;
+	  ssize_t got = f->read (buf, half);
+	  assert (got == (ssize_t) half);
+	  std::string want = data (expect[n].seed, expect[n].size);
+	  assert (!memcmp (buf, want.data (), half));
+	}
+      delete f;
+      assert (tar.skip_file () == 0);
+      n++;
+    }
+  assert (n == expect.size ());
+  assert (!tar.error ());
+  return 0;
+}
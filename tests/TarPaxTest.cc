@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+/* Read a synthetic tarball using pax extended headers, GNU long names,
+   ustar prefixes and a base-256 mtime with archive_tar, and check the
+   names, link targets, sizes, mtimes and contents it finds.  Then read it again
+   with random damage, many times over, which must never crash or hang.
+
+   Usage: TarPaxTest [rounds]  (default: 20000) */
+
+#include "archive_tar.h"
+#include "io_stream.h"
+#include "io_stream_memory.h"
+#include "testutil.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+static void
+header (std::string &out, const std::string &name, char type, size_t size,
+	const std::string &linkname = "", const std::string &prefix = "",
+	long long mtime = 1000000000)
+{
+  tar_header_type h;
+  memset (&h, 0, sizeof h);
+  memcpy (h.name, name.data (), std::min (name.size (), sizeof h.name));
+  memcpy (h.linkname, linkname.data (),
+	  std::min (linkname.size (), sizeof h.linkname));
+  memcpy (h.prefix, prefix.data (), std::min (prefix.size (), sizeof h.prefix));
+  strcpy (h.mode, "0000755");
+  sprintf (h.size, "%011lo", (unsigned long) size);
+  if (mtime >= 0)
+    sprintf (h.mtime, "%011o", (unsigned int) mtime);
+  else
+    /* base-256, as GNU tar writes an mtime before 1970 */
+    for (int i = sizeof h.mtime - 1; i >= 0; i--, mtime >>= 8)
+      h.mtime[i] = (char) (mtime & 0xff);
+  h.typeflag = type;
+  /* POSIX, so that prefix is used */
+  memcpy (h.magic, "ustar", 6);
+  memcpy (h.version, "00", 2);
+  memset (h.chksum, ' ', sizeof h.chksum);
+  unsigned int sum = 0;
+  for (size_t i = 0; i < sizeof h; i++)
+    sum += ((unsigned char *) &h)[i];
+  sprintf (h.chksum, "%06o", sum);
+  out.append ((const char *) &h, sizeof h);
+}
+
+static void
+contents (std::string &out, const std::string &data)
+{
+  out += data;
+  out.append ((512 - data.size () % 512) % 512, '\0');
+}
+
+/* one pax record, its length counting itself */
+static std::string
+record (const std::string &key, const std::string &value)
+{
+  size_t len = key.size () + value.size () + 3;
+  char digits[32];
+  size_t n = 1;
+  while (sprintf (digits, "%lu", (unsigned long) (len + n)) != (int) n)
+    n++;
+  return std::string (digits) + " " + key + "=" + value + "\n";
+}
+
+static void
+pax (std::string &out, char type, const std::string &records)
+{
+  header (out, "PaxHeaders/x", type, records.size ());
+  contents (out, records);
+}
+
+static std::string
+data (char c, size_t size)
+{
+  return std::string (size, c);
+}
+
+struct member
+{
+  std::string name;
+  archive_file_t type;
+  std::string linkname;
+  size_t size;
+  time_t mtime;
+  long nsec;
+  char fill;
+};
+
+static std::vector <member> expect;
+
+static void
+expected (const std::string &name, archive_file_t type,
+	  const std::string &linkname, size_t size, time_t mtime, long nsec,
+	  char fill)
+{
+  member m = { name, type, linkname, size, mtime, nsec, fill };
+  expect.push_back (m);
+}
+
+static std::string
+generate ()
+{
+  std::string out;
+  std::string longpath = "usr/share/" + std::string (300, 'p') + "/file";
+  std::string longlink = "../" + std::string (200, 'l') + "/target";
+
+  /* a long path, a size the ustar field does not give, and an mtime
+     with a fraction */
+  pax (out, 'x', record ("path", longpath) + record ("size", "1500")
+       + record ("mtime", "1700000000.25") + record ("uid", "1000"));
+  header (out, "truncated", '0', 0);
+  contents (out, data ('a', 1500));
+  expected (longpath, ARCHIVE_FILE_REGULAR, "", 1500, 1700000000, 250000000,
+	    'a');
+
+  pax (out, 'x', record ("linkpath", longlink));
+  header (out, "usr/bin/link", '2', 0, "truncated");
+  expected ("usr/bin/link", ARCHIVE_FILE_SYMLINK, longlink, 0, 1000000000,
+	    0, 0);
+
+  header (out, "file", '0', 10, "", "usr/share/prefixed");
+  contents (out, data ('b', 10));
+  expected ("usr/share/prefixed/file", ARCHIVE_FILE_REGULAR, "", 10,
+	    1000000000, 0, 'b');
+
+  std::string gnulink = "usr/share/" + std::string (150, 'k') + "/file";
+  header (out, "././@LongLink", 'K', gnulink.size () + 1);
+  contents (out, gnulink + '\0');
+  header (out, "usr/bin/hard", '1', 0, "truncated");
+  expected ("usr/bin/hard", ARCHIVE_FILE_HARDLINK, gnulink, 0, 1000000000,
+	    0, 0);
+
+  /* an mtime before 1970 */
+  const long long old = -86400LL * 365 * 10;
+  header (out, "usr/share/old", '0', 20, "", "", old);
+  contents (out, data ('f', 20));
+  expected ("usr/share/old", ARCHIVE_FILE_REGULAR, "", 20, old, 0, 'f');
+
+  /* a global mtime, for this member and the rest, with a pax header
+     setting something else in between */
+  pax (out, 'g', record ("mtime", "-1.5") + record ("path", "ignored"));
+  pax (out, 'x', record ("comment", "a = b"));
+  header (out, "usr/share/global", '0', 600);
+  contents (out, data ('c', 600));
+  expected ("usr/share/global", ARCHIVE_FILE_REGULAR, "", 600, -2, 500000000,
+	    'c');
+
+  /* a name which cannot be extracted, so the member is skipped */
+  pax (out, 'x', record ("path", std::string (CYG_PATH_MAX + 1, 'n')));
+  header (out, "skipped", '0', 700);
+  contents (out, data ('d', 700));
+
+  header (out, "usr/share/last", '0', 5);
+  contents (out, data ('e', 5));
+  expected ("usr/share/last", ARCHIVE_FILE_REGULAR, "", 5, -2, 500000000,
+	    'e');
+
+  out.append (1024, '\0');
+  return out;
+}
+
+/* read the whole of tarball; the number of members found */
+static size_t
+read_all (const std::string &tarball, bool check)
+{
+  io_stream_memory *mem = new io_stream_memory;
+  mem->write (tarball.data (), tarball.size ());
+  mem->seek (0, IO_SEEK_SET);
+  archive_tar tar (mem);
+  std::string name;
+  size_t n = 0;
+  char buf[2048];
+  while ((name = tar.next_file_name ()).size ())
+    {
+      archive_tar_file *f = (archive_tar_file *) tar.extract_file ();
+      ssize_t got = 0;
+      if (tar.next_file_type () == ARCHIVE_FILE_REGULAR)
+	got = f->read (buf, std::min (sizeof buf, f->get_size ()));
+      if (check)
+	{
+	  assert (n < expect.size ());
+	  const member &m = expect[n];
+	  assert (name == m.name);
+	  assert (tar.next_file_type () == m.type);
+	  assert (tar.linktarget () == m.linkname);
+	  assert (f->get_size () == m.size);
+	  assert (f->get_mtime () == m.mtime);
+	  assert (f->get_mtime_nsec () == m.nsec);
+	  assert (f->get_mode () == 0755);
+	  assert (got == (ssize_t) m.size);
+	  assert (std::count (buf, buf + got, m.fill) == got);
+	  /* which is an error of the member, not of the archive */
+	  assert (f->write (buf, 1) < 0 && f->error ());
+	}
+      delete f;
+      if (tar.skip_file ())
+	break;
+      n++;
+      /* a member takes at least one block */
+      assert (n <= tarball.size () / 512);
+    }
+  if (check)
+    assert (!tar.error ());
+  return n;
+}
+
+int
+main (int argc, char **argv)
+{
+  int rounds = argc > 1 ? atoi (argv[1]) : 20000;
+  NullLog log;
+  LogSingleton::SetInstance (log);
+  std::string tarball = generate ();
+  assert (read_all (tarball, true) == expect.size ());
+
+  /* damage: a few bytes changed, often in a pax record's digits, or the
+     tarball cut short */
+  srand (1);
+  size_t found = 0;
+  for (int i = 0; i < rounds; i++)
+    {
+      std::string damaged = tarball;
+      if (i % 10 == 0)
+	damaged.resize (rand () % damaged.size ());
+      else
+	for (int j = rand () % 4; j >= 0; j--)
+	  {
+	    size_t at = rand () % damaged.size ();
+	    if (j & 1)
+	      damaged[at] = "0123456789 =\n\0\x80"[rand () % 15];
+	    else
+	      damaged[at] ^= 1 << (rand () % 8);
+	  }
+      found += read_all (damaged, false);
+    }
+  printf ("%d damaged tarballs read, %lu members found\n", rounds,
+	  (unsigned long) found);
+  return 0;
+}
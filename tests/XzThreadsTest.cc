@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+/* Compress some data as xz -T does, in many blocks, and as plain xz
+   does, in one, and check compress_xz decodes each of them the same with
+   one thread and with several, timing them.  Then check a damaged
+   multi-block stream is an error with several threads.
+
+   Usage: XzThreadsTest [MiB [threads]]  (default: 16, 4) */
+
+#include "compress_xz.h"
+#include "io_stream.h"
+#include "io_stream_memory.h"
+#include "testutil.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+/* text-like data, which compresses about as well as a package does */
+static std::string
+generate (size_t size)
+{
+  static const char *words[] = { "usr", "share", "doc", "lib", "include",
+				 "the", "of", "and", "int", "return",
+				 "static", "const", "char", "void", "size" };
+  std::string s;
+  s.reserve (size + 16);
+  unsigned int r = 1;
+  while (s.size () < size)
+    {
+      r = r * 1103515245 + 12345;
+      s += words[(r >> 16) % 15];
+      s += (r >> 8) % 7 ? ' ' : '\n';
+      if ((r >> 4) % 31 == 0)
+	s += (char) ('A' + (r >> 20) % 26);
+    }
+  s.resize (size);
+  return s;
+}
+
+/* in blocks of block_size, or in one if 0 */
+static std::string
+xz (const std::string &in, uint64_t block_size)
+{
+  lzma_stream strm = LZMA_STREAM_INIT;
+  lzma_mt mt;
+  memset (&mt, 0, sizeof mt);
+  mt.threads = lzma_cputhreads () ? lzma_cputhreads () : 1;
+  mt.block_size = block_size ? block_size : in.size () + 1;
+  mt.preset = 3;
+  mt.check = LZMA_CHECK_CRC64;
+  lzma_ret ret = lzma_stream_encoder_mt (&strm, &mt);
+  assert (ret == LZMA_OK);
+  std::string out (lzma_stream_buffer_bound (in.size ()), '\0');
+  strm.next_in = (const uint8_t *) in.data ();
+  strm.avail_in = in.size ();
+  strm.next_out = (uint8_t *) &out[0];
+  strm.avail_out = out.size ();
+  ret = lzma_code (&strm, LZMA_FINISH);
+  assert (ret == LZMA_STREAM_END);
+  out.resize (out.size () - strm.avail_out);
+  lzma_end (&strm);
+  return out;
+}
+
+/* decode compressed with compress_xz; false on error */
+static bool
+decode (const std::string &compressed, std::string &out, unsigned int threads)
+{
+  io_stream_memory *mem = new io_stream_memory;
+  mem->write (compressed.data (), compressed.size ());
+  mem->seek (0, IO_SEEK_SET);
+  compress_xz xz (mem, threads);
+  out.clear ();
+  const void *data;
+  ssize_t got;
+  while ((got = xz.read_view (&data, 1 << 20)) > 0)
+    {
+      out.append ((const char *) data, got);
+      xz.consume (got);
+    }
+  return got == 0 && !xz.error ();
+}
+
+int
+main (int argc, char **argv)
+{
+  size_t mib = argc > 1 ? atoi (argv[1]) : 16;
+  unsigned int threads = argc > 2 ? atoi (argv[2]) : 4;
+  NullLog log;
+  LogSingleton::SetInstance (log);
+
+  std::string data = generate (mib << 20);
+  struct
+  {
+    const char *name;
+    uint64_t block_size;
+  } layouts[] = {
+    { "one block", 0 },
+    { "2 MiB blocks", 2 << 20 },
+  };
+  std::string out, blocks;
+  for (size_t l = 0; l < sizeof layouts / sizeof *layouts; l++)
+    {
+      std::string compressed = xz (data, layouts[l].block_size);
+      if (layouts[l].block_size)
+	blocks = compressed;
+      double start = now ();
+      assert (decode (compressed, out, 1) && out == data);
+      double single = now () - start;
+      start = now ();
+      assert (decode (compressed, out, threads) && out == data);
+      double multi = now () - start;
+      printf ("%lu MiB, %s, %lu bytes: 1 thread %.3f s, %u threads %.3f s\n",
+	      (unsigned long) mib, layouts[l].name,
+	      (unsigned long) compressed.size (), single, threads, multi);
+    }
+
+  /* damage in a block, so as one thread may find it while others are
+     still decoding */
+  std::string damaged = blocks;
+  damaged[damaged.size () / 3] ^= 0x55;
+  assert (!decode (damaged, out, threads));
+  damaged = blocks.substr (0, blocks.size () * 2 / 3);
+  assert (!decode (damaged, out, threads));
+  return 0;
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+#ifndef SETUP_TESTS_TESTUTIL_H
+#define SETUP_TESTS_TESTUTIL_H
+
+/* What several of the tests need alike. */
+
+#include "LogSingleton.h"
+
+#include <stdlib.h>
+#include <sys/time.h>
+
+/* the stream and archive classes log what they cannot read; a test set as
+   the instance keeps quiet about it */
+class NullLog : public LogSingleton
+{
+public:
+  NullLog () : LogSingleton (NULL) {}
+  virtual void exit (int code, bool) { ::exit (code); }
+  virtual std::ostream &operator() (enum log_level) { return *this; }
+protected:
+  virtual void endEntry () {}
+};
+
+/* wall-clock seconds, for timing */
+static inline double
+now ()
+{
+  struct timeval tv;
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+#endif /* SETUP_TESTS_TESTUTIL_H */
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+#include "threadpool.h"
+
+#include <stdlib.h>
+
+#include "getopt++/StringOption.h"
+
+static StringOption ThreadsOption ("", '\0', "threads",
+				   "Number of worker threads to use when "
+				   "installing (default: one per CPU, "
+				   "1 disables parallel work)", false);
+
+unsigned int
+ThreadPool::default_size ()
+{
+  int n = atoi (static_cast<std::string> (ThreadsOption).c_str ());
+  if (n > 0)
+    return n;
+
+  SYSTEM_INFO si;
+  GetSystemInfo (&si);
+  return si.dwNumberOfProcessors ? si.dwNumberOfProcessors : 1;
+}
+
+ThreadPool::ThreadPool (unsigned int nthreads) : running (0), stopping (false)
+{
+  InitializeCriticalSection (&lock);
+  InitializeConditionVariable (&job_queued);
+  InitializeConditionVariable (&job_finished);
+
+  if (!nthreads)
+    nthreads = default_size ();
+  for (unsigned int i = 0; i < nthreads; i++)
+    {
+      DWORD threadID;
+      HANDLE h = CreateThread (NULL, 0, worker_reflector, this, 0, &threadID);
+      if (h)
+	threads.push_back (h);
+    }
+}
+
+ThreadPool::~ThreadPool ()
+{
+  EnterCriticalSection (&lock);
+  stopping = true;
+  WakeAllConditionVariable (&job_queued);
+  LeaveCriticalSection (&lock);
+
+  for (std::vector<HANDLE>::iterator i = threads.begin ();
+       i != threads.end (); ++i)
+    {
+      WaitForSingleObject (*i, INFINITE);
+      CloseHandle (*i);
+    }
+  DeleteCriticalSection (&lock);
+}
+
+void
+ThreadPool::submit (std::function<void ()> job)
+{
+  /* If no worker could be started, degrade to running inline. */
+  if (threads.empty ())
+    {
+      job ();
+      return;
+    }
+
+  EnterCriticalSection (&lock);
+  jobs.push_back (job);
+  WakeConditionVariable (&job_queued);
+  LeaveCriticalSection (&lock);
+}
+
+bool
+ThreadPool::wait (DWORD timeout)
+{
+  EnterCriticalSection (&lock);
+  /* With a timeout, return after the first wakeup so that the caller can
+     update the GUI. */
+  while ((!jobs.empty () || running)
+	 && SleepConditionVariableCS (&job_finished, &lock, timeout)
+	 && timeout == INFINITE)
+    ;
+  bool idle = jobs.empty () && !running;
+  LeaveCriticalSection (&lock);
+  return idle;
+}
+
+DWORD WINAPI
+ThreadPool::worker_reflector (void *p)
+{
+  ((ThreadPool *) p)->worker ();
+  return 0;
+}
+
+void
+ThreadPool::worker ()
+{
+  EnterCriticalSection (&lock);
+  while (1)
+    {
+      /* The queue is drained before stopping, so the destructor implies
+	 wait (). */
+      while (jobs.empty () && !stopping)
+	SleepConditionVariableCS (&job_queued, &lock, INFINITE);
+      if (jobs.empty ())
+	break;
+
+      std::function<void ()> job = jobs.front ();
+      jobs.pop_front ();
+      running++;
+      LeaveCriticalSection (&lock);
+
+      /* Jobs report their own failures; an escaping exception must not
+	 take the worker (and everything queued behind it) down with it. */
+      try
+	{
+	  job ();
+	}
+      catch (...)
+	{
+	}
+
+      EnterCriticalSection (&lock);
+      running--;
+      WakeAllConditionVariable (&job_finished);
+    }
+  LeaveCriticalSection (&lock);
+}
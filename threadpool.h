@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2026, Cygwin
+ *
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     A copy of the GNU General Public License can be found at
+ *     http://www.gnu.org/
+ *
+ */
+
+#ifndef SETUP_THREADPOOL_H
+#define SETUP_THREADPOOL_H
+
+/* A fixed set of worker threads which run queued jobs in FIFO order.
+
+   Jobs must not touch the GUI (g_Progress, dialogs); they hand their
+   results back to the thread which submitted them, which is expected to
+   do all of the user-visible reporting. */
+
+#include "win32.h"
+#include <deque>
+#include <vector>
+#include <functional>
+
+/* A CRITICAL_SECTION which initialises itself, for use as a file-static
+   lock. */
+class CriticalSection
+{
+public:
+  CriticalSection () { InitializeCriticalSection (&cs); }
+  ~CriticalSection () { DeleteCriticalSection (&cs); }
+  void enter () { EnterCriticalSection (&cs); }
+  void leave () { LeaveCriticalSection (&cs); }
+private:
+  CRITICAL_SECTION cs;
+
+  CriticalSection (const CriticalSection &); // no copy cons
+  CriticalSection &operator= (const CriticalSection &); // no assignment
+};
+
+class ThreadPool
+{
+public:
+  /* 0 means default_size () threads */
+  ThreadPool (unsigned int nthreads = 0);
+  /* waits for all queued jobs to finish */
+  ~ThreadPool ();
+  void submit (std::function<void ()> job);
+  /* block until every job submitted so far has finished, or until
+     timeout milliseconds have passed; returns true if the pool is idle */
+  bool wait (DWORD timeout = INFINITE);
+  unsigned int size () const { return threads.size (); }
+  /* the number of workers to use: the --threads option if given,
+     otherwise one per processor */
+  static unsigned int default_size ();
+private:
+  static DWORD WINAPI worker_reflector (void *);
+  void worker ();
+
+  std::vector<HANDLE> threads;
+  std::deque<std::function<void ()> > jobs;
+  unsigned int running;
+  bool stopping;
+  CRITICAL_SECTION lock;
+  CONDITION_VARIABLE job_queued;
+  CONDITION_VARIABLE job_finished;
+
+  ThreadPool (const ThreadPool &); // no copy cons
+  ThreadPool &operator= (const ThreadPool &); // no assignment
+};
+
+#endif /* SETUP_THREADPOOL_H */
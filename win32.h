@@ -20,8 +20,7 @@
 #include <sys/types.h>
 #include <string>
 
-/* Needed for some buffers etc., to have a useful replacement for MAX_PATH. */
-#define CYG_PATH_MAX	4096
+#include "path_max.h"
 
 /* Any include of <windows.h> should be through this file, which wraps it in
  * various other handling. */